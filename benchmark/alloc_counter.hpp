@@ -0,0 +1,75 @@
+/* Proj: tiny-future
+ * File: alloc_counter.hpp
+ * Created Date: 2023/5/14
+ * Author: yangyangyang
+ * Description: 替换全局operator new, 统计每次迭代的堆分配次数.
+ *              定义了非inline的operator new/delete, 每个benchmark可执行文件只能包含一次.
+ * -----
+ * Last Modified: 2023/5/14 15:12:08
+ * -----
+ * Copyright (c) 2023  . All rights reserved.
+ */
+#ifndef TINY_FUTURE_ALLOC_COUNTER_HPP
+#define TINY_FUTURE_ALLOC_COUNTER_HPP
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace alloc_counter {
+
+inline std::atomic<uint64_t>& allocations() noexcept {
+    static std::atomic<uint64_t> count{0};
+    return count;
+}
+
+// 在benchmark循环前构造, 循环后调用report, 所有线程上的分配都计入.
+class Scope {
+public:
+    Scope() noexcept
+        : start_(allocations().load(std::memory_order_relaxed)) {}
+
+    void report(benchmark::State& state, int64_t ops_per_iteration = 1) const {
+        const uint64_t count = allocations().load(std::memory_order_relaxed) - start_;
+        const auto ops = static_cast<double>(state.iterations() * ops_per_iteration);
+        state.counters["allocs/op"] = ops > 0 ? static_cast<double>(count) / ops : 0.0;
+    }
+
+private:
+    const uint64_t start_;
+};
+
+} // namespace alloc_counter
+
+void* operator new(std::size_t size) {
+    alloc_counter::allocations().fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return ::operator new(size);
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+#endif // TINY_FUTURE_ALLOC_COUNTER_HPP
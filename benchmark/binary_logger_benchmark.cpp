@@ -0,0 +1,49 @@
+/* Proj: tiny-future
+ * File: binary_logger_benchmark.cpp
+ * Created Date: 2023/5/13
+ * Author: yangyangyang
+ * Description: 调用线程上二进制日志与spdlog同步格式化的开销对比.
+ * -----
+ * Last Modified: 2023/5/13 19:02:41
+ * -----
+ * Copyright (c) 2023  . All rights reserved.
+ */
+
+#include "helper/binary_logger.hpp"
+#include <benchmark/benchmark.h>
+
+#include <spdlog/sinks/null_sink.h>
+
+namespace {
+
+// 单核上写线程与调用线程抢占同一个CPU, 来不及边写边取; 固定迭代次数并让缓冲区装下整轮记录, 保证dropped为0,
+// 测到的是调用线程的真实开销而不是丢弃路径.
+constexpr int64_t kBinaryLogIterations = 1 << 20;
+constexpr size_t kBinaryLogBufferSize = size_t{1} << 27;
+
+void BM_BinaryLog(benchmark::State& state) {
+    // 只影响之后新建的线程缓冲区, 调用线程第一次BLOG前设置.
+    helper::logger::binlog::Registry::instance().setBufferSize(kBinaryLogBufferSize);
+    helper::logger::BinaryLogWriter writer("/dev/null");
+    int64_t i = 0;
+    // 在计时外建立线程缓冲区并注册调用处.
+    BLOG_INFO("request {} served in {} us by {}", i, 12.5, "worker");
+    for (auto _ : state) {
+        BLOG_INFO("request {} served in {} us by {}", i++, 12.5, "worker");
+    }
+    state.counters["dropped"] = static_cast<double>(writer.dropped());
+}
+
+void BM_SpdlogNullSink(benchmark::State& state) {
+    spdlog::logger logger("bench", std::make_shared<spdlog::sinks::null_sink_st>());
+    logger.set_pattern("[%C-%m-%d %T.%e (P)%P (T)%t] [%l] [%s:%#] %v");
+    int64_t i = 0;
+    for (auto _ : state) {
+        logger.info("request {} served in {} us by {}", i++, 12.5, "worker");
+    }
+}
+
+} // namespace
+
+BENCHMARK(BM_BinaryLog)->Iterations(kBinaryLogIterations);
+BENCHMARK(BM_SpdlogNullSink);
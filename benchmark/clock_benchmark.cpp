@@ -0,0 +1,47 @@
+/* Proj: tiny-future
+ * File: clock_benchmark.cpp
+ * Created Date: 2023/5/16
+ * Author: yangyangyang
+ * Description: TscClock与std::chrono时钟的读取开销.
+ * -----
+ * Last Modified: 2023/5/16 14:02:11
+ * -----
+ * Copyright (c) 2023  . All rights reserved.
+ */
+
+#include "helper/tsc_clock.hpp"
+#include <benchmark/benchmark.h>
+
+namespace {
+
+void BM_SteadyClock(benchmark::State& state) {
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(std::chrono::steady_clock::now());
+    }
+}
+
+void BM_SystemClock(benchmark::State& state) {
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(std::chrono::system_clock::now());
+    }
+}
+
+void BM_TscClock(benchmark::State& state) {
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(helper::TscClock::nowNanos());
+    }
+    state.SetLabel(helper::TscClock::usingTsc() ? "tsc" : "fallback");
+}
+
+void BM_TscClockSystem(benchmark::State& state) {
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(helper::TscClock::systemNow());
+    }
+}
+
+} // namespace
+
+BENCHMARK(BM_SteadyClock);
+BENCHMARK(BM_SystemClock);
+BENCHMARK(BM_TscClock);
+BENCHMARK(BM_TscClockSystem);
@@ -0,0 +1,293 @@
+/* Proj: tiny-future
+ * File: future_benchmark.cpp
+ * Created Date: 2023/5/14
+ * Author: yangyangyang
+ * Description: Promise/Future往返, via跳转延迟与ThreadExecutor提交吞吐, 与std::future/boost::future对比;
+ *              以及buffer.hpp中各队列的吞吐.
+ * -----
+ * Last Modified: 2023/5/14 16:37:25
+ * -----
+ * Copyright (c) 2023  . All rights reserved.
+ */
+
+#define BOOST_THREAD_VERSION 4
+#define BOOST_THREAD_PROVIDES_EXECUTORS
+
+#include "./alloc_counter.hpp"
+#include "future_wrapper/executor.hpp"
+#include "future_wrapper/future.hpp"
+#include "future_wrapper/promise.hpp"
+#include "helper/buffer.hpp"
+#include <benchmark/benchmark.h>
+
+#include <boost/thread/executors/basic_thread_pool.hpp>
+#include <boost/thread/future.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+void spinUntil(const std::atomic<bool>& flag) {
+    while (!flag.load(std::memory_order_acquire)) {
+    }
+}
+
+// 创建-设置-消费, 不经过executor.
+void BM_TinyFuture_RoundTrip(benchmark::State& state) {
+    alloc_counter::Scope allocs;
+    for (auto _ : state) {
+        Promise<int> promise;
+        auto future = promise.getFuture();
+        promise.setValue(1);
+        std::move(future).get();
+        benchmark::DoNotOptimize(future.getSharedState().getValue());
+    }
+    allocs.report(state);
+}
+
+// 回调在setValue的线程上直接执行.
+void BM_TinyFuture_ThenInline(benchmark::State& state) {
+    alloc_counter::Scope allocs;
+    int sum = 0;
+    for (auto _ : state) {
+        Promise<int> promise;
+        auto future = promise.getFuture();
+        future.thenValue([&sum](int&& value) { sum += value; });
+        promise.setValue(1);
+    }
+    benchmark::DoNotOptimize(sum);
+    allocs.report(state);
+}
+
+// 回调经via跳转到executor的worker上执行, 测量完整的往返.
+void BM_TinyFuture_Via(benchmark::State& state) {
+    ThreadExecutor executor(1);
+    alloc_counter::Scope allocs;
+    for (auto _ : state) {
+        std::atomic<bool> done{false};
+        Promise<int> promise;
+        auto future = promise.getFuture();
+        future.via(&executor);
+        future.thenValue([&done](int&&) { done.store(true, std::memory_order_release); });
+        promise.setValue(1);
+        spinUntil(done);
+    }
+    allocs.report(state);
+}
+
+void BM_StdFuture_RoundTrip(benchmark::State& state) {
+    alloc_counter::Scope allocs;
+    for (auto _ : state) {
+        std::promise<int> promise;
+        auto future = promise.get_future();
+        promise.set_value(1);
+        benchmark::DoNotOptimize(future.get());
+    }
+    allocs.report(state);
+}
+
+// 每次创建一个线程, 作为"直接用std::async"的参照.
+void BM_StdAsync(benchmark::State& state) {
+    alloc_counter::Scope allocs;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(std::async(std::launch::async, []() { return 1; }).get());
+    }
+    allocs.report(state);
+}
+
+void BM_BoostFuture_RoundTrip(benchmark::State& state) {
+    alloc_counter::Scope allocs;
+    for (auto _ : state) {
+        boost::promise<int> promise;
+        auto future = promise.get_future();
+        promise.set_value(1);
+        benchmark::DoNotOptimize(future.get());
+    }
+    allocs.report(state);
+}
+
+// 与BM_TinyFuture_Via对应: then的回调在单线程池上执行.
+void BM_BoostFuture_Then(benchmark::State& state) {
+    boost::executors::basic_thread_pool pool(1);
+    alloc_counter::Scope allocs;
+    for (auto _ : state) {
+        std::atomic<bool> done{false};
+        boost::promise<int> promise;
+        auto next = promise.get_future().then(pool, [&done](boost::future<int> value) {
+            done.store(true, std::memory_order_release);
+            return value.get();
+        });
+        promise.set_value(1);
+        spinUntil(done);
+        benchmark::DoNotOptimize(next.get());
+    }
+    allocs.report(state);
+}
+
+// range(0)个生产者线程同时向4个worker的ThreadExecutor提交空任务.
+void BM_ThreadExecutor_Submit(benchmark::State& state) {
+    constexpr int64_t kPerProducer = 10000;
+    const auto producers = static_cast<int>(state.range(0));
+    ThreadExecutor executor(4);
+    alloc_counter::Scope allocs;
+    for (auto _ : state) {
+        std::atomic<int64_t> completed{0};
+        std::vector<std::thread> threads;
+        for (int p = 0; p < producers; ++p) {
+            threads.emplace_back([&]() {
+                for (int64_t i = 0; i < kPerProducer; ++i) {
+                    executor.submit([&completed]() { completed.fetch_add(1, std::memory_order_relaxed); });
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        while (completed.load(std::memory_order_relaxed) < producers * kPerProducer) {
+            std::this_thread::yield();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * producers * kPerProducer);
+    allocs.report(state, producers * kPerProducer);
+}
+
+// setValue到via回调开始执行之间的延迟分布, 单位ns.
+void BM_TinyFuture_HopLatency(benchmark::State& state) {
+    ThreadExecutor executor(1);
+    std::vector<int64_t> samples;
+    samples.reserve(1 << 20);
+    for (auto _ : state) {
+        std::atomic<bool> done{false};
+        Clock::time_point start;
+        int64_t latency = 0;
+        Promise<int> promise;
+        auto future = promise.getFuture();
+        future.via(&executor);
+        future.thenValue([&](int&&) {
+            latency = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+            done.store(true, std::memory_order_release);
+        });
+        start = Clock::now();
+        promise.setValue(1);
+        spinUntil(done);
+        samples.push_back(latency);
+    }
+    std::sort(samples.begin(), samples.end());
+    auto percentile = [&samples](double p) {
+        return samples.empty() ? 0.0 : static_cast<double>(samples[static_cast<size_t>(p * (samples.size() - 1))]);
+    };
+    state.counters["p50_ns"] = percentile(0.50);
+    state.counters["p99_ns"] = percentile(0.99);
+    state.counters["p999_ns"] = percentile(0.999);
+}
+
+// buffer.hpp中各队列, 单线程与多生产者/多消费者竞争下的ops/s.
+
+constexpr size_t kQueueCapacity = 1024;
+
+void BM_RingBuffer_PushPop(benchmark::State& state) {
+    RingBuffer<int64_t> ring(kQueueCapacity);
+    alloc_counter::Scope allocs;
+    int64_t value = 0;
+    for (auto _ : state) {
+        ring.try_push(value);
+        ring.try_pop(value);
+        benchmark::DoNotOptimize(value);
+    }
+    state.SetItemsProcessed(state.iterations());
+    allocs.report(state);
+}
+
+// range(0): 每次push_n/pop_n的元素个数.
+void BM_RingBuffer_Bulk(benchmark::State& state) {
+    const auto n = static_cast<size_t>(state.range(0));
+    RingBuffer<int64_t> ring(kQueueCapacity);
+    std::vector<int64_t> in(n, 1), out(n);
+    alloc_counter::Scope allocs;
+    for (auto _ : state) {
+        ring.push_n(in.data(), n);
+        benchmark::DoNotOptimize(ring.pop_n(out.data(), n));
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * n));
+    allocs.report(state, static_cast<int64_t>(n));
+}
+
+/**
+ * range(0)个生产者与range(0)个消费者, 每个生产者写入kPerProducer个元素, 所有元素被消费后结束一轮.
+ * 队列满/空时让出CPU.
+ */
+template <typename Queue>
+void runContended(benchmark::State& state, Queue& queue) {
+    constexpr int64_t kPerProducer = 100000;
+    const auto pairs = static_cast<int>(state.range(0));
+    alloc_counter::Scope allocs;
+    for (auto _ : state) {
+        std::atomic<int64_t> consumed{0};
+        const int64_t total = pairs * kPerProducer;
+        std::vector<std::thread> threads;
+        for (int p = 0; p < pairs; ++p) {
+            threads.emplace_back([&queue]() {
+                for (int64_t i = 0; i < kPerProducer; ++i) {
+                    while (!queue.try_push(i)) {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+            threads.emplace_back([&queue, &consumed, total]() {
+                int64_t value;
+                while (consumed.load(std::memory_order_relaxed) < total) {
+                    if (queue.try_pop(value)) {
+                        consumed.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    else {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * pairs * kPerProducer);
+    allocs.report(state, pairs * kPerProducer);
+}
+
+void BM_SpscRingBuffer(benchmark::State& state) {
+    SpscRingBuffer<int64_t> queue(kQueueCapacity);
+    runContended(state, queue);
+}
+
+void BM_MpmcQueue(benchmark::State& state) {
+    MpmcQueue<int64_t> queue(kQueueCapacity);
+    runContended(state, queue);
+}
+
+void BM_ThreadSafeQueue(benchmark::State& state) {
+    ThreadSafeQueue<int64_t> queue(kQueueCapacity);
+    runContended(state, queue);
+}
+
+} // namespace
+
+BENCHMARK(BM_TinyFuture_RoundTrip);
+BENCHMARK(BM_TinyFuture_ThenInline);
+BENCHMARK(BM_TinyFuture_Via)->UseRealTime();
+BENCHMARK(BM_StdFuture_RoundTrip);
+BENCHMARK(BM_StdAsync)->UseRealTime();
+BENCHMARK(BM_BoostFuture_RoundTrip);
+BENCHMARK(BM_BoostFuture_Then)->UseRealTime();
+BENCHMARK(BM_ThreadExecutor_Submit)->RangeMultiplier(2)->Range(1, 8)->UseRealTime();
+BENCHMARK(BM_TinyFuture_HopLatency)->UseRealTime();
+BENCHMARK(BM_RingBuffer_PushPop);
+BENCHMARK(BM_RingBuffer_Bulk)->Arg(8)->Arg(64)->Arg(512);
+BENCHMARK(BM_SpscRingBuffer)->Arg(1)->UseRealTime();
+BENCHMARK(BM_MpmcQueue)->RangeMultiplier(2)->Range(1, 4)->UseRealTime();
+BENCHMARK(BM_ThreadSafeQueue)->RangeMultiplier(2)->Range(1, 4)->UseRealTime();
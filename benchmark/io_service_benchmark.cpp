@@ -0,0 +1,87 @@
+/* Proj: tiny-future
+ * File: io_service_benchmark.cpp
+ * Created Date: 2023/4/28
+ * Author: yangyangyang
+ * Description: io_uring与阻塞线程池在本地文件上的读写对比.
+ * -----
+ * Last Modified: 2023/4/28 16:41:50
+ * -----
+ * Copyright (c) 2023  . All rights reserved.
+ */
+
+#include "future_wrapper/io_service.hpp"
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+constexpr size_t kFileSize = 16 << 20;
+
+class LocalFile {
+public:
+    LocalFile() {
+        char path[] = "/tmp/io_service_benchmark_XXXXXX";
+        fd_ = ::mkstemp(path);
+        path_ = path;
+        std::vector<char> data(kFileSize, 'x');
+        if (::pwrite(fd_, data.data(), data.size(), 0) != static_cast<ssize_t>(data.size())) {
+            std::abort();
+        }
+    }
+
+    ~LocalFile() {
+        ::close(fd_);
+        ::unlink(path_.c_str());
+    }
+
+    int fd() const noexcept { return fd_; }
+
+private:
+    int fd_;
+    std::string path_;
+};
+
+// range(0): 每次IO的字节数, range(1): 一批并发的请求数.
+template <IoBackend backend, bool isWrite>
+void BM_IoService(benchmark::State& state) {
+    LocalFile file;
+    IoService io(backend);
+    const size_t block = static_cast<size_t>(state.range(0));
+    const size_t depth = static_cast<size_t>(state.range(1));
+    std::vector<char> buf(block * depth, 'y');
+
+    size_t offset = 0;
+    for (auto _ : state) {
+        std::vector<Future<ssize_t>> futures;
+        futures.reserve(depth);
+        for (size_t i = 0; i < depth; ++i) {
+            char* ptr = &buf[i * block];
+            futures.push_back(isWrite ? io.write(file.fd(), ptr, block, offset) : io.read(file.fd(), ptr, block, offset));
+            offset = (offset + block) % (kFileSize - block);
+        }
+        for (auto& future : futures) {
+            std::move(future).get();
+        }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * block * depth));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * depth));
+    state.SetLabel(io.backend() == IoBackend::IO_URING ? "io_uring" : "blocking");
+}
+
+void IoArgs(benchmark::internal::Benchmark* bench) {
+    for (int64_t block : {4 << 10, 64 << 10}) {
+        for (int64_t depth : {1, 32}) {
+            bench->Args({block, depth});
+        }
+    }
+    bench->UseRealTime();
+}
+
+} // namespace
+
+BENCHMARK_TEMPLATE(BM_IoService, IoBackend::IO_URING, false)->Apply(IoArgs);
+BENCHMARK_TEMPLATE(BM_IoService, IoBackend::BLOCKING, false)->Apply(IoArgs);
+BENCHMARK_TEMPLATE(BM_IoService, IoBackend::IO_URING, true)->Apply(IoArgs);
+BENCHMARK_TEMPLATE(BM_IoService, IoBackend::BLOCKING, true)->Apply(IoArgs);
@@ -0,0 +1,56 @@
+/* Proj: tiny-future
+ * File: random_benchmark.cpp
+ * Created Date: 2023/5/16
+ * Author: yangyangyang
+ * Description: 线程局部xoshiro256与std::mt19937的单次生成, 以及批量fill的吞吐.
+ * -----
+ * Last Modified: 2023/5/16 18:05:12
+ * -----
+ * Copyright (c) 2023  . All rights reserved.
+ */
+
+#include "helper/random.hpp"
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+namespace {
+
+void BM_Mt19937Float(benchmark::State& state) {
+    std::mt19937 mt(42);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(dist(mt));
+    }
+}
+
+void BM_RandomFloat(benchmark::State& state) {
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(rng::randomFloat(0.0f, 1.0f));
+    }
+}
+
+void BM_FillFloat(benchmark::State& state) {
+    std::vector<float> values(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        rng::fill(values.data(), values.size(), 0.0f, 1.0f);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * values.size()));
+}
+
+void BM_FillInt(benchmark::State& state) {
+    std::vector<int32_t> values(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        rng::fill(values.data(), values.size(), 0, 999);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * values.size()));
+}
+
+} // namespace
+
+BENCHMARK(BM_Mt19937Float);
+BENCHMARK(BM_RandomFloat);
+BENCHMARK(BM_FillFloat)->Arg(4096);
+BENCHMARK(BM_FillInt)->Arg(4096);
@@ -0,0 +1,109 @@
+/* Proj: tiny-future
+ * File: task_graph_benchmark.cpp
+ * Created Date: 2023/5/18
+ * Author: yangyangyang
+ * Description: TaskGraph与逐条边用Promise/thenValue连接的同一个DAG的执行时间与分配次数对比.
+ * -----
+ * Last Modified: 2023/5/18 16:05:12
+ * -----
+ * Copyright (c) 2023  . All rights reserved.
+ */
+
+#include "./alloc_counter.hpp"
+#include "future_wrapper/task_graph.hpp"
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace {
+
+constexpr uint32_t kWidth = 1000;
+
+// 分层DAG: 每层kWidth个节点, 每个节点依赖上一层的两个节点. range(0)为层数.
+uint32_t predecessor(uint32_t id, int k) {
+    const uint32_t d = id / kWidth;
+    const uint32_t w = id % kWidth;
+    return (d - 1) * kWidth + (k == 0 ? w : (w + 1) % kWidth);
+}
+
+void BM_TaskGraph(benchmark::State& state) {
+    const auto depth = static_cast<uint32_t>(state.range(0));
+    const uint32_t n = kWidth * depth;
+    ThreadExecutor executor(4);
+    TaskGraph graph;
+    graph.reserve(n, 2 * n);
+    std::atomic<uint64_t> sum{0};
+    for (uint32_t id = 0; id < n; ++id) {
+        graph.addNode([&sum]() { sum.fetch_add(1, std::memory_order_relaxed); });
+        if (id >= kWidth) {
+            graph.addEdge(predecessor(id, 0), id);
+            graph.addEdge(predecessor(id, 1), id);
+        }
+    }
+    // 首次运行整理CSR, 不计入.
+    graph.run(&executor).get();
+
+    alloc_counter::Scope allocs;
+    for (auto _ : state) {
+        graph.run(&executor).get();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * n));
+    allocs.report(state, n);
+}
+
+// 每条边一个Promise<Unit>, 节点等所有前驱的回调都到达后执行, 再完成自己出边的Promise.
+void BM_PromiseWiring(benchmark::State& state) {
+    const auto depth = static_cast<uint32_t>(state.range(0));
+    const uint32_t n = kWidth * depth;
+    ThreadExecutor executor(4);
+    std::atomic<uint64_t> sum{0};
+
+    struct Node {
+        std::atomic<int> pending{0};
+        std::vector<std::shared_ptr<Promise<Unit>>> out;
+    };
+
+    alloc_counter::Scope allocs;
+    for (auto _ : state) {
+        std::vector<Node> nodes(n);
+        Promise<Unit> done;
+        auto finished = done.getFuture();
+        std::atomic<uint32_t> remaining{n};
+        auto fire = [&](uint32_t id) {
+            sum.fetch_add(1, std::memory_order_relaxed);
+            for (auto& promise : nodes[id].out) {
+                promise->setValue(Unit{});
+            }
+            if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                done.setValue(Unit{});
+            }
+        };
+        for (uint32_t id = kWidth; id < n; ++id) {
+            nodes[id].pending.store(2, std::memory_order_relaxed);
+            for (int k = 0; k < 2; ++k) {
+                auto promise = std::make_shared<Promise<Unit>>();
+                auto future = promise->getFuture();
+                future.via(&executor);
+                future.thenValue([&nodes, &fire, id](Unit&&) {
+                    if (nodes[id].pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                        fire(id);
+                    }
+                });
+                nodes[predecessor(id, k)].out.push_back(std::move(promise));
+            }
+        }
+        for (uint32_t id = 0; id < kWidth; ++id) {
+            executor.submit([&fire, id]() { fire(id); });
+        }
+        std::move(finished).get();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * n));
+    allocs.report(state, n);
+}
+
+} // namespace
+
+BENCHMARK(BM_TaskGraph)->Arg(10)->Arg(100)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_PromiseWiring)->Arg(10)->Arg(100)->UseRealTime()->Unit(benchmark::kMillisecond);
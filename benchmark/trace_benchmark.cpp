@@ -0,0 +1,44 @@
+/* Proj: tiny-future
+ * File: trace_benchmark.cpp
+ * Created Date: 2023/5/15
+ * Author: yangyangyang
+ * Description: 打开追踪时每个追踪点的开销, 以及对Promise/Future往返的影响(对照future_benchmark).
+ * -----
+ * Last Modified: 2023/5/15 16:22:30
+ * -----
+ * Copyright (c) 2023  . All rights reserved.
+ */
+
+#ifndef TINY_FUTURE_ENABLE_TRACE
+#define TINY_FUTURE_ENABLE_TRACE 1
+#endif
+
+#include "future_wrapper/future.hpp"
+#include "future_wrapper/promise.hpp"
+#include <benchmark/benchmark.h>
+
+namespace {
+
+void BM_TraceRecord(benchmark::State& state) {
+    uint64_t id = 0;
+    for (auto _ : state) {
+        trace::record(trace::EventKind::CALL, ++id);
+    }
+}
+
+// 每次往返经过SET_VALUE, CALL, CALLBACK_BEGIN, CALLBACK_END四个追踪点.
+void BM_TracedRoundTrip(benchmark::State& state) {
+    int sum = 0;
+    for (auto _ : state) {
+        Promise<int> promise;
+        auto future = promise.getFuture();
+        future.thenValue([&sum](int&& value) { sum += value; });
+        promise.setValue(1);
+    }
+    benchmark::DoNotOptimize(sum);
+}
+
+} // namespace
+
+BENCHMARK(BM_TraceRecord);
+BENCHMARK(BM_TracedRoundTrip);
@@ -0,0 +1,36 @@
+/* Proj: tiny-future
+ * File: binlog_decode.cpp
+ * Created Date: 2023/5/13
+ * Author: yangyangyang
+ * Description: 把BinaryLogWriter写出的二进制日志解码为文本.
+ * -----
+ * Last Modified: 2023/5/13 18:30:02
+ * -----
+ * Copyright (c) 2023  . All rights reserved.
+ */
+
+#include "helper/binary_logger.hpp"
+
+#include <fstream>
+#include <iostream>
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <binary log> [pattern]" << std::endl;
+        return 1;
+    }
+    std::ifstream in(argv[1], std::ios::binary);
+    if (!in) {
+        std::cerr << "cannot open " << argv[1] << std::endl;
+        return 1;
+    }
+    try {
+        helper::logger::binlog::decodeBinaryLog(in, std::cout,
+                                                argc > 2 ? argv[2] : helper::logger::binlog::kDecodePattern);
+    }
+    catch (const std::exception& ex) {
+        std::cerr << ex.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,331 @@
+/* Proj: tiny-future
+ * File: async_cache.hpp
+ * Created Date: 2023/5/19
+ * Author: yangyangyang
+ * Description: 单飞(single-flight)异步缓存, 同一key的并发未命中共享一次加载, 分片加锁, 支持TTL与CLOCK淘汰.
+ * -----
+ * Last Modified: 2023/5/19 15:12:40
+ * -----
+ * Copyright (c) 2023  . All rights reserved.
+ */
+#ifndef TINY_FUTURE_ASYNC_CACHE_HPP
+#define TINY_FUTURE_ASYNC_CACHE_HPP
+
+#include "future_wrapper/executor.hpp"
+#include "future_wrapper/future.hpp"
+#include "future_wrapper/promise.hpp"
+#include "helper/tsc_clock.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct AsyncCacheParam {
+    // 缓存的条目数上限, 按分片均分.
+    size_t capacity{1024};
+    // 分片数, 向上取整为2的幂.
+    size_t shards{16};
+    // 条目写入后的有效期, 0表示不过期.
+    int64_t ttlMs{0};
+};
+
+struct AsyncCacheStats {
+    uint64_t hits{0};
+    uint64_t misses{0};      // 发起加载的次数
+    uint64_t coalesced{0};   // 未命中但挂到了进行中的加载上
+    uint64_t evictions{0};   // 容量不足被CLOCK淘汰
+    uint64_t expirations{0}; // 因TTL过期被移除
+    size_t size{0};
+};
+
+/**
+ * 异步记忆化缓存: get(key)返回Future, 命中时Future立即就绪; 未命中时在executor上调用loader加载.
+ *
+ * 加载完成前对同一key的get只登记Promise, 加载结束后所有等待者拿到同一个shared_ptr<const V>, 不复制V.
+ * key按hash分到各分片, 每个分片一把锁, 淘汰使用CLOCK(second chance): 命中只置访问位, 不调整链表.
+ * loader抛出异常时等待者得到空指针, 结果不写入缓存. executor不接收加载任务(REJECT)时在调用get的线程加载;
+ * 已接收的任务未执行就被丢弃(DROP_OLDEST)时, 等待者同样得到空指针, 之后的get重新加载.
+ */
+template <typename K, typename V, typename Hash = std::hash<K>>
+class AsyncCache : public MoveOnlyAble {
+public:
+    using ValuePtr = std::shared_ptr<const V>;
+    using Loader = std::function<V(const K&)>;
+
+    /**
+     * @param executor 执行loader的Executor, 生命周期需长于缓存; 析构缓存前进行中的加载需已完成.
+     */
+    AsyncCache(Executor* executor, Loader loader, const AsyncCacheParam& param = AsyncCacheParam())
+        : executor_(executor)
+        , loader_(std::move(loader))
+        , ttl_ns_(param.ttlMs * 1000000) {
+        assert(executor_ != nullptr);
+        if (ttl_ns_ != 0) {
+            helper::TscClock::warmUp();
+        }
+        size_t shards = 1;
+        while (shards < param.shards) {
+            shards <<= 1;
+        }
+        const size_t per_shard = std::max<size_t>(1, (param.capacity + shards - 1) / shards);
+        shards_.reserve(shards);
+        for (size_t i = 0; i < shards; ++i) {
+            shards_.emplace_back(new Shard(per_shard));
+        }
+    }
+
+    Future<ValuePtr> get(const K& key) {
+        Shard& shard = shardOf(key);
+        Promise<ValuePtr> promise;
+        auto future = promise.getFuture();
+        std::shared_ptr<Inflight> flight;
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            ValuePtr value = shard.lookup(key, ttl_ns_ == 0 ? 0 : helper::TscClock::nowNanos());
+            if (value) {
+                ++shard.stats.hits;
+                promise.setValue(std::move(value));
+                return future;
+            }
+            auto it = shard.inflight.find(key);
+            if (it != shard.inflight.end()) {
+                ++shard.stats.coalesced;
+                it->second->waiters.push_back(std::move(promise));
+                return future;
+            }
+            ++shard.stats.misses;
+            flight = std::make_shared<Inflight>();
+            flight->waiters.push_back(std::move(promise));
+            shard.inflight.emplace(key, flight);
+        }
+        auto task = std::make_shared<LoadTask>(this, key, std::move(flight));
+        if (!executor_->trySubmit([task]() { task->run(); })) {
+            task->run();
+        }
+        return future;
+    }
+
+    // 直接写入, 覆盖已有的值; 进行中的加载完成后不再写入缓存.
+    void put(const K& key, V value) {
+        Shard& shard = shardOf(key);
+        auto ptr = std::make_shared<const V>(std::move(value));
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.inflight.erase(key);
+        shard.insert(key, std::move(ptr), expireAt());
+    }
+
+    // 移除key; 进行中的加载仍会完成其等待者, 但结果不写入缓存.
+    void invalidate(const K& key) {
+        Shard& shard = shardOf(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.inflight.erase(key);
+        shard.erase(key);
+    }
+
+    void clear() {
+        for (auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            shard->inflight.clear();
+            while (!shard->entries.empty()) {
+                shard->erase(shard->entries.begin()->first);
+            }
+        }
+    }
+
+    size_t size() const {
+        size_t total = 0;
+        for (const auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            total += shard->entries.size();
+        }
+        return total;
+    }
+
+    AsyncCacheStats stats() const {
+        AsyncCacheStats total;
+        for (const auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            total.hits += shard->stats.hits;
+            total.misses += shard->stats.misses;
+            total.coalesced += shard->stats.coalesced;
+            total.evictions += shard->stats.evictions;
+            total.expirations += shard->stats.expirations;
+            total.size += shard->entries.size();
+        }
+        return total;
+    }
+
+private:
+    struct Entry {
+        ValuePtr value;
+        int64_t expire_ns;
+        size_t slot;
+        bool referenced;
+    };
+
+    // 进行中的加载. invalidate/put/clear把它从inflight中移除后, 结果只交给已登记的等待者.
+    struct Inflight {
+        std::vector<Promise<ValuePtr>> waiters;
+    };
+
+    // 一次加载. Func要求可复制, 由shared_ptr共享; 最后一个副本析构时仍未执行说明任务被executor丢弃.
+    struct LoadTask {
+        LoadTask(AsyncCache* cache, const K& key, std::shared_ptr<Inflight> flight)
+            : cache(cache)
+            , key(key)
+            , flight(std::move(flight)) {}
+
+        ~LoadTask() {
+            if (!ran) {
+                cache->finish_(key, *flight, nullptr);
+            }
+        }
+
+        void run() {
+            ran = true;
+            cache->load_(key, *flight);
+        }
+
+        AsyncCache* cache;
+        K key;
+        std::shared_ptr<Inflight> flight;
+        bool ran{false};
+    };
+
+    struct Shard {
+        using Map = std::unordered_map<K, Entry, Hash>;
+
+        explicit Shard(size_t capacity)
+            : ring(capacity, nullptr) {
+            entries.reserve(capacity);
+            free_slots.reserve(capacity);
+            for (size_t i = capacity; i > 0; --i) {
+                free_slots.push_back(i - 1);
+            }
+        }
+
+        // now为0时不检查过期.
+        ValuePtr lookup(const K& key, int64_t now) {
+            auto it = entries.find(key);
+            if (it == entries.end()) {
+                return nullptr;
+            }
+            if (now != 0 && it->second.expire_ns <= now) {
+                ++stats.expirations;
+                erase(key);
+                return nullptr;
+            }
+            it->second.referenced = true;
+            return it->second.value;
+        }
+
+        void insert(const K& key, ValuePtr value, int64_t expire_ns) {
+            auto it = entries.find(key);
+            if (it != entries.end()) {
+                it->second.value = std::move(value);
+                it->second.expire_ns = expire_ns;
+                it->second.referenced = true;
+                return;
+            }
+            if (free_slots.empty()) {
+                evict();
+            }
+            const size_t slot = free_slots.back();
+            free_slots.pop_back();
+            // unordered_map的元素地址在rehash后仍然有效, ring直接保存元素指针.
+            auto& node = *entries.emplace(key, Entry{std::move(value), expire_ns, slot, false}).first;
+            ring[slot] = &node;
+        }
+
+        void erase(const K& key) {
+            auto it = entries.find(key);
+            if (it == entries.end()) {
+                return;
+            }
+            ring[it->second.slot] = nullptr;
+            free_slots.push_back(it->second.slot);
+            entries.erase(it);
+        }
+
+        // 转动指针, 清除沿途的访问位, 淘汰第一个未被访问的条目.
+        void evict() {
+            while (true) {
+                auto* node = ring[hand];
+                hand = (hand + 1) % ring.size();
+                if (node == nullptr) {
+                    continue;
+                }
+                if (node->second.referenced) {
+                    node->second.referenced = false;
+                    continue;
+                }
+                ++stats.evictions;
+                erase(node->first);
+                return;
+            }
+        }
+
+        mutable std::mutex mutex;
+        Map entries;
+        std::vector<typename Map::value_type*> ring;
+        std::vector<size_t> free_slots;
+        size_t hand{0};
+        std::unordered_map<K, std::shared_ptr<Inflight>, Hash> inflight;
+        AsyncCacheStats stats;
+    };
+
+    Shard& shardOf(const K& key) const {
+        // 与unordered_map使用同一个hash, 再混合一次, 避免分片与桶选择使用相同的低位.
+        const uint64_t h = static_cast<uint64_t>(Hash()(key)) * 0x9e3779b97f4a7c15ULL;
+        return *shards_[(h >> 32) & (shards_.size() - 1)];
+    }
+
+    int64_t expireAt() const noexcept {
+        return ttl_ns_ == 0 ? INT64_MAX : helper::TscClock::nowNanos() + ttl_ns_;
+    }
+
+    void load_(const K& key, Inflight& flight) {
+        ValuePtr value;
+        try {
+            value = std::make_shared<const V>(loader_(key));
+        }
+        catch (...) {
+            value = nullptr;
+        }
+        finish_(key, flight, std::move(value));
+    }
+
+    // 结束一次加载: 从inflight移除, value非空时写入缓存, 再完成所有等待者.
+    void finish_(const K& key, Inflight& flight, ValuePtr value) {
+        Shard& shard = shardOf(key);
+        std::vector<Promise<ValuePtr>> waiters;
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            waiters = std::move(flight.waiters);
+            auto it = shard.inflight.find(key);
+            if (it != shard.inflight.end() && it->second.get() == &flight) {
+                shard.inflight.erase(it);
+                if (value) {
+                    shard.insert(key, value, expireAt());
+                }
+            }
+        }
+        // 锁外完成, 等待者的回调可能再次访问缓存.
+        for (auto& promise : waiters) {
+            promise.setValue(value);
+        }
+    }
+
+    Executor* executor_;
+    Loader loader_;
+    const int64_t ttl_ns_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+#endif // TINY_FUTURE_ASYNC_CACHE_HPP
@@ -0,0 +1,261 @@
+/* Proj: tiny-future
+ * File: async_cache_test.cpp
+ * Created Date: 2023/5/19
+ * Author: yangyangyang
+ * Description:
+ * -----
+ * Last Modified: 2023/5/19 17:03:26
+ * -----
+ * Copyright (c) 2023  . All rights reserved.
+ */
+
+#include "future_wrapper/async_cache.hpp"
+#include <gtest/gtest.h>
+
+#include <condition_variable>
+#include <string>
+#include <thread>
+
+namespace {
+
+using Cache = AsyncCache<int, std::string>;
+
+template <typename T>
+T& await(Future<T>& future) {
+    std::move(future).get();
+    return future.getSharedState().getValue();
+}
+
+// loader阻塞直到open, 便于在加载进行中发起更多请求.
+struct Gate {
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool opened{false};
+
+    void wait() {
+        std::unique_lock<std::mutex> lk(mutex);
+        cv.wait(lk, [this]() { return opened; });
+    }
+
+    void open() {
+        {
+            std::lock_guard<std::mutex> lk(mutex);
+            opened = true;
+        }
+        cv.notify_all();
+    }
+};
+
+} // namespace
+
+TEST(AsyncCache, SingleFlight) {
+    ThreadExecutor executor(2);
+    Gate gate;
+    std::atomic<int> loads{0};
+    Cache cache(&executor, [&](const int& key) {
+        ++loads;
+        gate.wait();
+        return std::to_string(key);
+    });
+
+    std::vector<Future<Cache::ValuePtr>> futures;
+    for (int i = 0; i < 10; ++i) {
+        futures.push_back(cache.get(42));
+    }
+    gate.open();
+
+    const std::string* shared = nullptr;
+    for (auto& future : futures) {
+        auto& value = await(future);
+        ASSERT_TRUE(value);
+        EXPECT_EQ(*value, "42");
+        // 所有等待者共享同一个对象.
+        if (shared == nullptr) {
+            shared = value.get();
+        }
+        EXPECT_EQ(value.get(), shared);
+    }
+    EXPECT_EQ(loads.load(), 1);
+
+    auto hit = cache.get(42);
+    EXPECT_TRUE(hit.getSharedState().hasValue());
+    EXPECT_EQ(hit.getSharedState().getValue().get(), shared);
+
+    auto stats = cache.stats();
+    EXPECT_EQ(stats.misses, 1);
+    EXPECT_EQ(stats.coalesced, 9);
+    EXPECT_EQ(stats.hits, 1);
+    EXPECT_EQ(stats.size, 1);
+}
+
+TEST(AsyncCache, ClockEviction) {
+    ThreadExecutor executor(1);
+    AsyncCacheParam param;
+    param.capacity = 2;
+    param.shards = 1;
+    Cache cache(&executor, [](const int& key) { return std::to_string(key); }, param);
+
+    auto f1 = cache.get(1);
+    await(f1);
+    auto f2 = cache.get(2);
+    await(f2);
+    // 访问1置访问位, 插入3时淘汰未被访问的2.
+    auto hit = cache.get(1);
+    auto f3 = cache.get(3);
+    await(f3);
+    EXPECT_EQ(cache.size(), 2);
+    EXPECT_EQ(cache.stats().evictions, 1);
+
+    auto again = cache.get(1);
+    EXPECT_TRUE(again.getSharedState().hasValue());
+    auto reload = cache.get(2);
+    EXPECT_EQ(*await(reload), "2");
+    EXPECT_EQ(cache.stats().misses, 4);
+}
+
+TEST(AsyncCache, Ttl) {
+    ThreadExecutor executor(1);
+    AsyncCacheParam param;
+    param.ttlMs = 100;
+    std::atomic<int> loads{0};
+    Cache cache(&executor, [&loads](const int& key) {
+        ++loads;
+        return std::to_string(key);
+    }, param);
+
+    auto first = cache.get(1);
+    await(first);
+    auto hit = cache.get(1);
+    EXPECT_TRUE(hit.getSharedState().hasValue());
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    auto expired = cache.get(1);
+    EXPECT_EQ(*await(expired), "1");
+    EXPECT_EQ(loads.load(), 2);
+    EXPECT_EQ(cache.stats().expirations, 1);
+}
+
+TEST(AsyncCache, InvalidateDuringLoad) {
+    ThreadExecutor executor(2);
+    Gate gate;
+    std::atomic<int> loads{0};
+    Cache cache(&executor, [&](const int& key) {
+        if (++loads == 1) {
+            gate.wait();
+            return std::string("stale");
+        }
+        return std::to_string(key);
+    });
+
+    auto stale = cache.get(7);
+    cache.invalidate(7);
+    // 分离后的加载不再合并新的请求.
+    auto fresh = cache.get(7);
+    EXPECT_EQ(*await(fresh), "7");
+    gate.open();
+    EXPECT_EQ(*await(stale), "stale");
+
+    auto hit = cache.get(7);
+    EXPECT_EQ(*hit.getSharedState().getValue(), "7");
+    EXPECT_EQ(loads.load(), 2);
+}
+
+TEST(AsyncCache, LoaderThrows) {
+    ThreadExecutor executor(1);
+    std::atomic<int> loads{0};
+    Cache cache(&executor, [&loads](const int&) -> std::string {
+        ++loads;
+        throw std::runtime_error("load failed");
+    });
+
+    auto failed = cache.get(1);
+    EXPECT_FALSE(await(failed));
+    EXPECT_EQ(cache.size(), 0);
+    auto retry = cache.get(1);
+    EXPECT_FALSE(await(retry));
+    EXPECT_EQ(loads.load(), 2);
+}
+
+// 队列满时executor拒绝加载任务, 在调用get的线程加载, key不会卡在进行中.
+TEST(AsyncCache, RejectExecutorLoadsInline) {
+    Gate gate;
+    std::atomic<bool> started{false};
+    ThreadExecutor executor(1, 1, OverflowPolicy::REJECT);
+    executor.submit([&]() {
+        started = true;
+        gate.wait();
+    });
+    while (!started.load()) {
+        std::this_thread::yield();
+    }
+    executor.submit([]() {});
+
+    std::thread::id loader_thread;
+    Cache cache(&executor, [&loader_thread](const int& key) {
+        loader_thread = std::this_thread::get_id();
+        return std::to_string(key);
+    });
+    auto future = cache.get(1);
+    ASSERT_TRUE(future.getSharedState().hasValue());
+    EXPECT_EQ(*await(future), "1");
+    EXPECT_EQ(loader_thread, std::this_thread::get_id());
+    EXPECT_EQ(cache.size(), 1);
+    gate.open();
+}
+
+// 加载任务被DROP_OLDEST丢弃时等待者得到空指针, 之后的get重新加载.
+TEST(AsyncCache, DroppedLoadCompletesWaiters) {
+    Gate gate;
+    std::atomic<bool> started{false};
+    ThreadExecutor executor(1, 1, OverflowPolicy::DROP_OLDEST);
+    executor.submit([&]() {
+        started = true;
+        gate.wait();
+    });
+    while (!started.load()) {
+        std::this_thread::yield();
+    }
+
+    Cache cache(&executor, [](const int& key) { return std::to_string(key); });
+    auto dropped = cache.get(1);
+    auto coalesced = cache.get(1);
+    auto other = cache.get(2);
+    EXPECT_FALSE(await(dropped));
+    EXPECT_FALSE(await(coalesced));
+
+    gate.open();
+    EXPECT_EQ(*await(other), "2");
+    auto reload = cache.get(1);
+    EXPECT_EQ(*await(reload), "1");
+}
+
+TEST(AsyncCache, ConcurrentGets) {
+    ThreadExecutor executor(2);
+    std::atomic<int> loads{0};
+    AsyncCacheParam param;
+    param.capacity = 4096;
+    Cache cache(&executor, [&loads](const int& key) {
+        ++loads;
+        return std::to_string(key);
+    }, param);
+
+    constexpr int kKeys = 1000;
+    std::vector<std::thread> threads;
+    std::atomic<int> mismatches{0};
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&cache, &mismatches]() {
+            for (int i = 0; i < kKeys; ++i) {
+                auto future = cache.get(i);
+                if (*await(future) != std::to_string(i)) {
+                    ++mismatches;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(mismatches.load(), 0);
+    EXPECT_EQ(loads.load(), kKeys);
+    EXPECT_EQ(cache.size(), kKeys);
+}
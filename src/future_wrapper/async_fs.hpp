@@ -0,0 +1,123 @@
+/* Proj: tiny-future
+ * File: async_fs.hpp
+ * Created Date: 2023/5/14
+ * Author: yangyangyang
+ * Description: os.hpp中目录/文件操作的异步版本, 运行在独立的有界阻塞IO线程池上.
+ * -----
+ * Last Modified: 2023/5/14 10:26:41
+ * -----
+ * Copyright (c) 2023  . All rights reserved.
+ */
+#ifndef TINY_FUTURE_ASYNC_FS_HPP
+#define TINY_FUTURE_ASYNC_FS_HPP
+
+#include "future_wrapper/executor.hpp"
+#include "future_wrapper/future.hpp"
+#include "future_wrapper/promise.hpp"
+#include "helper/os.hpp"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace detail {
+
+/**
+ * 合并对同一key的并发请求: 第一个请求执行实际操作, 操作完成前到达的请求只登记Promise, 完成时统一设置结果.
+ */
+template <typename R>
+class RequestCoalescer : public MoveOnlyAble {
+public:
+    // 返回true表示调用者是第一个请求, 需要发起实际操作.
+    bool join(const std::string& key, Promise<R>&& promise) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& waiters = waiters_[key];
+        waiters.push_back(std::move(promise));
+        return waiters.size() == 1;
+    }
+
+    void complete(const std::string& key, const R& value) {
+        std::vector<Promise<R>> waiters;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = waiters_.find(key);
+            assert(it != waiters_.end());
+            waiters = std::move(it->second);
+            waiters_.erase(it);
+        }
+        for (auto& promise : waiters) {
+            promise.setValue(value);
+        }
+    }
+
+private:
+    std::mutex mutex_;
+    std::unordered_map<std::string, std::vector<Promise<R>>> waiters_;
+};
+
+} // namespace detail
+
+/**
+ * 异步文件系统操作, 结果通过Future返回.
+ *
+ * 操作运行在自己的有界ThreadExecutor上, 与计算线程池隔离, 磁盘慢时只会积压在这里;
+ * 队列满时提交者阻塞(OverflowPolicy::BLOCK). 对同一路径的同一操作, 在前一次完成前到达的请求共享其结果.
+ */
+class AsyncFileSystem : public MoveOnlyAble {
+public:
+    /**
+     * @param num_thread IO线程数.
+     * @param queue_capacity 等待执行的操作数上限.
+     */
+    explicit AsyncFileSystem(unsigned int num_thread = 2, size_t queue_capacity = 1024)
+        : executor_(num_thread, queue_capacity, OverflowPolicy::BLOCK) {}
+
+    Future<std::vector<std::string>> listSubDir(const std::string& dir, bool is_sort_result = true) {
+        return run(list_, (is_sort_result ? "s:" : "u:") + dir,
+                   [dir, is_sort_result]() { return ::listSubDir(dir, is_sort_result); });
+    }
+
+    Future<bool> removeDirectory(const std::string& dir_path) {
+        return run(remove_, dir_path, [dir_path]() { return ::removeDirectory(dir_path); });
+    }
+
+    Future<bool> isFile(const std::string& filepath) {
+        return run(is_file_, filepath, [filepath]() { return ::isFile(filepath); });
+    }
+
+    Future<bool> isDir(const std::string& dir_path) {
+        return run(is_dir_, dir_path, [dir_path]() { return ::isDir(dir_path); });
+    }
+
+    // 被合并(未单独执行)的请求数.
+    uint64_t coalescedCount() const noexcept { return coalesced_.load(std::memory_order_relaxed); }
+
+    // 执行IO操作的线程池, 可用于提交其他阻塞操作.
+    ThreadExecutor& executor() noexcept { return executor_; }
+
+private:
+    template <typename R, typename Fn>
+    Future<R> run(detail::RequestCoalescer<R>& coalescer, const std::string& key, Fn&& op) {
+        Promise<R> promise;
+        auto future = promise.getFuture();
+        if (!coalescer.join(key, std::move(promise))) {
+            coalesced_.fetch_add(1, std::memory_order_relaxed);
+            return future;
+        }
+        executor_.submit([&coalescer, key, op = std::forward<Fn>(op)]() { coalescer.complete(key, op()); });
+        return future;
+    }
+
+    detail::RequestCoalescer<std::vector<std::string>> list_;
+    detail::RequestCoalescer<bool> remove_;
+    detail::RequestCoalescer<bool> is_file_;
+    detail::RequestCoalescer<bool> is_dir_;
+    std::atomic<uint64_t> coalesced_{0};
+    // 最先析构, 等待已提交的操作执行完后再销毁上面的成员.
+    ThreadExecutor executor_;
+};
+
+#endif // TINY_FUTURE_ASYNC_FS_HPP
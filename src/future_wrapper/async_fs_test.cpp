@@ -0,0 +1,83 @@
+/* Proj: tiny-future
+ * File: async_fs_test.cpp
+ * Created Date: 2023/5/14
+ * Author: yangyangyang
+ * Description:
+ * -----
+ * Last Modified: 2023/5/14 11:02:17
+ * -----
+ * Copyright (c) 2023  . All rights reserved.
+ */
+
+#include "future_wrapper/async_fs.hpp"
+#include <gtest/gtest.h>
+
+#include <future>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+std::string testDir(const char* tag) {
+    return std::string("/tmp/tiny_future_async_fs_") + tag + "_" + std::to_string(::getpid());
+}
+
+template <typename T>
+T await(Future<T>&& future) {
+    std::move(future).get();
+    return std::move(future.getSharedState().getValue());
+}
+
+} // namespace
+
+TEST(AsyncFileSystem, Operations) {
+    const auto dir = testDir("ops");
+    ::mkdir(dir.c_str(), 0755);
+    ::mkdir((dir + "/b").c_str(), 0755);
+    ::mkdir((dir + "/a").c_str(), 0755);
+    std::ofstream(dir + "/file") << "content";
+
+    AsyncFileSystem fs(2);
+    EXPECT_TRUE(await(fs.isDir(dir)));
+    EXPECT_FALSE(await(fs.isFile(dir)));
+    EXPECT_TRUE(await(fs.isFile(dir + "/file")));
+    EXPECT_EQ(await(fs.listSubDir(dir)), (std::vector<std::string>{dir + "/a", dir + "/b"}));
+    EXPECT_TRUE(await(fs.removeDirectory(dir)));
+    EXPECT_FALSE(await(fs.isDir(dir)));
+    EXPECT_TRUE(await(fs.listSubDir(dir)).empty());
+}
+
+TEST(AsyncFileSystem, CoalesceSameDirectory) {
+    const auto dir = testDir("coalesce");
+    ::mkdir(dir.c_str(), 0755);
+    ::mkdir((dir + "/sub").c_str(), 0755);
+
+    AsyncFileSystem fs(1);
+    // 占住唯一的IO线程, 让后续请求都在第一个完成前到达.
+    std::promise<void> gate;
+    auto gate_future = gate.get_future().share();
+    fs.executor().submit([gate_future]() { gate_future.wait(); });
+
+    constexpr int kRequests = 10;
+    std::vector<Future<std::vector<std::string>>> futures;
+    for (int i = 0; i < kRequests; ++i) {
+        futures.push_back(fs.listSubDir(dir));
+    }
+    // 不同操作/不同参数不合并.
+    auto unsorted = fs.listSubDir(dir, false);
+    auto is_dir = fs.isDir(dir);
+    EXPECT_EQ(fs.coalescedCount(), kRequests - 1);
+
+    gate.set_value();
+    for (auto& future : futures) {
+        EXPECT_EQ(await(std::move(future)), std::vector<std::string>{dir + "/sub"});
+    }
+    EXPECT_EQ(await(std::move(unsorted)).size(), 1);
+    EXPECT_TRUE(await(std::move(is_dir)));
+
+    // 完成后的请求重新执行.
+    EXPECT_EQ(await(fs.listSubDir(dir)).size(), 1);
+    EXPECT_EQ(fs.coalescedCount(), kRequests - 1);
+    removeDirectory(dir);
+}
@@ -0,0 +1,281 @@
+/* Proj: tiny-future
+ * File: channel.hpp
+ * Created Date: 2023/5/17
+ * Author: yangyangyang
+ * Description: 基于Future的有界Channel与AsyncGenerator, 等待时注册回调而不阻塞线程.
+ * -----
+ * Last Modified: 2023/5/17 15:36:09
+ * -----
+ * Copyright (c) 2023  . All rights reserved.
+ */
+#ifndef TINY_FUTURE_CHANNEL_HPP
+#define TINY_FUTURE_CHANNEL_HPP
+
+#include "future_wrapper/executor.hpp"
+#include "future_wrapper/future.hpp"
+#include "future_wrapper/promise.hpp"
+
+#include <boost/optional.hpp>
+
+#include <cassert>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace detail {
+
+template <typename T, typename U>
+Future<T> makeReadyFuture(U&& value) {
+    Promise<T> promise;
+    auto future = promise.getFuture();
+    promise.setValue(std::forward<U>(value));
+    return future;
+}
+
+} // namespace detail
+
+/**
+ * 有界多生产者多消费者Channel, send/recv都返回Future.
+ *
+ * recv在Channel为空时登记一个Promise, 之后的send直接把元素交给它; send在Channel满时登记为等待发送者,
+ * 返回的Future在元素被接收方取走或移入缓冲区后才完成, 生产者据此实现背压.
+ * capacity为0时没有缓冲区, 每次send都要等到对应的recv.
+ *
+ * Promise在锁外完成, 回调默认在完成它的线程上执行, 需要切换线程时对返回的Future调用via.
+ */
+template <typename T>
+class Channel : public MoveOnlyAble {
+public:
+    explicit Channel(size_t capacity)
+        : capacity_(capacity) {}
+
+    /**
+     * @brief 发送value, Future的值为false表示Channel已关闭, value被丢弃.
+     */
+    Future<bool> send(T value) {
+        Promise<boost::optional<T>> receiver;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (closed_) {
+                return detail::makeReadyFuture<bool>(false);
+            }
+            if (receivers_.empty()) {
+                if (buffer_.size() < capacity_) {
+                    buffer_.push_back(std::move(value));
+                    return detail::makeReadyFuture<bool>(true);
+                }
+                Promise<bool> sent;
+                auto future = sent.getFuture();
+                senders_.emplace_back(std::move(value), std::move(sent));
+                return future;
+            }
+            // 有接收者在等待时缓冲区必然为空, 直接交给最早的接收者.
+            receiver = std::move(receivers_.front());
+            receivers_.pop_front();
+        }
+        receiver.setValue(boost::optional<T>(std::move(value)));
+        return detail::makeReadyFuture<bool>(true);
+    }
+
+    /**
+     * @brief 接收一个元素, Future的值为空表示Channel已关闭且所有元素都已被取走.
+     */
+    Future<boost::optional<T>> recv() {
+        Promise<bool> sender;
+        bool wake_sender = false;
+        boost::optional<T> value;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!buffer_.empty()) {
+                value = std::move(buffer_.front());
+                buffer_.pop_front();
+                // 腾出的位置给最早的等待发送者.
+                if (!senders_.empty()) {
+                    buffer_.push_back(std::move(senders_.front().first));
+                    sender = std::move(senders_.front().second);
+                    senders_.pop_front();
+                    wake_sender = true;
+                }
+            }
+            else if (!senders_.empty()) {
+                value = std::move(senders_.front().first);
+                sender = std::move(senders_.front().second);
+                senders_.pop_front();
+                wake_sender = true;
+            }
+            else if (!closed_) {
+                Promise<boost::optional<T>> receiver;
+                auto future = receiver.getFuture();
+                receivers_.push_back(std::move(receiver));
+                return future;
+            }
+        }
+        if (wake_sender) {
+            sender.setValue(true);
+        }
+        return detail::makeReadyFuture<boost::optional<T>>(std::move(value));
+    }
+
+    /**
+     * @brief 关闭后send立即返回false; 已缓冲和正在等待的发送仍可被接收, 等待中的接收者得到空值.
+     */
+    void close() {
+        std::deque<Promise<boost::optional<T>>> receivers;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+            receivers.swap(receivers_);
+        }
+        for (auto& receiver : receivers) {
+            receiver.setValue(boost::optional<T>());
+        }
+    }
+
+    bool closed() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return closed_;
+    }
+
+    // 缓冲区中的元素数, 不含等待中的发送者.
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return buffer_.size();
+    }
+
+    size_t capacity() const noexcept { return capacity_; }
+
+private:
+    const size_t capacity_;
+    mutable std::mutex mutex_;
+    bool closed_{false};
+    std::deque<T> buffer_;
+    std::deque<std::pair<T, Promise<bool>>> senders_;
+    std::deque<Promise<boost::optional<T>>> receivers_;
+};
+
+/**
+ * 异步序列: next()返回下一个元素的Future, 空值表示结束. 可以由Channel或函数构造, 支持map/forEach/pipeTo.
+ *
+ * forEach/pipeTo的每一步都提交到executor上执行, 等待元素或背压时不占用线程, 也不会因为元素已就绪而递归加深调用栈.
+ */
+template <typename T>
+class AsyncGenerator {
+public:
+    using Item = boost::optional<T>;
+    using NextFunc = std::function<Future<Item>()>;
+
+    explicit AsyncGenerator(NextFunc next)
+        : next_(std::move(next)) {}
+
+    static AsyncGenerator fromChannel(std::shared_ptr<Channel<T>> channel) {
+        return AsyncGenerator([channel]() { return channel->recv(); });
+    }
+
+    // 同步产生元素的函数, 返回空值表示结束.
+    template <typename Fn>
+    static AsyncGenerator fromFunction(Fn&& fn) {
+        auto shared = std::make_shared<typename std::decay<Fn>::type>(std::forward<Fn>(fn));
+        return AsyncGenerator([shared]() { return detail::makeReadyFuture<Item>((*shared)()); });
+    }
+
+    Future<Item> next() { return next_(); }
+
+    // 惰性变换, 元素在被拉取时才调用fn.
+    template <typename Fn, typename R = typename std::decay<decltype(std::declval<Fn&>()(std::declval<T&&>()))>::type>
+    AsyncGenerator<R> map(Fn&& fn) const {
+        auto source = next_;
+        auto shared = std::make_shared<typename std::decay<Fn>::type>(std::forward<Fn>(fn));
+        return AsyncGenerator<R>([source, shared]() {
+            // 回调保存在std::function中, 需要可拷贝, Promise通过shared_ptr持有.
+            auto promise = std::make_shared<Promise<boost::optional<R>>>();
+            auto future = promise->getFuture();
+            auto upstream = source();
+            upstream.thenValue([promise, shared](Item&& item) {
+                promise->setValue(item ? boost::optional<R>((*shared)(std::move(*item))) : boost::optional<R>());
+            });
+            return future;
+        });
+    }
+
+    /**
+     * @brief 在executor上对每个元素调用fn, 序列结束时返回的Future完成.
+     */
+    template <typename Fn>
+    Future<Unit> forEach(Executor* executor, Fn&& fn) const {
+        assert(executor != nullptr);
+        struct Loop {
+            NextFunc next;
+            typename std::decay<Fn>::type fn;
+            Executor* executor;
+            Promise<Unit> done;
+
+            static void step(const std::shared_ptr<Loop>& loop) {
+                auto future = loop->next();
+                future.via(loop->executor);
+                future.thenValue([loop](Item&& item) {
+                    if (!item) {
+                        loop->done.setValue(Unit{});
+                        return;
+                    }
+                    loop->fn(std::move(*item));
+                    step(loop);
+                });
+            }
+        };
+        auto loop = std::make_shared<Loop>(Loop{next_, std::forward<Fn>(fn), executor, Promise<Unit>()});
+        auto done = loop->done.getFuture();
+        executor->submit([loop]() { Loop::step(loop); });
+        return done;
+    }
+
+    /**
+     * @brief 把所有元素发送到channel, 每次发送完成后才拉取下一个元素(背压), 结束后关闭channel.
+     */
+    Future<Unit> pipeTo(Executor* executor, std::shared_ptr<Channel<T>> channel) const {
+        assert(executor != nullptr);
+        struct Pipe {
+            NextFunc next;
+            std::shared_ptr<Channel<T>> channel;
+            Executor* executor;
+            Promise<Unit> done;
+
+            void finish() {
+                channel->close();
+                done.setValue(Unit{});
+            }
+
+            static void step(const std::shared_ptr<Pipe>& pipe) {
+                auto future = pipe->next();
+                future.via(pipe->executor);
+                future.thenValue([pipe](Item&& item) {
+                    if (!item) {
+                        pipe->finish();
+                        return;
+                    }
+                    auto sent = pipe->channel->send(std::move(*item));
+                    sent.via(pipe->executor);
+                    sent.thenValue([pipe](bool&& ok) {
+                        if (ok) {
+                            step(pipe);
+                        }
+                        else {
+                            // 下游已关闭, 停止拉取.
+                            pipe->done.setValue(Unit{});
+                        }
+                    });
+                });
+            }
+        };
+        auto pipe = std::make_shared<Pipe>(Pipe{next_, std::move(channel), executor, Promise<Unit>()});
+        auto done = pipe->done.getFuture();
+        executor->submit([pipe]() { Pipe::step(pipe); });
+        return done;
+    }
+
+private:
+    NextFunc next_;
+};
+
+#endif // TINY_FUTURE_CHANNEL_HPP
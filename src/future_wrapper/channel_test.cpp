@@ -0,0 +1,136 @@
+/* Proj: tiny-future
+ * File: channel_test.cpp
+ * Created Date: 2023/5/17
+ * Author: yangyangyang
+ * Description:
+ * -----
+ * Last Modified: 2023/5/17 16:02:40
+ * -----
+ * Copyright (c) 2023  . All rights reserved.
+ */
+
+#include "future_wrapper/channel.hpp"
+#include <gtest/gtest.h>
+
+namespace {
+
+template <typename T>
+bool isReady(Future<T>& future) {
+    return future.getSharedState().hasValue();
+}
+
+} // namespace
+
+TEST(Channel, RecvBeforeSendRegistersContinuation) {
+    Channel<int> channel(4);
+    auto future = channel.recv();
+    EXPECT_FALSE(isReady(future));
+
+    int received = 0;
+    future.thenValue([&received](boost::optional<int>&& value) { received = *value; });
+    EXPECT_EQ(received, 0);
+
+    auto sent = channel.send(7);
+    EXPECT_TRUE(isReady(sent));
+    EXPECT_EQ(received, 7);
+    EXPECT_EQ(channel.size(), 0);
+}
+
+TEST(Channel, SendBlocksWhenFull) {
+    Channel<int> channel(2);
+    auto s1 = channel.send(1);
+    auto s2 = channel.send(2);
+    auto s3 = channel.send(3);
+    EXPECT_TRUE(isReady(s1));
+    EXPECT_TRUE(isReady(s2));
+    EXPECT_FALSE(isReady(s3));
+    EXPECT_EQ(channel.size(), 2);
+
+    // 取走一个元素后等待的发送者进入缓冲区.
+    auto r1 = channel.recv();
+    EXPECT_EQ(*r1.getSharedState().getValue(), 1);
+    EXPECT_TRUE(isReady(s3));
+    EXPECT_TRUE(s3.getSharedState().getValue());
+    EXPECT_EQ(channel.size(), 2);
+
+    EXPECT_EQ(*channel.recv().getSharedState().getValue(), 2);
+    EXPECT_EQ(*channel.recv().getSharedState().getValue(), 3);
+}
+
+TEST(Channel, Rendezvous) {
+    Channel<int> channel(0);
+    auto sent = channel.send(5);
+    EXPECT_FALSE(isReady(sent));
+    EXPECT_EQ(*channel.recv().getSharedState().getValue(), 5);
+    EXPECT_TRUE(isReady(sent));
+}
+
+TEST(Channel, Close) {
+    Channel<int> empty(1);
+    auto blocked = empty.recv();
+    empty.close();
+    EXPECT_TRUE(isReady(blocked));
+    EXPECT_FALSE(blocked.getSharedState().getValue());
+
+    Channel<int> channel(1);
+    channel.send(1);
+    auto pending = channel.send(2);
+    channel.close();
+
+    auto rejected = channel.send(3);
+    EXPECT_FALSE(rejected.getSharedState().getValue());
+
+    // 关闭前已经发出的元素仍可接收.
+    EXPECT_EQ(*channel.recv().getSharedState().getValue(), 1);
+    EXPECT_EQ(*channel.recv().getSharedState().getValue(), 2);
+    EXPECT_TRUE(pending.getSharedState().getValue());
+    EXPECT_FALSE(channel.recv().getSharedState().getValue());
+}
+
+TEST(AsyncGenerator, MapIsLazy) {
+    int produced = 0;
+    auto gen = AsyncGenerator<int>::fromFunction([&produced]() -> boost::optional<int> {
+        if (produced == 3) {
+            return boost::none;
+        }
+        return ++produced;
+    });
+    auto squares = gen.map([](int x) { return std::to_string(x * x); });
+    EXPECT_EQ(produced, 0);
+    EXPECT_EQ(*squares.next().getSharedState().getValue(), "1");
+    EXPECT_EQ(*squares.next().getSharedState().getValue(), "4");
+    EXPECT_EQ(produced, 2);
+    EXPECT_EQ(*squares.next().getSharedState().getValue(), "9");
+    EXPECT_FALSE(squares.next().getSharedState().getValue());
+}
+
+TEST(AsyncGenerator, PipelineThroughSmallPool) {
+    constexpr int64_t kItems = 200000;
+    ThreadExecutor executor(2);
+    auto channel = std::make_shared<Channel<int64_t>>(64);
+
+    int64_t next = 0;
+    auto source = AsyncGenerator<int64_t>::fromFunction([&next]() -> boost::optional<int64_t> {
+        if (next == kItems) {
+            return boost::none;
+        }
+        return next++;
+    });
+    auto produced = source.pipeTo(&executor, channel);
+
+    // forEach的回调串行执行, 不需要同步.
+    int64_t sum = 0;
+    int64_t count = 0;
+    auto consumed = AsyncGenerator<int64_t>::fromChannel(channel)
+                      .map([](int64_t x) { return x * 2; })
+                      .forEach(&executor, [&sum, &count](int64_t x) {
+                          sum += x;
+                          ++count;
+                      });
+
+    std::move(produced).get();
+    std::move(consumed).get();
+    EXPECT_EQ(count, kItems);
+    EXPECT_EQ(sum, kItems * (kItems - 1));
+    EXPECT_TRUE(channel->closed());
+}
@@ -18,6 +18,9 @@ using String = std::string;
 
 class SharedStateBase {};
 
+// 无值Future的占位类型, e.g. Future<Unit>.
+struct Unit {};
+
 using Callback = std::function<void(SharedStateBase&)>;
 // using Callback = std::function<void(Value&&)>;
 
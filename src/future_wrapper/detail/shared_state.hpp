@@ -12,37 +12,88 @@
 #define TINY_FUTURE_SHARED_STATE_HPP
 
 #include "future_wrapper/define.hpp"
+#include "future_wrapper/detail/suspender.hpp"
 #include "future_wrapper/executor.hpp"
+#include "future_wrapper/trace.hpp"
 
 template <typename T>
-class SharedState : public SharedStateBase, public MoveOnlyAble, std::enable_shared_from_this<SharedState<T>> {
+class SharedState : public SharedStateBase,
+                    public MoveOnlyAble,
+                    public std::enable_shared_from_this<SharedState<T>> {
+    enum State : uint8_t {
+        START = 0,
+        ONLY_VALUE = 1 << 0,
+        ONLY_CALLBACK = 1 << 1,
+        DONE = ONLY_VALUE | ONLY_CALLBACK,
+    };
+
 public:
     using Self = SharedState<T>;
     using SharedPtr = std::shared_ptr<Self>;
 
     // SharedPtr getPtr() noexcept { return shared_from_this(); }
 
-    void setCallback(Callback&& callback) { callback_ = std::move(callback); }
+    // value与callback谁后到达, 谁负责触发回调, 保证回调只执行一次.
+    void setCallback(Callback&& callback) {
+        callback_ = std::move(callback);
+        if (state_.fetch_or(ONLY_CALLBACK, std::memory_order_acq_rel) & ONLY_VALUE) {
+            call();
+        }
+    }
 
     template <typename U>
     void setValue(U&& value) {
+        TINY_FUTURE_TRACE(trace::EventKind::SET_VALUE, traceId_);
         value_ = std::forward<U>(value);
-        hasValue_ = true;
+        std::vector<Func> waiters;
+        {
+            std::lock_guard<std::mutex> lock(waitMutex_);
+            hasValue_ = true;
+            waiters.swap(waiters_);
+        }
+        for (auto& resume : waiters) {
+            resume();
+        }
+        if (state_.fetch_or(ONLY_VALUE, std::memory_order_acq_rel) & ONLY_CALLBACK) {
+            call();
+        }
     }
 
-    bool hasValue() const noexcept { return hasValue_; }
+    bool hasValue() const noexcept { return state_.load(std::memory_order_acquire) & ONLY_VALUE; }
+
+    // 等待直到value被设置. 在fiber中只挂起fiber, 不阻塞线程.
+    void wait() {
+        if (hasValue()) {
+            return;
+        }
+        detail::suspendCurrent([this](Func&& resume) {
+            {
+                std::lock_guard<std::mutex> lock(waitMutex_);
+                if (!hasValue_) {
+                    waiters_.push_back(std::move(resume));
+                    return;
+                }
+            }
+            resume();
+        });
+    }
 
     void setExecutor(Executor* executor) { pExecutor_ = executor; }
 
     T& getValue() { return value_; }
 
     void call() {
+        TINY_FUTURE_TRACE(trace::EventKind::CALL, traceId_);
         if (pExecutor_) {
-            // 如何通过后台调用呢？
-            pExecutor_->submit([this] { callback_(*this); });
+            TINY_FUTURE_TRACE(trace::EventKind::ENQUEUE, traceId_);
+            // 持有自身的shared_ptr, 避免Promise/Future先于回调析构.
+            // call()运行在setValue/回调链中, 常在worker线程上, 不能让拒绝的异常传出; executor不接收时在当前线程执行.
+            if (!pExecutor_->trySubmit([self = this->shared_from_this()] { self->invoke(); })) {
+                invoke();
+            }
         }
         else {
-            callback_(*this);
+            invoke();
             // callback_(std::move(value_));
         }
     }
@@ -51,14 +102,26 @@ public:
     SharedPtr static Create() noexcept { return std::make_shared<Self>(); }
 
 private:
+    void invoke() {
+        TINY_FUTURE_TRACE(trace::EventKind::CALLBACK_BEGIN, traceId_);
+        callback_(*this);
+        TINY_FUTURE_TRACE(trace::EventKind::CALLBACK_END, traceId_);
+    }
+
     // union {
     //     Callback callback_; // 配合shared_ptr构造会失败.
     // };
     Callback callback_;
     Executor* pExecutor_{nullptr};
 
+    std::atomic<uint8_t> state_{START};
+    std::mutex waitMutex_;
+    std::vector<Func> waiters_;
     bool hasValue_{false};
     T value_;
+#if TINY_FUTURE_ENABLE_TRACE
+    const uint64_t traceId_{trace::nextId()};
+#endif
 };
 
 #include <memory>
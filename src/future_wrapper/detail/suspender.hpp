@@ -0,0 +1,71 @@
+/* Proj: tiny-future
+ * File: suspender.hpp
+ * Created Date: 2023/5/8
+ * Author: yangyangyang
+ * Description: 阻塞等待的统一入口, 在fiber中挂起fiber, 否则阻塞线程.
+ * -----
+ * Last Modified: 2023/5/8 14:18:36
+ * -----
+ * Copyright (c) 2023  . All rights reserved.
+ */
+#ifndef TINY_FUTURE_SUSPENDER_HPP
+#define TINY_FUTURE_SUSPENDER_HPP
+
+#include "future_wrapper/executor.hpp"
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+// 唤醒注册函数: 参数resume被调用(可在任意线程, 且只调用一次)时, 被挂起的执行流恢复运行.
+using ArmFunc = std::function<void(Func&& resume)>;
+
+// 协作式调度器(如FiberExecutor)在运行用户代码时安装到当前线程.
+class Suspender {
+public:
+    virtual ~Suspender() noexcept = default;
+
+    /**
+     * @brief 挂起当前执行流. 必须在执行流已完全切出之后才调用arm, 避免被提前恢复.
+     */
+    virtual void suspend(const ArmFunc& arm) = 0;
+
+    static Suspender*& current() noexcept {
+        static thread_local Suspender* suspender = nullptr;
+        return suspender;
+    }
+};
+
+namespace detail {
+
+/**
+ * @brief 挂起当前执行流, 直到arm得到的resume被调用.
+ * 当前线程没有安装Suspender时, 退化为条件变量阻塞线程.
+ */
+inline void suspendCurrent(const ArmFunc& arm) {
+    if (Suspender* suspender = Suspender::current()) {
+        suspender->suspend(arm);
+        return;
+    }
+
+    struct Baton {
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool posted{false};
+    };
+    // resume可能在本函数返回后才被析构, 因此共享所有权.
+    auto baton = std::make_shared<Baton>();
+    arm([baton]() {
+        {
+            std::lock_guard<std::mutex> lock(baton->mutex);
+            baton->posted = true;
+        }
+        baton->cv.notify_one();
+    });
+    std::unique_lock<std::mutex> lock(baton->mutex);
+    baton->cv.wait(lock, [&baton]() { return baton->posted; });
+}
+
+} // namespace detail
+
+#endif // TINY_FUTURE_SUSPENDER_HPP
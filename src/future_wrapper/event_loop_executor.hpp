@@ -0,0 +1,290 @@
+/* Proj: tiny-future
+ * File: event_loop_executor.hpp
+ * Created Date: 2023/4/26
+ * Author: yangyangyang
+ * Description: 基于epoll + eventfd的单线程事件循环Executor.
+ * -----
+ * Last Modified: 2023/4/26 16:20:37
+ * -----
+ * Copyright (c) 2023  . All rights reserved.
+ */
+#ifndef TINY_FUTURE_EVENT_LOOP_EXECUTOR_HPP
+#define TINY_FUTURE_EVENT_LOOP_EXECUTOR_HPP
+
+#include "future_wrapper/executor.hpp"
+#include "future_wrapper/future.hpp"
+#include "future_wrapper/promise.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <iterator>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+// 所有任务与fd就绪回调都在同一个loop线程中执行.
+// 跨线程submit通过eventfd唤醒epoll_wait, loop线程内的submit不产生系统调用.
+class EventLoopExecutor : public Executor {
+
+    using Self = EventLoopExecutor;
+    using Mutex = std::mutex;
+
+    using WGLock = std::lock_guard<Mutex>;
+
+    static constexpr int kMaxEvents = 64;
+
+    // 同一fd上等待读/写就绪的Promise, fd就绪后一次性完成并移除关注.
+    struct Watcher {
+        std::vector<Promise<bool>> readers;
+        std::vector<Promise<bool>> writers;
+        uint32_t events{0};
+    };
+
+    int epoll_fd_;
+    int wakeup_fd_;
+    std::thread thread_;
+
+    Mutex mutex_;
+    std::vector<Func> task_queue_;
+    std::unordered_map<int, Watcher> watchers_;
+    // loop已退出, 不再等待fd; 由mutex_保护.
+    bool stopped_{false};
+    std::atomic<bool> should_terminate_;
+
+public:
+    void submit(Func&& func) final {
+        {
+            WGLock lock(mutex_);
+            task_queue_.emplace_back(std::forward<Func>(func));
+        }
+        if (!inLoopThread()) {
+            wakeup();
+        }
+    }
+
+    /**
+     * @brief fd可读(或出错/挂断)时以true完成, 回调在loop线程中执行.
+     * loop停止(WaitAndStop或epoll_wait失败)时仍在等待的Future以false完成; 停止后调用直接返回false.
+     */
+    Future<bool> onReadable(int fd) { return watch(fd, EPOLLIN); }
+
+    /**
+     * @brief fd可写(或出错/挂断)时以true完成, 其余同onReadable.
+     */
+    Future<bool> onWritable(int fd) { return watch(fd, EPOLLOUT); }
+
+    bool inLoopThread() const noexcept { return currentLoop() == this; }
+
+    void WaitAndStop() noexcept {
+        if (!thread_.joinable()) {
+            return;
+        }
+        should_terminate_.store(true);
+        wakeup();
+        thread_.join();
+    }
+
+public:
+    ~EventLoopExecutor() noexcept override {
+        WaitAndStop();
+        ::close(wakeup_fd_);
+        ::close(epoll_fd_);
+    }
+
+    EventLoopExecutor()
+        : epoll_fd_(-1)
+        , wakeup_fd_(-1)
+        , should_terminate_(false) {
+        epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd_ < 0) {
+            throw std::system_error(errno, std::system_category(), "epoll_create1");
+        }
+        wakeup_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (wakeup_fd_ < 0) {
+            const int err = errno;
+            ::close(epoll_fd_);
+            throw std::system_error(err, std::system_category(), "eventfd");
+        }
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = wakeup_fd_;
+        if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wakeup_fd_, &ev) < 0) {
+            const int err = errno;
+            ::close(wakeup_fd_);
+            ::close(epoll_fd_);
+            throw std::system_error(err, std::system_category(), "epoll_ctl");
+        }
+        thread_ = std::thread(&Self::run, this);
+    }
+
+private:
+    static const Self*& currentLoop() noexcept {
+        static thread_local const Self* loop = nullptr;
+        return loop;
+    }
+
+    void run() {
+        currentLoop() = this;
+        epoll_event events[kMaxEvents];
+        while (true) {
+            runPendingTasks();
+            if (should_terminate_.load(std::memory_order_relaxed)) {
+                break;
+            }
+
+            const int n = ::epoll_wait(epoll_fd_, events, kMaxEvents, -1);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+            for (int i = 0; i < n; ++i) {
+                if (events[i].data.fd == wakeup_fd_) {
+                    uint64_t counter;
+                    while (::read(wakeup_fd_, &counter, sizeof(counter)) > 0) {
+                    }
+                    continue;
+                }
+                onReady(events[i].data.fd, events[i].events);
+            }
+        }
+        // 取消的回调提交到本loop, 在最后一轮中执行.
+        cancelWatchers();
+        runPendingTasks();
+    }
+
+    void cancelWatchers() {
+        std::vector<Promise<bool>> cancelled;
+        {
+            WGLock lock(mutex_);
+            stopped_ = true;
+            for (auto& entry : watchers_) {
+                Watcher& watcher = entry.second;
+                std::move(watcher.readers.begin(), watcher.readers.end(), std::back_inserter(cancelled));
+                std::move(watcher.writers.begin(), watcher.writers.end(), std::back_inserter(cancelled));
+                ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, entry.first, nullptr);
+            }
+            watchers_.clear();
+        }
+        for (auto& promise : cancelled) {
+            promise.setValue(false);
+        }
+    }
+
+    // loop线程内提交的任务会追加到队列中, 在同一轮中继续执行直到队列为空.
+    void runPendingTasks() {
+        std::vector<Func> tasks;
+        while (true) {
+            {
+                WGLock lock(mutex_);
+                if (task_queue_.empty()) {
+                    return;
+                }
+                tasks.swap(task_queue_);
+            }
+            for (auto& task : tasks) {
+                task();
+            }
+            tasks.clear();
+        }
+    }
+
+    void onReady(int fd, uint32_t revents) {
+        std::vector<Promise<bool>> ready;
+        {
+            WGLock lock(mutex_);
+            auto it = watchers_.find(fd);
+            if (it == watchers_.end()) {
+                return;
+            }
+            Watcher& watcher = it->second;
+            const bool failed = revents & (EPOLLERR | EPOLLHUP);
+            if (failed || (revents & EPOLLIN)) {
+                std::move(watcher.readers.begin(), watcher.readers.end(), std::back_inserter(ready));
+                watcher.readers.clear();
+            }
+            if (failed || (revents & EPOLLOUT)) {
+                std::move(watcher.writers.begin(), watcher.writers.end(), std::back_inserter(ready));
+                watcher.writers.clear();
+            }
+            // fd可能已被使用者关闭, 此时忽略epoll_ctl的错误.
+            updateInterest(fd, watcher);
+            if (watcher.events == 0) {
+                watchers_.erase(it);
+            }
+        }
+        for (auto& promise : ready) {
+            promise.setValue(true);
+        }
+    }
+
+    Future<bool> watch(int fd, uint32_t event) {
+        Promise<bool> promise;
+        auto future = promise.getFuture();
+
+        WGLock lock(mutex_);
+        if (stopped_) {
+            // loop不再执行任务, 不设置via, 回调在调用者线程执行.
+            promise.setValue(false);
+            return future;
+        }
+        future.via(this);
+        Watcher& watcher = watchers_[fd];
+        auto& waiters = (event == EPOLLIN) ? watcher.readers : watcher.writers;
+        waiters.push_back(std::move(promise));
+        if (!updateInterest(fd, watcher)) {
+            const int err = errno;
+            waiters.pop_back();
+            if (watcher.events == 0) {
+                watchers_.erase(fd);
+            }
+            throw std::system_error(err, std::system_category(), "epoll_ctl");
+        }
+        return future;
+    }
+
+    // 根据等待者重新计算关注的事件, 调用方需持有mutex_.
+    bool updateInterest(int fd, Watcher& watcher) noexcept {
+        uint32_t events = 0;
+        if (!watcher.readers.empty()) {
+            events |= EPOLLIN;
+        }
+        if (!watcher.writers.empty()) {
+            events |= EPOLLOUT;
+        }
+        if (events == watcher.events) {
+            return true;
+        }
+
+        int rc;
+        if (events == 0) {
+            rc = ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+        }
+        else {
+            epoll_event ev{};
+            ev.events = events;
+            ev.data.fd = fd;
+            rc = ::epoll_ctl(epoll_fd_, watcher.events == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, &ev);
+        }
+        if (rc == 0 || events == 0) {
+            watcher.events = events;
+        }
+        return rc == 0;
+    }
+
+    void wakeup() noexcept {
+        const uint64_t one = 1;
+        ssize_t rc = ::write(wakeup_fd_, &one, sizeof(one));
+        (void)rc;
+    }
+};
+
+#endif // TINY_FUTURE_EVENT_LOOP_EXECUTOR_HPP
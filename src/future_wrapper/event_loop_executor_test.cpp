@@ -0,0 +1,115 @@
+/* Proj: tiny-future
+ * File: event_loop_executor_test.cpp
+ * Created Date: 2023/4/26
+ * Author: yangyangyang
+ * Description:
+ * -----
+ * Last Modified: 2023/4/26 17:02:45
+ * -----
+ * Copyright (c) 2023  . All rights reserved.
+ */
+
+#include "future_wrapper/event_loop_executor.hpp"
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+
+TEST(EventLoopExecutor, SubmitRunsOnLoopThread) {
+    EventLoopExecutor loop;
+    Promise<bool> p;
+    auto f = p.getFuture();
+    loop.submit([&loop, &p]() { p.setValue(loop.inLoopThread()); });
+    std::move(f).get();
+    EXPECT_TRUE(p.getSharedState().getValue());
+    EXPECT_FALSE(loop.inLoopThread());
+}
+
+TEST(EventLoopExecutor, PipeReadable) {
+    int fds[2];
+    ASSERT_EQ(::pipe(fds), 0);
+
+    EventLoopExecutor loop;
+    Promise<bool> done;
+    auto doneFuture = done.getFuture();
+
+    auto f = loop.onReadable(fds[0]);
+    f.thenValue([&](bool&& ready) {
+        char c = 0;
+        EXPECT_EQ(::read(fds[0], &c, 1), 1);
+        done.setValue(ready && c == 'x' && loop.inLoopThread());
+    });
+    ASSERT_EQ(::write(fds[1], "x", 1), 1);
+
+    std::move(doneFuture).get();
+    EXPECT_TRUE(done.getSharedState().getValue());
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+TEST(EventLoopExecutor, EventFdReadable) {
+    int efd = ::eventfd(0, EFD_NONBLOCK);
+    ASSERT_GE(efd, 0);
+
+    EventLoopExecutor loop;
+    auto f = loop.onReadable(efd);
+    const uint64_t one = 1;
+    ASSERT_EQ(::write(efd, &one, sizeof(one)), static_cast<ssize_t>(sizeof(one)));
+    std::move(f).get();
+    ::close(efd);
+}
+
+TEST(EventLoopExecutor, SocketPairReadWrite) {
+    int sv[2];
+    ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
+
+    EventLoopExecutor loop;
+    auto readable = loop.onReadable(sv[1]);
+    auto writable = loop.onWritable(sv[0]);
+
+    std::atomic<int> order{0};
+    writable.thenValue([&](bool&&) {
+        order.fetch_add(1);
+        EXPECT_EQ(::write(sv[0], "ping", 4), 4);
+    });
+    std::move(writable).get();
+    std::move(readable).get();
+
+    char buf[4];
+    EXPECT_EQ(::read(sv[1], buf, sizeof(buf)), 4);
+    EXPECT_EQ(std::string(buf, 4), "ping");
+    EXPECT_EQ(order.load(), 1);
+    ::close(sv[0]);
+    ::close(sv[1]);
+}
+
+// loop停止时仍在等待的Future以false完成, get()不会一直阻塞; 停止后的等待直接返回false.
+TEST(EventLoopExecutor, StopCancelsWatchers) {
+    int fds[2];
+    ASSERT_EQ(::pipe(fds), 0);
+
+    EventLoopExecutor loop;
+    auto pending = loop.onReadable(fds[0]);
+    std::atomic<int> cancelled{0};
+    pending.thenValue([&cancelled](bool&& ready) {
+        if (!ready) {
+            ++cancelled;
+        }
+    });
+    auto waiting = loop.onWritable(fds[1]);
+    auto& state = waiting.getSharedState();
+    std::move(waiting).get();
+    EXPECT_TRUE(state.getValue());
+
+    auto blocked = loop.onReadable(fds[0]);
+    auto& blocked_state = blocked.getSharedState();
+    std::thread waiter([&blocked]() { std::move(blocked).get(); });
+    loop.WaitAndStop();
+    waiter.join();
+    EXPECT_FALSE(blocked_state.getValue());
+    EXPECT_EQ(cancelled.load(), 1);
+
+    auto after = loop.onReadable(fds[0]);
+    EXPECT_TRUE(after.getSharedState().hasValue());
+    EXPECT_FALSE(after.getSharedState().getValue());
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
@@ -12,6 +12,7 @@
 #define TINY_FUTURE_EXECUTOR_HPP
 
 #include "future_wrapper/define.hpp"
+#include "future_wrapper/metrics.hpp"
 #include <atomic>
 #include <boost/type_traits.hpp>
 
@@ -22,11 +23,26 @@
 #include <iostream>
 #include <memory>
 #include <queue>
+#include <stdexcept>
 #include <thread>
 #include <vector>
 
 using Func = std::function<void()>;
 
+// 有界队列满时的处理策略
+enum class OverflowPolicy : int8_t {
+    BLOCK = 0,       // 阻塞提交者直到队列有空位; 任务向自己所在的executor提交(如via的后续回调)时不能使用, 否则worker互相等待死锁
+    REJECT = 1,      // 抛出ExecutorRejected
+    DROP_OLDEST = 2, // 丢弃队首(最老)的任务
+    CALLER_RUNS = 3, // 在提交者线程直接执行
+};
+
+class ExecutorRejected : public std::runtime_error {
+public:
+    explicit ExecutorRejected(const std::string& what)
+        : std::runtime_error(what) {}
+};
+
 // 通过Executor(Future-Runtime)将任务(回调函数)异步运行
 class Executor : public MoveOnlyAble {
 public:
@@ -34,6 +50,32 @@ public:
 
 public:
     virtual void submit(Func&& func) = 0;
+
+    // 提交任务, 不接收时返回false且func保持不变, 由调用者决定如何处理. 默认总是接收.
+    virtual bool trySubmit(Func&& func) {
+        submit(std::move(func));
+        return true;
+    }
+
+    // 批量提交funcs[0, n), 默认逐个submit; 实现可以覆盖以合并加锁与唤醒.
+    virtual void submitBatch(Func* funcs, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            submit(std::move(funcs[i]));
+        }
+    }
+
+    // 按顺序提交funcs[0, n)直到第一个不被接收的任务, 返回接收的个数; 之后的任务保持不变.
+    virtual size_t trySubmitBatch(Func* funcs, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            if (!trySubmit(std::move(funcs[i]))) {
+                return i;
+            }
+        }
+        return n;
+    }
+
+    // 已接收的任务是否可能不执行就被丢弃(如DROP_OLDEST).
+    virtual bool mayDropTasks() const noexcept { return false; }
 };
 
 class ThreadExecutor : public Executor {
@@ -44,13 +86,35 @@ class ThreadExecutor : public Executor {
     using WLock = std::unique_lock<Mutex>;
     using WGLock = std::lock_guard<Mutex>;
 
+    struct Task {
+        Func func;
+#if TINY_FUTURE_ENABLE_METRICS
+        int64_t enqueue_ns;
+#endif
+    };
+
     std::vector<std::thread> threads_;
-    std::queue<Func> task_queue_;
+    std::queue<Task> task_queue_;
     mutable Mutex mutex_;
     mutable std::condition_variable cv_;
+    mutable std::condition_variable not_full_cv_;
     std::atomic<bool> should_terminate_;
     std::atomic<int32_t> action_thread_;
 
+    // capacity_ == 0 表示无界.
+    const size_t capacity_;
+    const OverflowPolicy policy_;
+    std::atomic<size_t> queue_depth_;
+    std::atomic<uint64_t> dropped_;
+
+#if TINY_FUTURE_ENABLE_METRICS
+    // 提交侧计数只在mutex_内写入(写者已串行化), metrics()无锁读取; 执行侧指标由各worker独占写入, metrics()时聚合.
+    metrics::SingleWriterCounter submitted_;
+    metrics::SingleWriterCounter rejected_;
+    metrics::SingleWriterCounter caller_runs_;
+    std::vector<std::unique_ptr<metrics::WorkerMetrics>> worker_metrics_;
+#endif
+
 public:
     // void submit(Callback&& callback, Value&& value) {
     //     std::lock_guard<Mutex> lock(mutex_);
@@ -60,14 +124,143 @@ public:
     // }
 
     void submit(Func&& func) final {
-        WGLock lock(mutex_);
-        task_queue_.emplace(std::forward<Func>(func));
+        if (!trySubmit(std::forward<Func>(func))) {
+            throw ExecutorRejected("ThreadExecutor: task queue is full");
+        }
+    }
+
+    /**
+     * @brief 无界队列时一次加锁入队全部任务; 有界队列需要逐个应用OverflowPolicy, 退化为逐个提交.
+     */
+    void submitBatch(Func* funcs, size_t n) final {
+        if (capacity_ > 0) {
+            Executor::submitBatch(funcs, n);
+            return;
+        }
+        if (n == 0) {
+            return;
+        }
+        {
+            WGLock lock(mutex_);
+#if TINY_FUTURE_ENABLE_METRICS
+            submitted_.add(n);
+            const int64_t now = metrics::nowNanos();
+            for (size_t i = 0; i < n; ++i) {
+                task_queue_.push(Task{std::move(funcs[i]), now});
+            }
+#else
+            for (size_t i = 0; i < n; ++i) {
+                task_queue_.push(Task{std::move(funcs[i])});
+            }
+#endif
+            queue_depth_.store(task_queue_.size(), std::memory_order_relaxed);
+        }
+        if (n == 1) {
+            cv_.notify_one();
+        }
+        else {
+            cv_.notify_all();
+        }
+    }
+
+    size_t trySubmitBatch(Func* funcs, size_t n) final {
+        if (capacity_ > 0) {
+            return Executor::trySubmitBatch(funcs, n);
+        }
+        submitBatch(funcs, n);
+        return n;
+    }
+
+    bool mayDropTasks() const noexcept final { return capacity_ > 0 && policy_ == OverflowPolicy::DROP_OLDEST; }
+
+    /**
+     * @brief 按OverflowPolicy提交任务, 仅REJECT策略在队列满时返回false(任务未被接收).
+     */
+    bool trySubmit(Func&& func) final {
+        Func dropped;
+        {
+            WLock lock(mutex_);
+            if (isFull()) {
+                switch (policy_) {
+                case OverflowPolicy::BLOCK:
+                    not_full_cv_.wait(lock, [this]() { return should_terminate_.load() || !isFull(); });
+                    if (!isFull()) {
+                        break;
+                    }
+                    // 已停止且仍然满, 退化为在提交者线程执行.
+                    // fall through
+                case OverflowPolicy::CALLER_RUNS:
+#if TINY_FUTURE_ENABLE_METRICS
+                    caller_runs_.add();
+#endif
+                    lock.unlock();
+                    func();
+                    return true;
+                case OverflowPolicy::REJECT:
+#if TINY_FUTURE_ENABLE_METRICS
+                    rejected_.add();
+#endif
+                    return false;
+                case OverflowPolicy::DROP_OLDEST:
+                    // 在锁外析构, 避免捕获对象的析构函数持锁运行.
+                    dropped = std::move(task_queue_.front().func);
+                    task_queue_.pop();
+                    dropped_.fetch_add(1, std::memory_order_relaxed);
+                    break;
+                }
+            }
+#if TINY_FUTURE_ENABLE_METRICS
+            submitted_.add();
+            task_queue_.push(Task{std::forward<Func>(func), metrics::nowNanos()});
+#else
+            task_queue_.push(Task{std::forward<Func>(func)});
+#endif
+            queue_depth_.store(task_queue_.size(), std::memory_order_relaxed);
+        }
         cv_.notify_one();
+        return true;
+    }
+
+    // 队列深度, 无锁读取(近似值), 供外部做负载控制.
+    size_t queueDepth() const noexcept { return queue_depth_.load(std::memory_order_relaxed); }
+
+    size_t capacity() const noexcept { return capacity_; }
+
+    OverflowPolicy policy() const noexcept { return policy_; }
+
+    // DROP_OLDEST策略下被丢弃的任务数.
+    uint64_t droppedCount() const noexcept { return dropped_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 聚合各worker的指标. 关闭TINY_FUTURE_ENABLE_METRICS时只有队列深度/丢弃数/活跃线程数有效.
+     */
+    metrics::ExecutorMetricsSnapshot metrics() const {
+        metrics::ExecutorMetricsSnapshot snapshot;
+        snapshot.queue_depth = queueDepth();
+        snapshot.dropped = droppedCount();
+        snapshot.active_threads = action_thread_.load(std::memory_order_relaxed);
+#if TINY_FUTURE_ENABLE_METRICS
+        snapshot.submitted = submitted_.load();
+        snapshot.rejected = rejected_.load();
+        snapshot.caller_runs = caller_runs_.load();
+        const int64_t now = metrics::nowNanos();
+        snapshot.worker_busy_ratio.reserve(worker_metrics_.size());
+        for (const auto& worker : worker_metrics_) {
+            snapshot.completed += worker->completed.load();
+            worker->wait_ns.snapshotInto(snapshot.wait_ns);
+            worker->run_ns.snapshotInto(snapshot.run_ns);
+            const int64_t elapsed = now - worker->start_ns;
+            snapshot.worker_busy_ratio.push_back(
+              elapsed > 0 ? static_cast<double>(worker->busy_ns.load()) / static_cast<double>(elapsed) : 0.0);
+        }
+#endif
+        return snapshot;
     }
 
     void WaitAndStop() noexcept {
         should_terminate_.store(true);
         cv_.notify_all();
+        not_full_cv_.notify_all();
         for (auto& t : threads_) {
             t.join();
         }
@@ -77,9 +270,14 @@ public:
 public:
     ~ThreadExecutor() noexcept override { WaitAndStop(); }
 
-    void run(std::string const& thread_name) {
+    void run(std::string const& thread_name, size_t worker_index = 0) {
+#if TINY_FUTURE_ENABLE_METRICS
+        metrics::WorkerMetrics& stat = *worker_metrics_[worker_index];
+#else
+        (void)worker_index;
+#endif
         while (true) {
-            Func task;
+            Task task;
             {
                 std::unique_lock<Mutex> lock(mutex_);
                 cv_.wait(
@@ -89,23 +287,59 @@ public:
                 }
                 task = std::move_if_noexcept(task_queue_.front());
                 task_queue_.pop();
+                queue_depth_.store(task_queue_.size(), std::memory_order_relaxed);
+            }
+            if (capacity_ > 0) {
+                not_full_cv_.notify_one();
             }
 
             ++action_thread_;
-            task();
+#if TINY_FUTURE_ENABLE_METRICS
+            const int64_t start = metrics::nowNanos();
+            stat.wait_ns.record(static_cast<uint64_t>(std::max<int64_t>(start - task.enqueue_ns, 0)));
+            task.func();
+            const auto elapsed = static_cast<uint64_t>(std::max<int64_t>(metrics::nowNanos() - start, 0));
+            stat.run_ns.record(elapsed);
+            stat.busy_ns.add(elapsed);
+            stat.completed.add();
+#else
+            task.func();
+#endif
             --action_thread_;
         }
     }
 
 public:
     explicit ThreadExecutor(unsigned int num_thread /*std::thread::hardware_concurrency()*/)
+        : ThreadExecutor(num_thread, 0, OverflowPolicy::BLOCK) {}
+
+    /**
+     * @param capacity 任务队列容量, 0表示无界.
+     * @param policy 队列满时的处理策略.
+     */
+    ThreadExecutor(unsigned int num_thread, size_t capacity, OverflowPolicy policy)
         : should_terminate_(false)
-        , action_thread_(0) {
+        , action_thread_(0)
+        , capacity_(capacity)
+        , policy_(policy)
+        , queue_depth_(0)
+        , dropped_(0) {
+#if TINY_FUTURE_ENABLE_METRICS
+        // 指标在提交与执行路径上读取时钟, 在这里完成校准.
+        helper::TscClock::warmUp();
+        worker_metrics_.reserve(num_thread);
+        for (unsigned int i = 0; i < num_thread; ++i) {
+            worker_metrics_.emplace_back(new metrics::WorkerMetrics());
+        }
+#endif
         threads_.reserve(num_thread);
         for (unsigned int i = 0; i < num_thread; ++i) {
-            threads_.emplace_back(&Self::run, this, std::string("worker-").append(std::to_string(i)));
+            threads_.emplace_back(&Self::run, this, std::string("worker-").append(std::to_string(i)), i);
         }
     }
+
+private:
+    bool isFull() const noexcept { return capacity_ > 0 && task_queue_.size() >= capacity_; }
 };
 
 #endif // TINY_FUTURE_EXECUTOR_HPP
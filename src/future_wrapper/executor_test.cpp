@@ -0,0 +1,209 @@
+/* Proj: tiny-future
+ * File: executor_test.cpp
+ * Created Date: 2023/4/25
+ * Author: yangyangyang
+ * Description:
+ * -----
+ * Last Modified: 2023/4/25 10:12:31
+ * -----
+ * Copyright (c) 2023  . All rights reserved.
+ */
+
+#include "future_wrapper/executor.hpp"
+#include "future_wrapper/future.hpp"
+#include "future_wrapper/promise.hpp"
+#include <gtest/gtest.h>
+
+namespace {
+
+// 阻塞唯一的worker, 使后续任务都留在队列中.
+struct Gate {
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool opened{false};
+
+    void wait() {
+        std::unique_lock<std::mutex> lk(mutex);
+        cv.wait(lk, [this]() { return opened; });
+    }
+
+    void open() {
+        {
+            std::lock_guard<std::mutex> lk(mutex);
+            opened = true;
+        }
+        cv.notify_all();
+    }
+};
+
+void waitUntilStarted(std::atomic<bool>& started) {
+    while (!started.load()) {
+        std::this_thread::yield();
+    }
+}
+
+} // namespace
+
+TEST(ThreadExecutor, Unbounded) {
+    std::atomic<int> counter{0};
+    {
+        ThreadExecutor executor(2);
+        for (int i = 0; i < 100; ++i) {
+            executor.submit([&counter]() { ++counter; });
+        }
+    }
+    EXPECT_EQ(counter.load(), 100);
+}
+
+TEST(ThreadExecutor, SubmitBatch) {
+    std::atomic<int> counter{0};
+    {
+        ThreadExecutor executor(2);
+        std::vector<Func> batch;
+        for (int i = 0; i < 100; ++i) {
+            batch.emplace_back([&counter]() { ++counter; });
+        }
+        executor.submitBatch(batch.data(), batch.size());
+    }
+    EXPECT_EQ(counter.load(), 100);
+}
+
+// 有界队列逐个应用OverflowPolicy.
+TEST(ThreadExecutor, SubmitBatchBounded) {
+    Gate gate;
+    std::atomic<bool> started{false};
+    ThreadExecutor executor(1, 2, OverflowPolicy::REJECT);
+    executor.submit([&]() {
+        started = true;
+        gate.wait();
+    });
+    waitUntilStarted(started);
+
+    std::vector<Func> batch(3, []() {});
+    EXPECT_THROW(executor.submitBatch(batch.data(), batch.size()), ExecutorRejected);
+    EXPECT_EQ(executor.queueDepth(), 2);
+
+    gate.open();
+}
+
+TEST(ThreadExecutor, RejectWhenFull) {
+    Gate gate;
+    std::atomic<bool> started{false};
+    ThreadExecutor executor(1, 2, OverflowPolicy::REJECT);
+    executor.submit([&]() {
+        started = true;
+        gate.wait();
+    });
+    waitUntilStarted(started);
+
+    EXPECT_TRUE(executor.trySubmit([]() {}));
+    EXPECT_TRUE(executor.trySubmit([]() {}));
+    EXPECT_EQ(executor.queueDepth(), 2);
+    EXPECT_FALSE(executor.trySubmit([]() {}));
+    EXPECT_THROW(executor.submit([]() {}), ExecutorRejected);
+
+    gate.open();
+}
+
+// 队列满时via的回调不被接收, 在setValue的线程上执行, 不抛出也不丢失.
+TEST(ThreadExecutor, RejectedContinuationRunsInline) {
+    Gate gate;
+    std::atomic<bool> started{false};
+    ThreadExecutor executor(1, 1, OverflowPolicy::REJECT);
+    executor.submit([&]() {
+        started = true;
+        gate.wait();
+    });
+    waitUntilStarted(started);
+    executor.submit([]() {});
+
+    Promise<int> first;
+    Promise<int> second;
+    auto first_future = first.getFuture();
+    auto second_future = second.getFuture();
+    first_future.via(&executor);
+    second_future.via(&executor);
+    std::vector<std::thread::id> runners;
+    int result = 0;
+    first_future.thenValue([&](int&& value) {
+        runners.push_back(std::this_thread::get_id());
+        second.setValue(value + 1);
+    });
+    second_future.thenValue([&](int&& value) {
+        runners.push_back(std::this_thread::get_id());
+        result = value;
+    });
+    first.setValue(1);
+
+    EXPECT_EQ(result, 2);
+    EXPECT_EQ(runners, (std::vector<std::thread::id>{std::this_thread::get_id(), std::this_thread::get_id()}));
+    gate.open();
+}
+
+TEST(ThreadExecutor, DropOldest) {
+    Gate gate;
+    std::atomic<bool> started{false};
+    std::vector<int> order;
+    {
+        ThreadExecutor executor(1, 2, OverflowPolicy::DROP_OLDEST);
+        executor.submit([&]() {
+            started = true;
+            gate.wait();
+        });
+        waitUntilStarted(started);
+
+        for (int i = 0; i < 4; ++i) {
+            executor.submit([&order, i]() { order.push_back(i); });
+        }
+        EXPECT_EQ(executor.queueDepth(), 2);
+        EXPECT_EQ(executor.droppedCount(), 2);
+        gate.open();
+    }
+    EXPECT_EQ(order, (std::vector<int>{2, 3}));
+}
+
+TEST(ThreadExecutor, CallerRuns) {
+    Gate gate;
+    std::atomic<bool> started{false};
+    ThreadExecutor executor(1, 1, OverflowPolicy::CALLER_RUNS);
+    executor.submit([&]() {
+        started = true;
+        gate.wait();
+    });
+    waitUntilStarted(started);
+
+    executor.submit([]() {});
+    std::thread::id runner;
+    executor.submit([&runner]() { runner = std::this_thread::get_id(); });
+    EXPECT_EQ(runner, std::this_thread::get_id());
+
+    gate.open();
+}
+
+TEST(ThreadExecutor, BlockUntilSpace) {
+    Gate gate;
+    std::atomic<bool> started{false};
+    std::atomic<int> counter{0};
+    {
+        ThreadExecutor executor(1, 1, OverflowPolicy::BLOCK);
+        executor.submit([&]() {
+            started = true;
+            gate.wait();
+        });
+        waitUntilStarted(started);
+        executor.submit([&counter]() { ++counter; });
+
+        std::atomic<bool> submitted{false};
+        std::thread producer([&]() {
+            executor.submit([&counter]() { ++counter; });
+            submitted = true;
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        EXPECT_FALSE(submitted.load());
+
+        gate.open();
+        producer.join();
+        EXPECT_TRUE(submitted.load());
+    }
+    EXPECT_EQ(counter.load(), 2);
+}
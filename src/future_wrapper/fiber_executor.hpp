@@ -0,0 +1,402 @@
+/* Proj: tiny-future
+ * File: fiber_executor.hpp
+ * Created Date: 2023/5/8
+ * Author: yangyangyang
+ * Description: 基于boost.context的M:N协程Executor.
+ * -----
+ * Last Modified: 2023/5/9 17:40:12
+ * -----
+ * Copyright (c) 2023  . All rights reserved.
+ */
+#ifndef TINY_FUTURE_FIBER_EXECUTOR_HPP
+#define TINY_FUTURE_FIBER_EXECUTOR_HPP
+
+#include "future_wrapper/detail/suspender.hpp"
+#include "future_wrapper/executor.hpp"
+
+#include <boost/context/fiber.hpp>
+#include <boost/context/stack_context.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <queue>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace detail {
+
+/**
+ * 复用fiber栈, 每个栈底部(低地址)有一页PROT_NONE保护页, 栈溢出时触发SIGSEGV而不是踩坏其他内存.
+ */
+class FiberStackPool : public MoveOnlyAble {
+public:
+    explicit FiberStackPool(size_t stack_size, size_t max_cached)
+        : page_size_(static_cast<size_t>(::sysconf(_SC_PAGESIZE)))
+        , stack_size_((stack_size + page_size_ - 1) / page_size_ * page_size_)
+        , max_cached_(max_cached) {}
+
+    ~FiberStackPool() noexcept {
+        for (auto& sctx : cached_) {
+            unmap(sctx);
+        }
+    }
+
+    boost::context::stack_context allocate() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!cached_.empty()) {
+                auto sctx = cached_.back();
+                cached_.pop_back();
+                return sctx;
+            }
+        }
+
+        const size_t total = stack_size_ + page_size_;
+        void* base = ::mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+        if (base == MAP_FAILED) {
+            throw std::system_error(errno, std::system_category(), "mmap fiber stack");
+        }
+        if (::mprotect(base, page_size_, PROT_NONE) != 0) {
+            const int err = errno;
+            ::munmap(base, total);
+            throw std::system_error(err, std::system_category(), "mprotect fiber stack");
+        }
+
+        boost::context::stack_context sctx;
+        sctx.size = stack_size_;
+        sctx.sp = static_cast<char*>(base) + total;
+        return sctx;
+    }
+
+    void deallocate(boost::context::stack_context& sctx) noexcept {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (cached_.size() < max_cached_) {
+                cached_.push_back(sctx);
+                return;
+            }
+        }
+        unmap(sctx);
+    }
+
+    size_t stackSize() const noexcept { return stack_size_; }
+
+private:
+    void unmap(boost::context::stack_context& sctx) noexcept {
+        const size_t total = sctx.size + page_size_;
+        ::munmap(static_cast<char*>(sctx.sp) - total, total);
+    }
+
+    const size_t page_size_;
+    const size_t stack_size_;
+    const size_t max_cached_;
+    std::mutex mutex_;
+    std::vector<boost::context::stack_context> cached_;
+};
+
+// 满足boost.context的StackAllocator概念, 只持有pool的指针.
+struct PooledStackAllocator {
+    FiberStackPool* pool;
+
+    boost::context::stack_context allocate() { return pool->allocate(); }
+
+    void deallocate(boost::context::stack_context& sctx) noexcept { pool->deallocate(sctx); }
+};
+
+} // namespace detail
+
+/**
+ * M:N协程Executor: submit的每个任务运行在独立的fiber中, 由num_thread个worker线程调度.
+ *
+ * fiber内的Future::get()/this_fiber::sleepFor()/FiberMutex只挂起当前fiber, worker线程继续运行其他fiber,
+ * 因此大量阻塞风格的任务只需少量线程. 被挂起的fiber恢复时可能运行在另一个worker上.
+ * 析构时等待所有fiber结束.
+ */
+class FiberExecutor : public Executor, public Suspender {
+
+    using Self = FiberExecutor;
+    using Mutex = std::mutex;
+    using Clock = std::chrono::steady_clock;
+
+    using WLock = std::unique_lock<Mutex>;
+    using WGLock = std::lock_guard<Mutex>;
+
+    struct Fiber {
+        boost::context::fiber context;
+        // 最近一次切入该fiber的worker上下文, fiber挂起或结束时切回这里.
+        // 不能放在thread_local中: fiber恢复后可能已经运行在另一个worker上.
+        boost::context::fiber caller;
+        // fiber切出后由worker执行的唤醒注册函数, 指向fiber栈上的对象.
+        const ArmFunc* arm{nullptr};
+    };
+
+    struct Timer {
+        Clock::time_point deadline;
+        uint64_t seq;
+        Func resume;
+
+        bool operator>(const Timer& other) const noexcept {
+            return deadline != other.deadline ? deadline > other.deadline : seq > other.seq;
+        }
+    };
+
+    detail::FiberStackPool stack_pool_;
+
+    std::vector<std::thread> threads_;
+    Mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Fiber*> ready_;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers_;
+    uint64_t timer_seq_{0};
+    size_t live_fibers_{0};
+    bool should_terminate_{false};
+
+public:
+    void submit(Func&& func) final {
+        auto* fiber = new Fiber();
+        fiber->context = boost::context::fiber(
+          std::allocator_arg, detail::PooledStackAllocator{&stack_pool_},
+          [fiber, func = std::forward<Func>(func)](boost::context::fiber&& caller) mutable {
+              fiber->caller = std::move(caller);
+              func();
+              // 任务中持有的资源在切回worker之前释放.
+              func = nullptr;
+              return std::move(fiber->caller);
+          });
+        {
+            WGLock lock(mutex_);
+            ++live_fibers_;
+            ready_.push_back(fiber);
+        }
+        cv_.notify_one();
+    }
+
+    void suspend(const ArmFunc& arm) final {
+        Fiber* fiber = running();
+        assert(fiber != nullptr);
+        fiber->arm = &arm;
+        boost::context::fiber caller = std::move(fiber->caller).resume();
+        fiber->caller = std::move(caller);
+    }
+
+    // 将当前fiber挂起至deadline, 不在fiber中时阻塞线程.
+    void sleepUntil(Clock::time_point deadline) {
+        detail::suspendCurrent([this, deadline](Func&& resume) {
+            {
+                WGLock lock(mutex_);
+                timers_.push(Timer{deadline, timer_seq_++, std::move(resume)});
+            }
+            // 新的定时器可能早于worker当前等待的时间点.
+            cv_.notify_one();
+        });
+    }
+
+    // 当前线程正在运行的FiberExecutor, 不在fiber中时为nullptr.
+    static Self* current() noexcept { return dynamic_cast<Self*>(Suspender::current()); }
+
+    size_t stackSize() const noexcept { return stack_pool_.stackSize(); }
+
+    void WaitAndStop() noexcept {
+        {
+            WGLock lock(mutex_);
+            should_terminate_ = true;
+        }
+        cv_.notify_all();
+        for (auto& t : threads_) {
+            t.join();
+        }
+        threads_.clear();
+    }
+
+public:
+    ~FiberExecutor() noexcept override { WaitAndStop(); }
+
+    /**
+     * @param stack_size 每个fiber的栈大小(不含保护页).
+     * @param max_cached_stacks 缓存复用的栈数量上限.
+     */
+    explicit FiberExecutor(unsigned int num_thread, size_t stack_size = 64 * 1024, size_t max_cached_stacks = 1024)
+        : stack_pool_(stack_size, max_cached_stacks) {
+        threads_.reserve(num_thread);
+        for (unsigned int i = 0; i < num_thread; ++i) {
+            threads_.emplace_back(&Self::run, this, std::string("fiber-worker-").append(std::to_string(i)));
+        }
+    }
+
+    void run(std::string const& thread_name) {
+        // 线程名最长15个字符.
+        ::pthread_setname_np(::pthread_self(), thread_name.substr(0, 15).c_str());
+        std::vector<Func> expired;
+        while (true) {
+            Fiber* fiber = nullptr;
+            {
+                WLock lock(mutex_);
+                while (true) {
+                    const auto now = Clock::now();
+                    while (!timers_.empty() && timers_.top().deadline <= now) {
+                        expired.push_back(std::move(const_cast<Timer&>(timers_.top()).resume));
+                        timers_.pop();
+                    }
+                    if (!expired.empty()) {
+                        // resume会重新加锁调度fiber.
+                        lock.unlock();
+                        for (auto& resume : expired) {
+                            resume();
+                        }
+                        expired.clear();
+                        lock.lock();
+                        continue;
+                    }
+                    if (!ready_.empty()) {
+                        fiber = ready_.front();
+                        ready_.pop_front();
+                        break;
+                    }
+                    if (should_terminate_ && live_fibers_ == 0) {
+                        return;
+                    }
+                    if (timers_.empty()) {
+                        cv_.wait(lock);
+                    }
+                    else {
+                        // 等待期间堆可能被修改, 不能引用堆中的元素.
+                        const auto deadline = timers_.top().deadline;
+                        cv_.wait_until(lock, deadline);
+                    }
+                }
+            }
+            resumeFiber(fiber);
+        }
+    }
+
+private:
+    static Fiber*& running() noexcept {
+        static thread_local Fiber* fiber = nullptr;
+        return fiber;
+    }
+
+    void schedule(Fiber* fiber) {
+        {
+            WGLock lock(mutex_);
+            ready_.push_back(fiber);
+        }
+        cv_.notify_one();
+    }
+
+    void resumeFiber(Fiber* fiber) {
+        running() = fiber;
+        Suspender::current() = this;
+        fiber->context = std::move(fiber->context).resume();
+        Suspender::current() = nullptr;
+        running() = nullptr;
+
+        if (!fiber->context) {
+            delete fiber;
+            bool last;
+            {
+                WGLock lock(mutex_);
+                last = --live_fibers_ == 0 && should_terminate_;
+            }
+            if (last) {
+                cv_.notify_all();
+            }
+            return;
+        }
+
+        // fiber已完全切出, 此时再注册唤醒才是安全的.
+        // arm在fiber栈上, resume之后fiber可能立即在其他worker上继续运行并销毁它, 因此先拷贝.
+        ArmFunc arm = *fiber->arm;
+        fiber->arm = nullptr;
+        arm([this, fiber]() { schedule(fiber); });
+    }
+};
+
+namespace this_fiber {
+
+// 在fiber中挂起当前fiber, 否则阻塞当前线程.
+template <class Rep, class Period>
+void sleepFor(const std::chrono::duration<Rep, Period>& duration) {
+    if (FiberExecutor* executor = FiberExecutor::current()) {
+        executor->sleepUntil(std::chrono::steady_clock::now() +
+                             std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration));
+        return;
+    }
+    std::this_thread::sleep_for(duration);
+}
+
+// 让出worker, 当前fiber排到就绪队列末尾.
+inline void yield() {
+    if (Suspender::current() == nullptr) {
+        std::this_thread::yield();
+        return;
+    }
+    detail::suspendCurrent([](Func&& resume) { resume(); });
+}
+
+} // namespace this_fiber
+
+/**
+ * 互斥锁, 在fiber中等待时挂起fiber而不阻塞worker线程. 在普通线程中同样可用.
+ * 解锁时直接把所有权交给队首等待者, 保证FIFO.
+ */
+class FiberMutex : public MoveOnlyAble {
+public:
+    FiberMutex() noexcept = default;
+    FiberMutex(FiberMutex&&) = delete;
+
+    void lock() {
+        if (try_lock()) {
+            return;
+        }
+        detail::suspendCurrent([this](Func&& resume) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (locked_) {
+                    waiters_.push_back(std::move(resume));
+                    return;
+                }
+                locked_ = true;
+            }
+            resume();
+        });
+    }
+
+    bool try_lock() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (locked_) {
+            return false;
+        }
+        locked_ = true;
+        return true;
+    }
+
+    void unlock() {
+        Func next;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            assert(locked_);
+            if (waiters_.empty()) {
+                locked_ = false;
+                return;
+            }
+            next = std::move(waiters_.front());
+            waiters_.pop_front();
+        }
+        next();
+    }
+
+private:
+    std::mutex mutex_;
+    bool locked_{false};
+    std::deque<Func> waiters_;
+};
+
+#endif // TINY_FUTURE_FIBER_EXECUTOR_HPP
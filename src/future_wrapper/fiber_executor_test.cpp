@@ -0,0 +1,93 @@
+/* Proj: tiny-future
+ * File: fiber_executor_test.cpp
+ * Created Date: 2023/5/9
+ * Author: yangyangyang
+ * Description:
+ * -----
+ * Last Modified: 2023/5/9 18:02:33
+ * -----
+ * Copyright (c) 2023  . All rights reserved.
+ */
+
+#include "future_wrapper/fiber_executor.hpp"
+#include "future_wrapper/future.hpp"
+#include "future_wrapper/promise.hpp"
+#include <gtest/gtest.h>
+
+TEST(FiberExecutor, ThousandsOfSleepingTasks) {
+    constexpr int kTasks = 5000;
+    std::atomic<int> done{0};
+    const auto start = std::chrono::steady_clock::now();
+    {
+        FiberExecutor executor(2);
+        for (int i = 0; i < kTasks; ++i) {
+            executor.submit([&done]() {
+                this_fiber::sleepFor(std::chrono::milliseconds(100));
+                ++done;
+            });
+        }
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_EQ(done.load(), kTasks);
+    // 阻塞的是fiber而不是线程, 总耗时远小于 kTasks * 100ms / 2.
+    EXPECT_LT(elapsed, std::chrono::seconds(5));
+}
+
+TEST(FiberExecutor, FutureGetSuspendsFiber) {
+    FiberExecutor executor(1);
+    Promise<int> promise;
+    auto future = promise.getFuture();
+
+    std::atomic<int> result{0};
+    std::atomic<bool> other_ran{false};
+    executor.submit([&]() {
+        std::move(future).get();
+        result = future.getSharedState().getValue();
+    });
+    // 唯一的worker被上面的fiber"阻塞"时, 其他fiber仍然可以运行.
+    executor.submit([&]() { other_ran = true; });
+    while (!other_ran.load()) {
+        std::this_thread::yield();
+    }
+    EXPECT_EQ(result.load(), 0);
+
+    promise.setValue(42);
+    executor.WaitAndStop();
+    EXPECT_EQ(result.load(), 42);
+}
+
+TEST(FiberExecutor, MutexAcrossFibers) {
+    constexpr int kFibers = 200;
+    constexpr int kIncrements = 100;
+    FiberMutex mutex;
+    int counter = 0;
+    {
+        FiberExecutor executor(4);
+        for (int i = 0; i < kFibers; ++i) {
+            executor.submit([&]() {
+                for (int j = 0; j < kIncrements; ++j) {
+                    std::lock_guard<FiberMutex> lock(mutex);
+                    const int value = counter;
+                    // 持锁期间让出, 其他fiber只能挂起在锁上.
+                    this_fiber::yield();
+                    counter = value + 1;
+                }
+            });
+        }
+    }
+    EXPECT_EQ(counter, kFibers * kIncrements);
+}
+
+TEST(FiberExecutor, OutsideFiberFallsBackToThread) {
+    FiberMutex mutex;
+    mutex.lock();
+    EXPECT_FALSE(mutex.try_lock());
+    std::thread other([&]() {
+        std::lock_guard<FiberMutex> lock(mutex);
+    });
+    this_fiber::sleepFor(std::chrono::milliseconds(10));
+    mutex.unlock();
+    other.join();
+    EXPECT_TRUE(mutex.try_lock());
+    mutex.unlock();
+}
@@ -45,9 +45,8 @@ void Future<T>::thenValue(Fn&& func) noexcept {
 
 template <typename T>
 void Future<T>::get() && {
-    auto&& sharedState = getSharedState();
-    assert(sharedState.hasValue());
-    sharedState.call();
+    // 回调已在value与callback都就绪时自动触发, 这里只需等待value.
+    getSharedState().wait();
 }
 
 #endif // TINY_FUTURE_FUTURE_INL_HPP
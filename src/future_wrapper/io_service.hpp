@@ -0,0 +1,515 @@
+/* Proj: tiny-future
+ * File: io_service.hpp
+ * Created Date: 2023/4/28
+ * Author: yangyangyang
+ * Description: 基于io_uring的异步文件IO, 不可用时退化为阻塞线程池.
+ * -----
+ * Last Modified: 2023/4/28 11:37:02
+ * -----
+ * Copyright (c) 2023  . All rights reserved.
+ */
+#ifndef TINY_FUTURE_IO_SERVICE_HPP
+#define TINY_FUTURE_IO_SERVICE_HPP
+
+#include "future_wrapper/executor.hpp"
+#include "future_wrapper/future.hpp"
+#include "future_wrapper/promise.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+enum class IoBackend : int8_t {
+    AUTO = 0,     // 优先io_uring, 不可用时退化为BLOCKING
+    IO_URING = 1, // 仅io_uring, 不可用时构造抛出std::system_error
+    BLOCKING = 2, // 阻塞线程池
+};
+
+namespace detail {
+
+// 不依赖liburing, 直接通过系统调用使用io_uring.
+// 只允许单线程(IoService的completer线程)访问.
+class IoUring : public MoveOnlyAble {
+public:
+    explicit IoUring(unsigned entries) {
+        io_uring_params params{};
+        ring_fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+        if (ring_fd_ < 0) {
+            throw std::system_error(errno, std::system_category(), "io_uring_setup");
+        }
+        sq_entries_ = params.sq_entries;
+        cq_entries_ = params.cq_entries;
+
+        sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+        cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        single_mmap_ = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_mmap_) {
+            sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+        }
+
+        sq_ring_ = mapOrThrow(sq_ring_size_, IORING_OFF_SQ_RING);
+        cq_ring_ = single_mmap_ ? sq_ring_ : mapOrThrow(cq_ring_size_, IORING_OFF_CQ_RING);
+        sqes_ = static_cast<io_uring_sqe*>(mapOrThrow(sq_entries_ * sizeof(io_uring_sqe), IORING_OFF_SQES));
+
+        auto* sq = static_cast<char*>(sq_ring_);
+        sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+        auto* cq = static_cast<char*>(cq_ring_);
+        cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    }
+
+    ~IoUring() noexcept { release(); }
+
+    unsigned sqEntries() const noexcept { return sq_entries_; }
+
+    unsigned cqEntries() const noexcept { return cq_entries_; }
+
+    // 通过IORING_REGISTER_PROBE检查内核是否支持全部opcode; 不支持PROBE的内核(5.6之前)返回false.
+    bool supports(std::initializer_list<uint8_t> opcodes) const noexcept {
+        constexpr unsigned kOps = 256;
+        std::vector<char> storage(sizeof(io_uring_probe) + kOps * sizeof(io_uring_probe_op), 0);
+        auto* probe = reinterpret_cast<io_uring_probe*>(storage.data());
+        if (::syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_PROBE, probe, kOps) < 0) {
+            return false;
+        }
+        for (uint8_t op : opcodes) {
+            if (op > probe->last_op || (probe->ops[op].flags & IO_URING_OP_SUPPORTED) == 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // 获取一个空闲SQE, SQ已满时返回nullptr. 需调用enter提交.
+    io_uring_sqe* getSqe() noexcept {
+        const unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+        if (local_tail_ - head >= sq_entries_) {
+            return nullptr;
+        }
+        const unsigned idx = local_tail_ & sq_mask_;
+        io_uring_sqe* sqe = &sqes_[idx];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sq_array_[idx] = idx;
+        ++local_tail_;
+        return sqe;
+    }
+
+    /**
+     * @brief 提交所有新的SQE, 并等待至少min_complete个完成事件.
+     * @return 提交的SQE数量, 失败时为-errno.
+     */
+    int enter(unsigned min_complete) noexcept {
+        const unsigned to_submit = local_tail_ - __atomic_load_n(sq_tail_, __ATOMIC_RELAXED);
+        __atomic_store_n(sq_tail_, local_tail_, __ATOMIC_RELEASE);
+        const unsigned flags = min_complete > 0 ? IORING_ENTER_GETEVENTS : 0;
+        while (true) {
+            const int rc =
+              static_cast<int>(::syscall(__NR_io_uring_enter, ring_fd_, to_submit, min_complete, flags, nullptr, 0));
+            if (rc >= 0 || errno != EINTR) {
+                return rc >= 0 ? rc : -errno;
+            }
+        }
+    }
+
+    // 依次处理所有已完成的CQE.
+    template <typename Fn>
+    unsigned reap(Fn&& fn) {
+        unsigned head = *cq_head_;
+        const unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        unsigned count = 0;
+        for (; head != tail; ++head, ++count) {
+            const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+            fn(cqe.user_data, cqe.res);
+        }
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+        return count;
+    }
+
+private:
+    void* mapOrThrow(size_t size, off_t offset) {
+        void* ptr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, offset);
+        if (ptr == MAP_FAILED) {
+            const int err = errno;
+            release();
+            throw std::system_error(err, std::system_category(), "mmap io_uring");
+        }
+        return ptr;
+    }
+
+    void release() noexcept {
+        if (sqes_ != nullptr) {
+            ::munmap(sqes_, sq_entries_ * sizeof(io_uring_sqe));
+            sqes_ = nullptr;
+        }
+        if (cq_ring_ != nullptr && cq_ring_ != sq_ring_) {
+            ::munmap(cq_ring_, cq_ring_size_);
+        }
+        cq_ring_ = nullptr;
+        if (sq_ring_ != nullptr) {
+            ::munmap(sq_ring_, sq_ring_size_);
+            sq_ring_ = nullptr;
+        }
+        if (ring_fd_ >= 0) {
+            ::close(ring_fd_);
+            ring_fd_ = -1;
+        }
+    }
+
+    int ring_fd_{-1};
+    bool single_mmap_{false};
+    unsigned sq_entries_{0}, cq_entries_{0};
+    size_t sq_ring_size_{0}, cq_ring_size_{0};
+    void* sq_ring_{nullptr};
+    void* cq_ring_{nullptr};
+    io_uring_sqe* sqes_{nullptr};
+
+    unsigned *sq_head_{nullptr}, *sq_tail_{nullptr}, *sq_array_{nullptr};
+    unsigned *cq_head_{nullptr}, *cq_tail_{nullptr};
+    unsigned sq_mask_{0}, cq_mask_{0};
+    io_uring_cqe* cqes_{nullptr};
+    unsigned local_tail_{0};
+};
+
+} // namespace detail
+
+/**
+ * 异步文件IO服务, 所有操作返回Future<ssize_t>, 值为对应系统调用的返回值, 失败时为-errno.
+ *
+ * io_uring模式下, 调用方只将请求放入待提交队列; 单个completer线程将积压的请求批量填入SQ,
+ * 用一次io_uring_enter提交并收割完成事件, 通过SharedState完成Promise.
+ * 回调默认在completer线程中执行, 耗时回调请通过Future::via切换到其他Executor.
+ * io_uring_enter出现无法恢复的错误时ring停止, 在途与之后的请求以该错误的-errno完成.
+ * 单次读写最多kMaxIoLen字节, 更长的请求与pread/pwrite一样返回短读写.
+ */
+class IoService : public MoveOnlyAble {
+
+    using Self = IoService;
+    using Mutex = std::mutex;
+    using WGLock = std::lock_guard<Mutex>;
+
+    // completer线程挂在eventfd上的读请求, 用于唤醒.
+    static constexpr uint64_t kWakeupTag = 0;
+
+    enum class Op : uint8_t { READ, WRITE, FSYNC, OPENAT };
+
+    struct Request {
+        Op op;
+        int fd;
+        void* buf;
+        size_t len;
+        off_t offset;
+        int flags;
+        mode_t mode;
+        std::string path;
+        Promise<ssize_t> promise;
+        // 已填入SQ的请求链表, 只由completer线程访问.
+        Request* prev;
+        Request* next;
+    };
+
+    // 单次提交的最大长度, 与内核对read/write的限制(MAX_RW_COUNT)相同, 超出部分表现为短读写.
+    static constexpr size_t kMaxIoLen = 0x7ffff000;
+
+public:
+    /**
+     * @param entries io_uring的SQ大小.
+     * @param blocking_threads 阻塞模式下线程池的大小.
+     */
+    explicit IoService(IoBackend backend = IoBackend::AUTO, unsigned entries = 256, unsigned blocking_threads = 4)
+        : backend_(IoBackend::BLOCKING) {
+        if (backend != IoBackend::BLOCKING) {
+            try {
+                ring_.reset(new detail::IoUring(entries));
+                // 5.1~5.5的内核可以创建ring, 但READ/WRITE/OPENAT等opcode会以-EINVAL完成.
+                if (!ring_->supports({IORING_OP_READ, IORING_OP_WRITE, IORING_OP_FSYNC, IORING_OP_OPENAT})) {
+                    throw std::system_error(ENOSYS, std::system_category(), "io_uring opcodes unsupported");
+                }
+                wakeup_fd_ = ::eventfd(0, EFD_CLOEXEC);
+                if (wakeup_fd_ < 0) {
+                    throw std::system_error(errno, std::system_category(), "eventfd");
+                }
+                backend_ = IoBackend::IO_URING;
+            }
+            catch (const std::system_error&) {
+                ring_.reset();
+                if (backend == IoBackend::IO_URING) {
+                    throw;
+                }
+            }
+        }
+
+        if (backend_ == IoBackend::IO_URING) {
+            thread_ = std::thread(&Self::run, this);
+        }
+        else {
+            blocking_executor_.reset(new ThreadExecutor(blocking_threads));
+        }
+    }
+
+    ~IoService() noexcept {
+        if (thread_.joinable()) {
+            {
+                WGLock lock(mutex_);
+                should_terminate_ = true;
+            }
+            wakeup();
+            thread_.join();
+        }
+        // 先关闭ring, 取消仍挂在eventfd上的读请求.
+        ring_.reset();
+        if (wakeup_fd_ >= 0) {
+            ::close(wakeup_fd_);
+        }
+        // 阻塞线程池析构时会执行完所有剩余任务.
+        blocking_executor_.reset();
+    }
+
+    IoBackend backend() const noexcept { return backend_; }
+
+    Future<ssize_t> read(int fd, void* buf, size_t len, off_t offset) {
+        return enqueue(newRequest(Op::READ, fd, buf, len, offset));
+    }
+
+    Future<ssize_t> write(int fd, const void* buf, size_t len, off_t offset) {
+        return enqueue(newRequest(Op::WRITE, fd, const_cast<void*>(buf), len, offset));
+    }
+
+    Future<ssize_t> fsync(int fd) { return enqueue(newRequest(Op::FSYNC, fd, nullptr, 0, 0)); }
+
+    Future<ssize_t> openat(int dirfd, const std::string& path, int flags, mode_t mode = 0644) {
+        auto req = newRequest(Op::OPENAT, dirfd, nullptr, 0, 0);
+        req->path = path;
+        req->flags = flags;
+        req->mode = mode;
+        return enqueue(std::move(req));
+    }
+
+private:
+    static std::unique_ptr<Request> newRequest(Op op, int fd, void* buf, size_t len, off_t offset) {
+        std::unique_ptr<Request> req(new Request{});
+        req->op = op;
+        req->fd = fd;
+        req->buf = buf;
+        req->len = len;
+        req->offset = offset;
+        return req;
+    }
+
+    Future<ssize_t> enqueue(std::unique_ptr<Request> req) {
+        auto future = req->promise.getFuture();
+        if (backend_ == IoBackend::BLOCKING) {
+            std::shared_ptr<Request> shared(std::move(req));
+            blocking_executor_->submit([shared]() { shared->promise.setValue(runBlocking(*shared)); });
+            return future;
+        }
+
+        bool needWakeup;
+        {
+            WGLock lock(mutex_);
+            if (ring_error_ != 0) {
+                // ring已停止, 直接失败.
+                req->promise.setValue(static_cast<ssize_t>(-ring_error_));
+                return future;
+            }
+            // completer线程每轮会取走全部积压的请求, 只有队列由空变非空时才需要唤醒.
+            needWakeup = pending_.empty();
+            pending_.push_back(req.release());
+        }
+        if (needWakeup) {
+            wakeup();
+        }
+        return future;
+    }
+
+    static ssize_t runBlocking(const Request& req) noexcept {
+        ssize_t rc = -1;
+        switch (req.op) {
+        case Op::READ:
+            rc = ::pread(req.fd, req.buf, req.len, req.offset);
+            break;
+        case Op::WRITE:
+            rc = ::pwrite(req.fd, req.buf, req.len, req.offset);
+            break;
+        case Op::FSYNC:
+            rc = ::fsync(req.fd);
+            break;
+        case Op::OPENAT:
+            rc = ::openat(req.fd, req.path.c_str(), req.flags, req.mode);
+            break;
+        }
+        return rc < 0 ? -errno : rc;
+    }
+
+    static void prepare(io_uring_sqe* sqe, Request* req) noexcept {
+        sqe->fd = req->fd;
+        sqe->user_data = reinterpret_cast<uint64_t>(req);
+        switch (req->op) {
+        case Op::READ:
+            sqe->opcode = IORING_OP_READ;
+            sqe->addr = reinterpret_cast<uint64_t>(req->buf);
+            sqe->len = static_cast<uint32_t>(std::min<size_t>(req->len, size_t{kMaxIoLen}));
+            sqe->off = static_cast<uint64_t>(req->offset);
+            break;
+        case Op::WRITE:
+            sqe->opcode = IORING_OP_WRITE;
+            sqe->addr = reinterpret_cast<uint64_t>(req->buf);
+            sqe->len = static_cast<uint32_t>(std::min<size_t>(req->len, size_t{kMaxIoLen}));
+            sqe->off = static_cast<uint64_t>(req->offset);
+            break;
+        case Op::FSYNC:
+            sqe->opcode = IORING_OP_FSYNC;
+            break;
+        case Op::OPENAT:
+            sqe->opcode = IORING_OP_OPENAT;
+            sqe->addr = reinterpret_cast<uint64_t>(req->path.c_str());
+            sqe->open_flags = static_cast<uint32_t>(req->flags);
+            sqe->len = req->mode;
+            break;
+        }
+    }
+
+    bool armWakeup() noexcept {
+        io_uring_sqe* sqe = ring_->getSqe();
+        if (sqe == nullptr) {
+            return false;
+        }
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = wakeup_fd_;
+        sqe->addr = reinterpret_cast<uint64_t>(&wakeup_buf_);
+        sqe->len = sizeof(wakeup_buf_);
+        sqe->user_data = kWakeupTag;
+        return true;
+    }
+
+    void wakeup() noexcept {
+        const uint64_t one = 1;
+        ssize_t rc = ::write(wakeup_fd_, &one, sizeof(one));
+        (void)rc;
+    }
+
+    void run() {
+        // 在途请求数不超过CQ大小, 避免CQ溢出.
+        const size_t max_inflight = ring_->cqEntries() - 1;
+        size_t inflight = 0;
+        bool wakeup_armed = false;
+        std::deque<Request*> batch;
+        // 已填入SQ的请求, 用于ring出错时让它们失败.
+        Request submitted{};
+        submitted.prev = submitted.next = &submitted;
+
+        while (true) {
+            if (!wakeup_armed) {
+                wakeup_armed = armWakeup();
+            }
+
+            bool terminate;
+            {
+                WGLock lock(mutex_);
+                while (!pending_.empty() && inflight + batch.size() < max_inflight) {
+                    batch.push_back(pending_.front());
+                    pending_.pop_front();
+                }
+                terminate = should_terminate_ && pending_.empty();
+            }
+
+            while (!batch.empty()) {
+                io_uring_sqe* sqe = ring_->getSqe();
+                if (sqe == nullptr) {
+                    break;
+                }
+                Request* req = batch.front();
+                batch.pop_front();
+                prepare(sqe, req);
+                req->prev = submitted.prev;
+                req->next = &submitted;
+                submitted.prev->next = req;
+                submitted.prev = req;
+                ++inflight;
+            }
+
+            if (terminate && inflight == 0 && batch.empty()) {
+                break;
+            }
+
+            const int rc = ring_->enter(1);
+            ring_->reap([&](uint64_t user_data, int32_t res) {
+                if (user_data == kWakeupTag) {
+                    wakeup_armed = false;
+                    return;
+                }
+                std::unique_ptr<Request> req(reinterpret_cast<Request*>(user_data));
+                req->prev->next = req->next;
+                req->next->prev = req->prev;
+                --inflight;
+                req->promise.setValue(static_cast<ssize_t>(res));
+            });
+            // EBUSY/EAGAIN: CQ或内核资源暂时不足, 收割后重试. 其他错误不会自行恢复, 停止ring.
+            if (rc < 0 && rc != -EBUSY && rc != -EAGAIN) {
+                fail(-rc, submitted, batch);
+                return;
+            }
+        }
+    }
+
+    // 关闭ring并让所有在途, 待提交和之后的请求以-err完成.
+    void fail(int err, Request& submitted, std::deque<Request*>& batch) {
+        // 关闭ring会取消内核中仍未完成的请求.
+        ring_.reset();
+        std::deque<Request*> pending;
+        {
+            WGLock lock(mutex_);
+            ring_error_ = err;
+            pending.swap(pending_);
+        }
+        for (Request* req = submitted.next; req != &submitted;) {
+            std::unique_ptr<Request> owned(req);
+            req = req->next;
+            owned->promise.setValue(static_cast<ssize_t>(-err));
+        }
+        for (auto* queue : {&batch, &pending}) {
+            for (Request* req : *queue) {
+                std::unique_ptr<Request> owned(req);
+                owned->promise.setValue(static_cast<ssize_t>(-err));
+            }
+        }
+    }
+
+    IoBackend backend_;
+
+    // io_uring模式.
+    std::unique_ptr<detail::IoUring> ring_;
+    int wakeup_fd_{-1};
+    uint64_t wakeup_buf_{0};
+    std::thread thread_;
+    Mutex mutex_;
+    std::deque<Request*> pending_;
+    bool should_terminate_{false};
+    // ring出错停止后的errno.
+    int ring_error_{0};
+
+    // 阻塞模式.
+    std::unique_ptr<ThreadExecutor> blocking_executor_;
+};
+
+#endif // TINY_FUTURE_IO_SERVICE_HPP
@@ -0,0 +1,101 @@
+/* Proj: tiny-future
+ * File: io_service_test.cpp
+ * Created Date: 2023/4/28
+ * Author: yangyangyang
+ * Description:
+ * -----
+ * Last Modified: 2023/4/28 14:05:19
+ * -----
+ * Copyright (c) 2023  . All rights reserved.
+ */
+
+#include "future_wrapper/io_service.hpp"
+#include <gtest/gtest.h>
+
+namespace {
+
+ssize_t getValue(Future<ssize_t>&& future) {
+    auto& sharedState = future.getSharedState();
+    std::move(future).get();
+    return sharedState.getValue();
+}
+
+void roundTrip(IoService& io) {
+    char path[] = "/tmp/io_service_test_XXXXXX";
+    const int tmp = ::mkstemp(path);
+    ASSERT_GE(tmp, 0);
+    ::close(tmp);
+
+    const ssize_t fd = getValue(io.openat(AT_FDCWD, path, O_RDWR | O_TRUNC));
+    ASSERT_GE(fd, 0);
+
+    const std::string data = "hello io_uring";
+    EXPECT_EQ(getValue(io.write(static_cast<int>(fd), data.data(), data.size(), 0)),
+              static_cast<ssize_t>(data.size()));
+    EXPECT_EQ(getValue(io.fsync(static_cast<int>(fd))), 0);
+
+    std::string buf(data.size(), '\0');
+    EXPECT_EQ(getValue(io.read(static_cast<int>(fd), &buf[0], buf.size(), 0)), static_cast<ssize_t>(data.size()));
+    EXPECT_EQ(buf, data);
+
+    // 失败时返回-errno.
+    EXPECT_EQ(getValue(io.read(-1, &buf[0], buf.size(), 0)), -EBADF);
+
+    ::close(static_cast<int>(fd));
+    ::unlink(path);
+}
+
+} // namespace
+
+TEST(IoService, Blocking) {
+    IoService io(IoBackend::BLOCKING);
+    EXPECT_EQ(io.backend(), IoBackend::BLOCKING);
+    roundTrip(io);
+}
+
+TEST(IoService, Auto) {
+    IoService io;
+    roundTrip(io);
+}
+
+TEST(IoService, ManyInflight) {
+    IoService io(IoBackend::AUTO, 8);
+    char path[] = "/tmp/io_service_test_XXXXXX";
+    const int fd = ::mkstemp(path);
+    ASSERT_GE(fd, 0);
+
+    // 请求数远大于SQ大小, 验证分批提交.
+    constexpr int kCount = 1000;
+    std::vector<char> data(kCount);
+    std::vector<Future<ssize_t>> futures;
+    futures.reserve(kCount);
+    for (int i = 0; i < kCount; ++i) {
+        data[i] = static_cast<char>('a' + i % 26);
+        futures.push_back(io.write(fd, &data[i], 1, i));
+    }
+    for (auto& future : futures) {
+        EXPECT_EQ(getValue(std::move(future)), 1);
+    }
+
+    std::vector<char> buf(kCount);
+    EXPECT_EQ(::pread(fd, buf.data(), buf.size(), 0), kCount);
+    EXPECT_EQ(buf, data);
+    ::close(fd);
+    ::unlink(path);
+}
+
+// 超过4GiB的长度不能被截断为低32位, 与pwrite一样按内核上限返回短写.
+TEST(IoService, HugeLengthIsShortWrite) {
+    const int fd = ::open("/dev/null", O_WRONLY | O_CLOEXEC);
+    ASSERT_GE(fd, 0);
+    // 只保留地址空间, 不分配内存.
+    const size_t len = (size_t{1} << 32) + 16;
+    void* buf = ::mmap(nullptr, len, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    ASSERT_NE(buf, MAP_FAILED);
+    for (auto backend : {IoBackend::AUTO, IoBackend::BLOCKING}) {
+        IoService io(backend);
+        EXPECT_EQ(getValue(io.write(fd, buf, len, 0)), 0x7ffff000);
+    }
+    ::munmap(buf, len);
+    ::close(fd);
+}
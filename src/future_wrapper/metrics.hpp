@@ -0,0 +1,190 @@
+/* Proj: tiny-future
+ * File: metrics.hpp
+ * Created Date: 2023/5/4
+ * Author: yangyangyang
+ * Description: Executor运行指标(计数/排队与执行耗时直方图/线程利用率).
+ * -----
+ * Last Modified: 2023/5/4 10:26:44
+ * -----
+ * Copyright (c) 2023  . All rights reserved.
+ */
+#ifndef TINY_FUTURE_METRICS_HPP
+#define TINY_FUTURE_METRICS_HPP
+
+#include "helper/tsc_clock.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+// 编译期开关, 关闭时Executor热路径上不产生任何统计代码.
+#ifndef TINY_FUTURE_ENABLE_METRICS
+#define TINY_FUTURE_ENABLE_METRICS 1
+#endif
+
+namespace metrics {
+
+inline int64_t nowNanos() noexcept { return helper::TscClock::nowNanos(); }
+
+// 只有一个写者的计数器, 写入不需要原子RMW指令, 读者(snapshot)可并发读取.
+class SingleWriterCounter {
+public:
+    void add(uint64_t n = 1) noexcept {
+        value_.store(value_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    uint64_t load() const noexcept { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value_{0};
+};
+
+/**
+ * HDR风格的log-linear直方图: 每个2的幂区间再均分为kSubBuckets个桶, 相对误差 <= 1/kSubBuckets.
+ * 小于2*kSubBuckets的值精确记录.
+ */
+struct HistogramLayout {
+    static constexpr uint32_t kSubBucketBits = 3;
+    static constexpr uint32_t kSubBuckets = 1u << kSubBucketBits;
+    static constexpr uint32_t kLinear = kSubBuckets * 2;
+    static constexpr uint32_t kBuckets = kLinear + (64 - kSubBucketBits - 1) * kSubBuckets;
+
+    static uint32_t indexOf(uint64_t value) noexcept {
+        if (value < kLinear) {
+            return static_cast<uint32_t>(value);
+        }
+        const uint32_t msb = 63 - static_cast<uint32_t>(__builtin_clzll(value));
+        const uint32_t sub = static_cast<uint32_t>(value >> (msb - kSubBucketBits)) & (kSubBuckets - 1);
+        return kLinear + (msb - kSubBucketBits - 1) * kSubBuckets + sub;
+    }
+
+    static uint64_t lowerBound(uint32_t index) noexcept {
+        if (index < kLinear) {
+            return index;
+        }
+        const uint32_t msb = (index - kLinear) / kSubBuckets + kSubBucketBits + 1;
+        const uint64_t sub = (index - kLinear) % kSubBuckets;
+        return (kSubBuckets + sub) << (msb - kSubBucketBits);
+    }
+
+    static uint64_t upperBound(uint32_t index) noexcept {
+        return index + 1 < kBuckets ? lowerBound(index + 1) - 1 : UINT64_MAX;
+    }
+};
+
+// 直方图的只读快照, 可以合并多个线程的数据.
+class HistogramSnapshot {
+public:
+    HistogramSnapshot()
+        : counts_(HistogramLayout::kBuckets, 0) {}
+
+    void merge(const HistogramSnapshot& other) noexcept {
+        for (uint32_t i = 0; i < HistogramLayout::kBuckets; ++i) {
+            counts_[i] += other.counts_[i];
+        }
+        count_ += other.count_;
+        sum_ += other.sum_;
+        max_ = std::max(max_, other.max_);
+    }
+
+    uint64_t count() const noexcept { return count_; }
+
+    uint64_t max() const noexcept { return max_; }
+
+    double mean() const noexcept { return count_ == 0 ? 0.0 : static_cast<double>(sum_) / count_; }
+
+    // q in [0, 1], 返回所在桶的上界(不超过记录到的最大值).
+    uint64_t percentile(double q) const noexcept {
+        if (count_ == 0) {
+            return 0;
+        }
+        const auto rank = static_cast<uint64_t>(q * static_cast<double>(count_ - 1)) + 1;
+        uint64_t seen = 0;
+        for (uint32_t i = 0; i < HistogramLayout::kBuckets; ++i) {
+            seen += counts_[i];
+            if (seen >= rank) {
+                return std::min(HistogramLayout::upperBound(i), max_);
+            }
+        }
+        return max_;
+    }
+
+private:
+    friend class LatencyHistogram;
+
+    std::vector<uint64_t> counts_;
+    uint64_t count_{0};
+    uint64_t sum_{0};
+    uint64_t max_{0};
+};
+
+// 单写者直方图, 每个worker持有自己的一份, 由snapshot聚合.
+class LatencyHistogram {
+public:
+    void record(uint64_t value) noexcept {
+        buckets_[HistogramLayout::indexOf(value)].add();
+        sum_.add(value);
+        if (value > max_.load(std::memory_order_relaxed)) {
+            max_.store(value, std::memory_order_relaxed);
+        }
+    }
+
+    void snapshotInto(HistogramSnapshot& out) const noexcept {
+        HistogramSnapshot local;
+        for (uint32_t i = 0; i < HistogramLayout::kBuckets; ++i) {
+            local.counts_[i] = buckets_[i].load();
+            local.count_ += local.counts_[i];
+        }
+        local.sum_ = sum_.load();
+        local.max_ = max_.load(std::memory_order_relaxed);
+        out.merge(local);
+    }
+
+private:
+    std::array<SingleWriterCounter, HistogramLayout::kBuckets> buckets_{};
+    SingleWriterCounter sum_;
+    std::atomic<uint64_t> max_{0};
+};
+
+// 每个worker独占一份, 按缓存行对齐单独分配以避免与其他worker伪共享.
+struct alignas(64) WorkerMetrics {
+    // C++14的new不保证超过alignof(max_align_t)的对齐.
+    static void* operator new(size_t size) {
+        void* mem = nullptr;
+        if (::posix_memalign(&mem, alignof(WorkerMetrics), size) != 0) {
+            throw std::bad_alloc();
+        }
+        return mem;
+    }
+
+    static void operator delete(void* mem) noexcept { ::free(mem); }
+
+    SingleWriterCounter completed;
+    SingleWriterCounter busy_ns;
+    LatencyHistogram wait_ns; // 入队到开始执行
+    LatencyHistogram run_ns;  // 执行耗时
+    int64_t start_ns{nowNanos()};
+};
+
+struct ExecutorMetricsSnapshot {
+    uint64_t submitted{0};
+    uint64_t completed{0};
+    uint64_t rejected{0};
+    uint64_t dropped{0};
+    uint64_t caller_runs{0};
+    size_t queue_depth{0};
+    int32_t active_threads{0};
+    HistogramSnapshot wait_ns;
+    HistogramSnapshot run_ns;
+    // 每个worker自启动以来处于执行任务状态的时间占比.
+    std::vector<double> worker_busy_ratio;
+};
+
+} // namespace metrics
+
+#endif // TINY_FUTURE_METRICS_HPP
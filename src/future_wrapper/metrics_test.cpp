@@ -0,0 +1,95 @@
+/* Proj: tiny-future
+ * File: metrics_test.cpp
+ * Created Date: 2023/5/4
+ * Author: yangyangyang
+ * Description:
+ * -----
+ * Last Modified: 2023/5/4 15:12:08
+ * -----
+ * Copyright (c) 2023  . All rights reserved.
+ */
+
+#include "future_wrapper/executor.hpp"
+#include "future_wrapper/metrics.hpp"
+#include <gtest/gtest.h>
+
+using metrics::HistogramLayout;
+
+TEST(HistogramLayout, BucketBounds) {
+    for (uint64_t v : std::vector<uint64_t>{0, 1, 15, 16, 17, 1000, 123456789, 1ull << 40, UINT64_MAX}) {
+        const uint32_t idx = HistogramLayout::indexOf(v);
+        ASSERT_LT(idx, static_cast<uint32_t>(HistogramLayout::kBuckets));
+        EXPECT_LE(HistogramLayout::lowerBound(idx), v);
+        EXPECT_GE(HistogramLayout::upperBound(idx), v);
+    }
+    // 相对误差不超过1/kSubBuckets.
+    const uint32_t idx = HistogramLayout::indexOf(1000000);
+    EXPECT_LE(HistogramLayout::upperBound(idx) - HistogramLayout::lowerBound(idx),
+              HistogramLayout::lowerBound(idx) / HistogramLayout::kSubBuckets);
+}
+
+TEST(LatencyHistogram, Percentile) {
+    metrics::LatencyHistogram histogram;
+    for (uint64_t v = 1; v <= 1000; ++v) {
+        histogram.record(v);
+    }
+    metrics::HistogramSnapshot snapshot;
+    histogram.snapshotInto(snapshot);
+    EXPECT_EQ(snapshot.count(), 1000);
+    EXPECT_EQ(snapshot.max(), 1000);
+    EXPECT_DOUBLE_EQ(snapshot.mean(), 500.5);
+    EXPECT_NEAR(static_cast<double>(snapshot.percentile(0.5)), 500.0, 500.0 / HistogramLayout::kSubBuckets);
+    EXPECT_NEAR(static_cast<double>(snapshot.percentile(0.99)), 990.0, 990.0 / HistogramLayout::kSubBuckets);
+    EXPECT_EQ(snapshot.percentile(1.0), 1000);
+}
+
+TEST(WorkerMetrics, CacheLineAligned) {
+    std::vector<std::unique_ptr<metrics::WorkerMetrics>> workers;
+    for (int i = 0; i < 4; ++i) {
+        workers.emplace_back(new metrics::WorkerMetrics());
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(workers.back().get()) % alignof(metrics::WorkerMetrics), 0u);
+    }
+    EXPECT_EQ(alignof(metrics::WorkerMetrics), 64u);
+}
+
+#if TINY_FUTURE_ENABLE_METRICS
+TEST(ThreadExecutor, MetricsSnapshot) {
+    ThreadExecutor executor(2, 4, OverflowPolicy::REJECT);
+    std::atomic<bool> release{false};
+    std::atomic<int> started{0};
+    for (int i = 0; i < 2; ++i) {
+        executor.submit([&]() {
+            ++started;
+            while (!release.load()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        });
+    }
+    while (started.load() < 2) {
+        std::this_thread::yield();
+    }
+    for (int i = 0; i < 4; ++i) {
+        executor.submit([]() {});
+    }
+    EXPECT_FALSE(executor.trySubmit([]() {}));
+
+    auto snapshot = executor.metrics();
+    EXPECT_EQ(snapshot.submitted, 6);
+    EXPECT_EQ(snapshot.rejected, 1);
+    EXPECT_EQ(snapshot.queue_depth, 4);
+    EXPECT_EQ(snapshot.active_threads, 2);
+
+    release = true;
+    while (executor.metrics().completed < 6) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    snapshot = executor.metrics();
+    EXPECT_EQ(snapshot.wait_ns.count(), 6);
+    EXPECT_EQ(snapshot.run_ns.count(), 6);
+    ASSERT_EQ(snapshot.worker_busy_ratio.size(), 2);
+    for (double ratio : snapshot.worker_busy_ratio) {
+        EXPECT_GE(ratio, 0.0);
+        EXPECT_LE(ratio, 1.0);
+    }
+}
+#endif
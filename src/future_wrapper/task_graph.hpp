@@ -0,0 +1,251 @@
+/* Proj: tiny-future
+ * File: task_graph.hpp
+ * Created Date: 2023/5/18
+ * Author: yangyangyang
+ * Description: DAG任务图, 按依赖计数调度到Executor上执行, 图结构可以多次运行.
+ * -----
+ * Last Modified: 2023/5/18 11:24:37
+ * -----
+ * Copyright (c) 2023  . All rights reserved.
+ */
+#ifndef TINY_FUTURE_TASK_GRAPH_HPP
+#define TINY_FUTURE_TASK_GRAPH_HPP
+
+#include "future_wrapper/executor.hpp"
+#include "future_wrapper/future.hpp"
+#include "future_wrapper/promise.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+/**
+ * 任务图: addNode/addEdge构建DAG, run(executor)执行全部节点, 所有节点完成时返回的Future完成.
+ *
+ * 首次run(或图被修改后)把边整理为CSR格式的后继数组并检查环, 之后的run只需重置每个节点的原子入度计数.
+ * 节点完成时对后继的计数减一, 变为0的后继中第一个由当前线程直接执行, 其余通过trySubmitBatch一次提交,
+ * 有界Executor不接收的节点(REJECT)在当前线程执行. 提交的任务只捕获(this, 节点编号),
+ * 可以放进std::function的内联存储, 运行时不再分配内存.
+ *
+ * 运行期间TaskGraph必须存活且不能被修改; 节点函数不应抛出异常. 丢弃节点会让图永远无法完成,
+ * 因此不接受可能丢弃任务的Executor(DROP_OLDEST).
+ */
+class TaskGraph : public MoveOnlyAble {
+public:
+    using NodeId = uint32_t;
+
+    TaskGraph() = default;
+
+    void reserve(size_t nodes, size_t edges) {
+        funcs_.reserve(nodes);
+        edges_.reserve(edges);
+    }
+
+    NodeId addNode(Func func) {
+        assert(!running());
+        funcs_.push_back(std::move(func));
+        compiled_ = false;
+        return static_cast<NodeId>(funcs_.size() - 1);
+    }
+
+    // to在from完成之后才能执行.
+    void addEdge(NodeId from, NodeId to) {
+        assert(!running());
+        assert(from < funcs_.size() && to < funcs_.size());
+        edges_.emplace_back(from, to);
+        compiled_ = false;
+    }
+
+    size_t nodeCount() const noexcept { return funcs_.size(); }
+
+    size_t edgeCount() const noexcept { return edges_.size(); }
+
+    bool running() const noexcept { return running_.load(std::memory_order_acquire); }
+
+    /**
+     * @brief 在executor上执行整个图. 图中有环或executor可能丢弃任务时抛出std::invalid_argument,
+     * 上一次运行未结束时抛出std::logic_error.
+     */
+    Future<Unit> run(Executor* executor) {
+        assert(executor != nullptr);
+        if (executor->mayDropTasks()) {
+            throw std::invalid_argument("TaskGraph: executor may drop tasks");
+        }
+        if (running_.exchange(true, std::memory_order_acq_rel)) {
+            throw std::logic_error("TaskGraph: previous run has not finished");
+        }
+        try {
+            compile_();
+        }
+        catch (...) {
+            running_.store(false, std::memory_order_release);
+            throw;
+        }
+
+        done_ = Promise<Unit>();
+        auto future = done_.getFuture();
+        const size_t n = funcs_.size();
+        if (n == 0) {
+            Promise<Unit> done = std::move(done_);
+            running_.store(false, std::memory_order_release);
+            done.setValue(Unit{});
+            return future;
+        }
+        executor_ = executor;
+        for (size_t i = 0; i < n; ++i) {
+            pending_[i].store(in_degree_[i], std::memory_order_relaxed);
+        }
+        // release: 上面的计数对执行节点的线程可见.
+        remaining_.store(n, std::memory_order_release);
+
+        // 根节点可能在提交时同步执行完整个图, 完成回调中可以再次run或销毁图, 提交之后不再访问成员.
+        std::vector<Func> batch;
+        batch.reserve(roots_.size());
+        for (NodeId root : roots_) {
+            batch.emplace_back([this, root]() { execute_(root); });
+        }
+        submit_(executor, batch.data(), batch.size());
+        return future;
+    }
+
+private:
+    void compile_() {
+        if (compiled_) {
+            return;
+        }
+        const size_t n = funcs_.size();
+        // 按起点计数排序得到CSR: 节点i的后继为succ_[succ_offset_[i], succ_offset_[i + 1]).
+        succ_offset_.assign(n + 1, 0);
+        in_degree_.assign(n, 0);
+        for (const auto& edge : edges_) {
+            ++succ_offset_[edge.first + 1];
+            ++in_degree_[edge.second];
+        }
+        for (size_t i = 0; i < n; ++i) {
+            succ_offset_[i + 1] += succ_offset_[i];
+        }
+        succ_.resize(edges_.size());
+        std::vector<uint32_t> cursor(succ_offset_.begin(), succ_offset_.end() - 1);
+        for (const auto& edge : edges_) {
+            succ_[cursor[edge.first]++] = edge.second;
+        }
+
+        roots_.clear();
+        for (NodeId i = 0; i < n; ++i) {
+            if (in_degree_[i] == 0) {
+                roots_.push_back(i);
+            }
+        }
+        checkAcyclic_();
+
+        if (pending_capacity_ < n) {
+            pending_.reset(new std::atomic<uint32_t>[n]);
+            pending_capacity_ = n;
+        }
+        compiled_ = true;
+    }
+
+    // Kahn算法: 能按拓扑序访问到所有节点则无环.
+    void checkAcyclic_() const {
+        std::vector<uint32_t> degree(in_degree_);
+        std::vector<NodeId> stack(roots_);
+        size_t visited = 0;
+        while (!stack.empty()) {
+            const NodeId id = stack.back();
+            stack.pop_back();
+            ++visited;
+            for (uint32_t e = succ_offset_[id]; e < succ_offset_[id + 1]; ++e) {
+                if (--degree[succ_[e]] == 0) {
+                    stack.push_back(succ_[e]);
+                }
+            }
+        }
+        if (visited != funcs_.size()) {
+            throw std::invalid_argument("TaskGraph: graph contains a cycle");
+        }
+    }
+
+    // 提交funcs[0, n), 不被接收的任务在当前线程执行. 不访问成员: 执行的节点可能完成整个图.
+    static void submit_(Executor* executor, Func* funcs, size_t n) {
+        size_t i = 0;
+        while (i < n) {
+            i += executor->trySubmitBatch(funcs + i, n - i);
+            if (i < n) {
+                funcs[i++]();
+            }
+        }
+    }
+
+    void execute_(NodeId id) {
+        // 每个线程复用一组批量缓冲区, 只在首次增长时分配. 有界Executor可能在submitBatch内部同步执行任务
+        // (CALLER_RUNS), 嵌套的execute_从spare中另取一个缓冲区, 不会让正在提交的缓冲区重新分配.
+        static thread_local std::vector<std::vector<Func>> spare;
+        while (true) {
+            funcs_[id]();
+
+            NodeId next = kNone;
+            std::vector<Func> batch;
+            if (!spare.empty()) {
+                batch = std::move(spare.back());
+                spare.pop_back();
+            }
+            for (uint32_t e = succ_offset_[id]; e < succ_offset_[id + 1]; ++e) {
+                const NodeId succ = succ_[e];
+                // acq_rel: 后继执行时能看到所有前驱的写入.
+                if (pending_[succ].fetch_sub(1, std::memory_order_acq_rel) != 1) {
+                    continue;
+                }
+                if (next == kNone) {
+                    next = succ;
+                }
+                else {
+                    batch.emplace_back([this, succ]() { execute_(succ); });
+                }
+            }
+            if (!batch.empty()) {
+                submit_(executor_, batch.data(), batch.size());
+                batch.clear();
+            }
+            spare.push_back(std::move(batch));
+
+            if (remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                // 最后一个节点: 先移出Promise再清除running_, 之后的run才能重新设置done_.
+                // 回调中可以再次run或销毁图.
+                Promise<Unit> done = std::move(done_);
+                running_.store(false, std::memory_order_release);
+                done.setValue(Unit{});
+                return;
+            }
+            if (next == kNone) {
+                return;
+            }
+            id = next;
+        }
+    }
+
+    static constexpr NodeId kNone = static_cast<NodeId>(-1);
+
+    std::vector<Func> funcs_;
+    std::vector<std::pair<NodeId, NodeId>> edges_;
+    bool compiled_{false};
+
+    // compile_生成, 图不变时各次run共用.
+    std::vector<uint32_t> succ_offset_;
+    std::vector<NodeId> succ_;
+    std::vector<uint32_t> in_degree_;
+    std::vector<NodeId> roots_;
+    std::unique_ptr<std::atomic<uint32_t>[]> pending_;
+    size_t pending_capacity_{0};
+
+    // 单次运行的状态.
+    std::atomic<bool> running_{false};
+    std::atomic<size_t> remaining_{0};
+    Executor* executor_{nullptr};
+    Promise<Unit> done_;
+};
+
+#endif // TINY_FUTURE_TASK_GRAPH_HPP
@@ -0,0 +1,191 @@
+/* Proj: tiny-future
+ * File: task_graph_test.cpp
+ * Created Date: 2023/5/18
+ * Author: yangyangyang
+ * Description:
+ * -----
+ * Last Modified: 2023/5/18 14:37:02
+ * -----
+ * Copyright (c) 2023  . All rights reserved.
+ */
+
+#include "future_wrapper/task_graph.hpp"
+#include <gtest/gtest.h>
+
+namespace {
+
+// 记录每次submit/trySubmitBatch的调用次数, 任务转交给内部的ThreadExecutor.
+class CountingExecutor : public Executor {
+public:
+    explicit CountingExecutor(unsigned int num_thread)
+        : inner_(num_thread) {}
+
+    void submit(Func&& func) override {
+        ++submits;
+        inner_.submit(std::move(func));
+    }
+
+    size_t trySubmitBatch(Func* funcs, size_t n) override {
+        ++batches;
+        return inner_.trySubmitBatch(funcs, n);
+    }
+
+    std::atomic<int> submits{0};
+    std::atomic<int> batches{0};
+
+private:
+    ThreadExecutor inner_;
+};
+
+} // namespace
+
+TEST(TaskGraph, Diamond) {
+    ThreadExecutor executor(2);
+    TaskGraph graph;
+    std::atomic<int> step{0};
+    int a = -1, b = -1, c = -1, d = -1;
+    auto na = graph.addNode([&]() { a = step++; });
+    auto nb = graph.addNode([&]() { b = step++; });
+    auto nc = graph.addNode([&]() { c = step++; });
+    auto nd = graph.addNode([&]() { d = step++; });
+    graph.addEdge(na, nb);
+    graph.addEdge(na, nc);
+    graph.addEdge(nb, nd);
+    graph.addEdge(nc, nd);
+
+    graph.run(&executor).get();
+    EXPECT_EQ(a, 0);
+    EXPECT_LT(a, b);
+    EXPECT_LT(a, c);
+    EXPECT_EQ(d, 3);
+    EXPECT_FALSE(graph.running());
+}
+
+TEST(TaskGraph, ReadySuccessorsSubmittedAsBatch) {
+    CountingExecutor executor(2);
+    TaskGraph graph;
+    std::atomic<int> counter{0};
+    auto root = graph.addNode([]() {});
+    for (int i = 0; i < 8; ++i) {
+        graph.addEdge(root, graph.addNode([&counter]() { ++counter; }));
+    }
+
+    graph.run(&executor).get();
+    EXPECT_EQ(counter.load(), 8);
+    // 根节点一批; 8个后继中1个由当前线程接着执行, 其余7个一批.
+    EXPECT_EQ(executor.batches.load(), 2);
+    EXPECT_EQ(executor.submits.load(), 0);
+}
+
+// 有界CALLER_RUNS队列满时, 后继在submitBatch内部同步执行, 嵌套的节点继续提交自己的后继.
+TEST(TaskGraph, CallerRunsExecutor) {
+    ThreadExecutor executor(1, 1, OverflowPolicy::CALLER_RUNS);
+    TaskGraph graph;
+    std::atomic<int> counter{0};
+    auto root = graph.addNode([&counter]() { ++counter; });
+    for (int i = 0; i < 8; ++i) {
+        auto child = graph.addNode([&counter]() { ++counter; });
+        graph.addEdge(root, child);
+        for (int j = 0; j < 64; ++j) {
+            graph.addEdge(child, graph.addNode([&counter]() { ++counter; }));
+        }
+    }
+
+    for (int run = 1; run <= 3; ++run) {
+        graph.run(&executor).get();
+        EXPECT_EQ(counter.load(), run * (1 + 8 + 8 * 64));
+        EXPECT_FALSE(graph.running());
+    }
+}
+
+// 有界REJECT队列满时, 不被接收的节点在当前线程执行, 图仍然完成.
+TEST(TaskGraph, RejectExecutor) {
+    ThreadExecutor executor(1, 1, OverflowPolicy::REJECT);
+    TaskGraph graph;
+    std::atomic<int> counter{0};
+    auto root = graph.addNode([&counter]() { ++counter; });
+    for (int i = 0; i < 8; ++i) {
+        auto child = graph.addNode([&counter]() { ++counter; });
+        graph.addEdge(root, child);
+        for (int j = 0; j < 64; ++j) {
+            graph.addEdge(child, graph.addNode([&counter]() { ++counter; }));
+        }
+    }
+
+    for (int run = 1; run <= 3; ++run) {
+        graph.run(&executor).get();
+        EXPECT_EQ(counter.load(), run * (1 + 8 + 8 * 64));
+        EXPECT_FALSE(graph.running());
+    }
+}
+
+// 丢弃节点会让图无法完成, run直接拒绝, 图保持可用.
+TEST(TaskGraph, DropOldestExecutorRejected) {
+    ThreadExecutor dropping(1, 1, OverflowPolicy::DROP_OLDEST);
+    TaskGraph graph;
+    std::atomic<int> counter{0};
+    graph.addNode([&counter]() { ++counter; });
+    EXPECT_THROW(graph.run(&dropping), std::invalid_argument);
+    EXPECT_FALSE(graph.running());
+
+    ThreadExecutor executor(1);
+    graph.run(&executor).get();
+    EXPECT_EQ(counter.load(), 1);
+}
+
+TEST(TaskGraph, Cycle) {
+    ThreadExecutor executor(1);
+    TaskGraph graph;
+    auto a = graph.addNode([]() {});
+    auto b = graph.addNode([]() {});
+    graph.addEdge(a, b);
+    graph.addEdge(b, a);
+    EXPECT_THROW(graph.run(&executor), std::invalid_argument);
+}
+
+TEST(TaskGraph, Empty) {
+    ThreadExecutor executor(1);
+    TaskGraph graph;
+    auto future = graph.run(&executor);
+    EXPECT_TRUE(future.getSharedState().hasValue());
+}
+
+// 100k个节点: 每层1000个节点, 每个节点依赖上一层的两个节点, 同一个图运行多次.
+TEST(TaskGraph, LargeGraphReusedAcrossRuns) {
+    constexpr uint32_t kWidth = 1000;
+    constexpr uint32_t kDepth = 100;
+    ThreadExecutor executor(4);
+    TaskGraph graph;
+    graph.reserve(kWidth * kDepth, 2 * kWidth * (kDepth - 1));
+    std::vector<std::atomic<uint32_t>> level(kWidth * kDepth);
+    std::atomic<uint64_t> violations{0};
+    for (uint32_t d = 0; d < kDepth; ++d) {
+        for (uint32_t w = 0; w < kWidth; ++w) {
+            const uint32_t id = d * kWidth + w;
+            graph.addNode([&level, &violations, id, d, w]() {
+                // 前驱必须在本轮已经执行过.
+                if (d > 0) {
+                    const uint32_t run = level[id].load(std::memory_order_relaxed);
+                    if (level[id - kWidth].load(std::memory_order_relaxed) != run + 1 ||
+                        level[(d - 1) * kWidth + (w + 1) % kWidth].load(std::memory_order_relaxed) != run + 1) {
+                        ++violations;
+                    }
+                }
+                level[id].fetch_add(1, std::memory_order_relaxed);
+            });
+            if (d > 0) {
+                graph.addEdge(id - kWidth, id);
+                graph.addEdge((d - 1) * kWidth + (w + 1) % kWidth, id);
+            }
+        }
+    }
+    EXPECT_EQ(graph.nodeCount(), kWidth * kDepth);
+
+    for (uint32_t run = 1; run <= 3; ++run) {
+        graph.run(&executor).get();
+        EXPECT_EQ(violations.load(), 0);
+        for (const auto& count : level) {
+            ASSERT_EQ(count.load(), run);
+        }
+    }
+}
@@ -0,0 +1,274 @@
+/* Proj: tiny-future
+ * File: trace.hpp
+ * Created Date: 2023/5/15
+ * Author: yangyangyang
+ * Description: Future/任务生命周期追踪, 导出Chrome trace(Perfetto可直接打开)格式.
+ * -----
+ * Last Modified: 2023/5/15 14:08:51
+ * -----
+ * Copyright (c) 2023  . All rights reserved.
+ */
+#ifndef TINY_FUTURE_TRACE_HPP
+#define TINY_FUTURE_TRACE_HPP
+
+#include "helper/tsc_clock.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+// 编译期开关, 关闭时追踪点不产生任何代码.
+#ifndef TINY_FUTURE_ENABLE_TRACE
+#define TINY_FUTURE_ENABLE_TRACE 0
+#endif
+
+// 每个线程缓冲区保留的事件数, 写满后覆盖最老的事件.
+#ifndef TINY_FUTURE_TRACE_BUFFER_EVENTS
+#define TINY_FUTURE_TRACE_BUFFER_EVENTS (1u << 14)
+#endif
+
+#if TINY_FUTURE_ENABLE_TRACE
+#define TINY_FUTURE_TRACE(kind, id) ::trace::record(kind, id)
+#else
+#define TINY_FUTURE_TRACE(kind, id) ((void)0)
+#endif
+
+namespace trace {
+
+enum class EventKind : uint8_t {
+    SET_VALUE = 0,      // Promise::setValue, 数据流的起点
+    CALL = 1,           // SharedState::call, value与callback都已就绪
+    ENQUEUE = 2,        // 回调提交到Executor
+    CALLBACK_BEGIN = 3, // 回调开始执行, 数据流的终点
+    CALLBACK_END = 4,
+};
+
+inline int64_t nowNanos() noexcept { return helper::TscClock::nowNanos(); }
+
+/**
+ * 单写者的环形事件缓冲区. 字段使用relaxed原子变量, 导出线程可以在写入的同时读取,
+ * 读取后再检查一次head, 丢弃读取期间可能已被覆盖的事件.
+ */
+class ThreadBuffer {
+public:
+    static constexpr uint64_t kCapacity = TINY_FUTURE_TRACE_BUFFER_EVENTS;
+    static_assert((kCapacity & (kCapacity - 1)) == 0, "trace buffer capacity must be a power of 2");
+
+    struct Event {
+        int64_t ts_ns;
+        uint64_t id;
+        EventKind kind;
+    };
+
+    explicit ThreadBuffer(uint32_t tid)
+        : tid_(tid)
+        , slots_(new Slot[kCapacity]) {}
+
+    void record(EventKind kind, uint64_t id) noexcept {
+        const uint64_t head = head_.load(std::memory_order_relaxed);
+        Slot& slot = slots_[head & (kCapacity - 1)];
+        slot.ts_ns.store(nowNanos(), std::memory_order_relaxed);
+        slot.id.store(id, std::memory_order_relaxed);
+        slot.kind.store(static_cast<uint8_t>(kind), std::memory_order_relaxed);
+        head_.store(head + 1, std::memory_order_release);
+    }
+
+    /**
+     * @brief 取出上次collect之后写入且未被覆盖的事件, 只能由一个导出线程调用.
+     * @return 被覆盖而丢失的事件数.
+     */
+    uint64_t collect(std::vector<Event>& out) {
+        const uint64_t head = head_.load(std::memory_order_acquire);
+        uint64_t begin = std::max(exported_, head > kCapacity ? head - kCapacity : 0);
+        const size_t first = out.size();
+        for (uint64_t i = begin; i < head; ++i) {
+            const Slot& slot = slots_[i & (kCapacity - 1)];
+            out.push_back(Event{slot.ts_ns.load(std::memory_order_relaxed), slot.id.load(std::memory_order_relaxed),
+                                static_cast<EventKind>(slot.kind.load(std::memory_order_relaxed))});
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        // 读取期间写者前进超过一圈的部分已被覆盖.
+        const uint64_t after = head_.load(std::memory_order_relaxed);
+        const uint64_t valid_from = after > kCapacity ? after - kCapacity : 0;
+        if (valid_from > begin) {
+            const auto torn = std::min<uint64_t>(valid_from - begin, head - begin);
+            out.erase(out.begin() + static_cast<std::ptrdiff_t>(first),
+                      out.begin() + static_cast<std::ptrdiff_t>(first + torn));
+            begin += torn;
+        }
+        const uint64_t lost = begin - std::min(begin, exported_);
+        exported_ = head;
+        return lost;
+    }
+
+    uint32_t tid() const noexcept { return tid_; }
+
+    // 只由持有缓冲区的线程调用; 计数随缓冲区保留, 复用缓冲区的新线程不会重复之前的id.
+    uint64_t nextId() noexcept { return (static_cast<uint64_t>(tid_) << 40) | ++next_id_; }
+
+private:
+    struct Slot {
+        std::atomic<int64_t> ts_ns{0};
+        std::atomic<uint64_t> id{0};
+        std::atomic<uint8_t> kind{0};
+    };
+
+    const uint32_t tid_;
+    uint64_t next_id_{0};
+    std::unique_ptr<Slot[]> slots_;
+    std::atomic<uint64_t> head_{0};
+    // 只由导出线程访问.
+    uint64_t exported_{0};
+};
+
+// 所有线程的缓冲区. 线程退出后缓冲区归还给空闲列表, 其中的事件仍可导出, 之后由新线程复用.
+class Registry {
+public:
+    static Registry& instance() {
+        static Registry registry;
+        return registry;
+    }
+
+    ThreadBuffer* acquire() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!free_.empty()) {
+            ThreadBuffer* buffer = free_.back();
+            free_.pop_back();
+            return buffer;
+        }
+        buffers_.push_back(std::make_shared<ThreadBuffer>(static_cast<uint32_t>(buffers_.size())));
+        return buffers_.back().get();
+    }
+
+    void release(ThreadBuffer* buffer) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_.push_back(buffer);
+    }
+
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return buffers_;
+    }
+
+    std::mutex& exportMutex() noexcept { return export_mutex_; }
+
+private:
+    std::mutex mutex_;
+    std::mutex export_mutex_;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers_;
+    std::vector<ThreadBuffer*> free_;
+};
+
+namespace detail {
+
+// 线程退出时归还缓冲区.
+struct BufferLease {
+    ThreadBuffer* buffer{nullptr};
+
+    ~BufferLease() {
+        if (buffer != nullptr) {
+            Registry::instance().release(buffer);
+        }
+    }
+};
+
+inline ThreadBuffer* acquireThreadBuffer() {
+    static thread_local BufferLease lease;
+    lease.buffer = Registry::instance().acquire();
+    return lease.buffer;
+}
+
+} // namespace detail
+
+inline ThreadBuffer& threadBuffer() {
+    // 常量初始化的thread_local, 访问时没有初始化检查.
+    static thread_local ThreadBuffer* buffer = nullptr;
+    if (buffer == nullptr) {
+        buffer = detail::acquireThreadBuffer();
+    }
+    return *buffer;
+}
+
+inline void record(EventKind kind, uint64_t id) noexcept { threadBuffer().record(kind, id); }
+
+// Future id: 高位为线程缓冲区编号, 低位为缓冲区内计数, 分配时不需要原子操作.
+inline uint64_t nextId() noexcept { return threadBuffer().nextId(); }
+
+inline const char* eventName(EventKind kind) noexcept {
+    switch (kind) {
+    case EventKind::SET_VALUE:
+        return "Promise::setValue";
+    case EventKind::CALL:
+        return "SharedState::call";
+    case EventKind::ENQUEUE:
+        return "Executor::submit";
+    default:
+        return "callback";
+    }
+}
+
+/**
+ * @brief 以Chrome trace JSON格式导出上次导出之后的事件, 可以周期性调用.
+ * setValue与对应回调之间用flow事件连接, 在Perfetto/chrome://tracing中显示为箭头.
+ * @return 因缓冲区覆盖而丢失的事件数.
+ */
+inline uint64_t exportChromeTrace(std::ostream& os) {
+    std::lock_guard<std::mutex> lock(Registry::instance().exportMutex());
+    const int pid = static_cast<int>(::getpid());
+    uint64_t lost = 0;
+    bool first = true;
+    auto emit = [&](const char* ph, const char* name, uint32_t tid, int64_t ts_ns, const std::string& extra) {
+        os << (first ? "\n" : ",\n") << "{\"ph\":\"" << ph << "\",\"name\":\"" << name << "\",\"cat\":\"future\""
+           << ",\"pid\":" << pid << ",\"tid\":" << tid << ",\"ts\":" << ts_ns / 1000 << '.' << ts_ns / 100 % 10
+           << ts_ns / 10 % 10 << ts_ns % 10 << extra << '}';
+        first = false;
+    };
+
+    os << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    std::vector<ThreadBuffer::Event> events;
+    for (auto& buffer : Registry::instance().buffers()) {
+        events.clear();
+        lost += buffer->collect(events);
+        const uint32_t tid = buffer->tid();
+        for (const auto& event : events) {
+            const std::string id = ",\"args\":{\"future\":" + std::to_string(event.id) + "}";
+            const std::string flow = ",\"id\":" + std::to_string(event.id);
+            switch (event.kind) {
+            case EventKind::SET_VALUE:
+                emit("X", eventName(event.kind), tid, event.ts_ns, ",\"dur\":0" + id);
+                emit("s", "continuation", tid, event.ts_ns, flow);
+                break;
+            case EventKind::CALLBACK_BEGIN:
+                emit("B", eventName(event.kind), tid, event.ts_ns, id);
+                emit("f", "continuation", tid, event.ts_ns, flow + ",\"bp\":\"e\"");
+                break;
+            case EventKind::CALLBACK_END:
+                emit("E", eventName(event.kind), tid, event.ts_ns, "");
+                break;
+            default:
+                emit("X", eventName(event.kind), tid, event.ts_ns, ",\"dur\":0" + id);
+                break;
+            }
+        }
+    }
+    os << "\n]}\n";
+    return lost;
+}
+
+inline uint64_t exportChromeTrace(const std::string& path) {
+    std::ofstream out(path);
+    return exportChromeTrace(out);
+}
+
+} // namespace trace
+
+#endif // TINY_FUTURE_TRACE_HPP
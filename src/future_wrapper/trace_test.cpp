@@ -0,0 +1,126 @@
+/* Proj: tiny-future
+ * File: trace_test.cpp
+ * Created Date: 2023/5/15
+ * Author: yangyangyang
+ * Description:
+ * -----
+ * Last Modified: 2023/5/15 15:40:12
+ * -----
+ * Copyright (c) 2023  . All rights reserved.
+ */
+
+#ifndef TINY_FUTURE_ENABLE_TRACE
+#define TINY_FUTURE_ENABLE_TRACE 1
+#endif
+
+#include "future_wrapper/executor.hpp"
+#include "future_wrapper/future.hpp"
+#include "future_wrapper/promise.hpp"
+#include <gtest/gtest.h>
+
+#include <set>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+size_t countOf(const std::string& text, const std::string& pattern) {
+    size_t count = 0;
+    for (size_t pos = text.find(pattern); pos != std::string::npos; pos = text.find(pattern, pos + 1)) {
+        ++count;
+    }
+    return count;
+}
+
+} // namespace
+
+TEST(Trace, FlowFromSetValueToCallback) {
+    // 丢弃之前的事件.
+    std::ostringstream discard;
+    trace::exportChromeTrace(discard);
+
+    constexpr int kFutures = 10;
+    std::atomic<int> done{0};
+    {
+        ThreadExecutor executor(2);
+        for (int i = 0; i < kFutures; ++i) {
+            Promise<int> promise;
+            auto future = promise.getFuture();
+            future.via(&executor);
+            future.thenValue([&done](int&&) { ++done; });
+            promise.setValue(i);
+        }
+        while (done.load() < kFutures) {
+            std::this_thread::yield();
+        }
+    }
+
+    std::ostringstream os;
+    EXPECT_EQ(trace::exportChromeTrace(os), 0);
+    const auto json = os.str();
+    EXPECT_EQ(json.find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["), 0);
+    EXPECT_EQ(countOf(json, "\"name\":\"Promise::setValue\""), kFutures);
+    EXPECT_EQ(countOf(json, "\"name\":\"Executor::submit\""), kFutures);
+    EXPECT_EQ(countOf(json, "\"ph\":\"B\""), kFutures);
+    EXPECT_EQ(countOf(json, "\"ph\":\"E\""), kFutures);
+    EXPECT_EQ(countOf(json, "\"ph\":\"s\""), kFutures);
+    EXPECT_EQ(countOf(json, "\"ph\":\"f\""), kFutures);
+    // 回调在worker线程上执行, 与setValue不在同一个tid.
+    const auto set_pos = json.find("\"name\":\"Promise::setValue\"");
+    const auto begin_pos = json.find("\"ph\":\"B\"");
+    const auto tid_of = [&json](size_t pos) { return json.substr(json.find("\"tid\":", pos), 10); };
+    EXPECT_NE(tid_of(set_pos), tid_of(begin_pos));
+
+    // 已导出的事件不会重复导出.
+    std::ostringstream again;
+    trace::exportChromeTrace(again);
+    EXPECT_EQ(countOf(again.str(), "\"ph\""), 0);
+}
+
+TEST(Trace, OverwriteOldest) {
+    std::ostringstream discard;
+    trace::exportChromeTrace(discard);
+
+    const uint64_t capacity = trace::ThreadBuffer::kCapacity;
+    const uint64_t total = capacity + 100;
+    for (uint64_t i = 0; i < total; ++i) {
+        trace::record(trace::EventKind::CALL, i);
+    }
+    std::ostringstream os;
+    EXPECT_EQ(trace::exportChromeTrace(os), 100);
+    EXPECT_EQ(countOf(os.str(), "\"name\":\"SharedState::call\""), capacity);
+    EXPECT_EQ(os.str().find("\"future\":99}"), std::string::npos);
+    EXPECT_NE(os.str().find("\"future\":100}"), std::string::npos);
+}
+
+// 线程退出后缓冲区由下一个线程复用, 新线程分配的future id不能与之前的线程重复.
+TEST(Trace, IdsUniqueAcrossBufferReuse) {
+    std::ostringstream discard;
+    trace::exportChromeTrace(discard);
+
+    auto make_futures = []() {
+        for (int i = 0; i < 3; ++i) {
+            Promise<int> promise;
+            auto future = promise.getFuture();
+            promise.setValue(i);
+        }
+    };
+    std::thread(make_futures).join();
+    std::thread(make_futures).join();
+
+    std::ostringstream os;
+    trace::exportChromeTrace(os);
+    const auto json = os.str();
+    std::set<std::string> ids;
+    std::set<std::string> tids;
+    for (size_t pos = json.find("\"name\":\"Promise::setValue\""); pos != std::string::npos;
+         pos = json.find("\"name\":\"Promise::setValue\"", pos + 1)) {
+        const auto tid = json.find("\"tid\":", pos);
+        tids.insert(json.substr(tid, json.find(',', tid) - tid));
+        const auto id = json.find("\"future\":", pos);
+        ids.insert(json.substr(id, json.find('}', id) - id));
+    }
+    // 两个线程先后使用同一个缓冲区.
+    EXPECT_EQ(tids.size(), 1);
+    EXPECT_EQ(ids.size(), 6);
+}
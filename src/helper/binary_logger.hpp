@@ -0,0 +1,856 @@
+/* Proj: tiny-future
+ * File: binary_logger.hpp
+ * Created Date: 2023/5/13
+ * Author: yangyangyang
+ * Description: 延迟格式化的二进制日志: 调用处只记录格式id与参数的原始字节, 由写线程或离线工具格式化.
+ * -----
+ * Last Modified: 2023/5/13 17:08:45
+ * -----
+ * Copyright (c) 2023  . All rights reserved.
+ */
+#ifndef TINY_FUTURE_BINARY_LOGGER_HPP
+#define TINY_FUTURE_BINARY_LOGGER_HPP
+
+#include <spdlog/common.h>
+#include <spdlog/details/log_msg_buffer.h>
+#include <spdlog/details/os.h>
+#include <spdlog/logger.h>
+#include <spdlog/pattern_formatter.h>
+#include <spdlog/sinks/sink.h>
+
+#include <fmt/args.h>
+#include <fmt/format.h>
+
+#include "./buffer.hpp"
+#include "./tsc_clock.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#define BLOG_(level, fmt_str, ...)                                                                           \
+    do {                                                                                                     \
+        if (::helper::logger::binlog::shouldLog(level)) {                                                    \
+            static ::helper::logger::binlog::Site blog_site_{level, __FILE__, __LINE__, fmt_str};            \
+            ::helper::logger::binlog::write(blog_site_, ##__VA_ARGS__);                                      \
+        }                                                                                                    \
+    } while (0)
+
+// 用法与LOG_*相同, 参数只支持算术类型与字符串. e.g. BLOG_INFO("recv {} bytes from {}", n, peer);
+#define BLOG_TRACE(fmt_str, ...)    BLOG_(spdlog::level::trace, fmt_str, ##__VA_ARGS__)
+#define BLOG_DEBUG(fmt_str, ...)    BLOG_(spdlog::level::debug, fmt_str, ##__VA_ARGS__)
+#define BLOG_INFO(fmt_str, ...)     BLOG_(spdlog::level::info, fmt_str, ##__VA_ARGS__)
+#define BLOG_WARN(fmt_str, ...)     BLOG_(spdlog::level::warn, fmt_str, ##__VA_ARGS__)
+#define BLOG_ERROR(fmt_str, ...)    BLOG_(spdlog::level::err, fmt_str, ##__VA_ARGS__)
+#define BLOG_CRITICAL(fmt_str, ...) BLOG_(spdlog::level::critical, fmt_str, ##__VA_ARGS__)
+
+namespace helper {
+namespace logger {
+namespace binlog {
+
+enum class ArgType : uint8_t {
+    INT64 = 1,
+    UINT64 = 2,
+    DOUBLE = 3,
+    BOOL = 4,
+    CHAR = 5,
+    STRING = 6, // uint32长度 + 字节
+};
+
+// 每条日志在线程缓冲区中的头部, 之后是参数字节, 整条记录按8字节对齐.
+struct RecordHeader {
+    uint32_t site;
+    uint32_t size;
+    int64_t ticks;
+};
+
+// 调用处的静态描述, 常量初始化, 第一次写入时注册得到id.
+struct Site {
+    constexpr Site(spdlog::level::level_enum lvl, const char* src_file, int src_line, const char* fmt_str) noexcept
+        : level(lvl)
+        , file(src_file)
+        , line(src_line)
+        , format(fmt_str)
+        , id(0) {}
+
+    const spdlog::level::level_enum level;
+    const char* const file;
+    const int line;
+    const char* const format;
+    std::atomic<uint32_t> id;
+};
+
+// 注册后的调用处信息, 供写线程与解码器使用.
+struct SiteInfo {
+    spdlog::level::level_enum level;
+    std::string file;
+    int line;
+    std::string format;
+    std::vector<ArgType> args;
+};
+
+inline int64_t nowTicks() noexcept { return TscClock::nowNanos(); }
+
+inline size_t alignRecord(size_t n) noexcept { return (n + 7) & ~static_cast<size_t>(7); }
+
+/************************************ 参数编码 ************************************/
+
+template <typename T, typename = void>
+struct ArgTraits {
+    static_assert(sizeof(T) == 0, "binary log only supports arithmetic and string arguments");
+};
+
+template <typename T, ArgType kTag, typename Wire>
+struct FixedArg {
+    static constexpr ArgType kType = kTag;
+
+    static size_t size(const T&) noexcept { return sizeof(Wire); }
+
+    static char* encode(char* out, const T& val) noexcept {
+        const auto wire = static_cast<Wire>(val);
+        std::memcpy(out, &wire, sizeof(Wire));
+        return out + sizeof(Wire);
+    }
+};
+
+template <>
+struct ArgTraits<bool> : FixedArg<bool, ArgType::BOOL, uint8_t> {};
+
+template <>
+struct ArgTraits<char> : FixedArg<char, ArgType::CHAR, char> {};
+
+template <typename T>
+struct ArgTraits<T, typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value
+                                            && !std::is_same<T, char>::value>::type>
+    : FixedArg<T, ArgType::INT64, int64_t> {};
+
+template <typename T>
+struct ArgTraits<T, typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value
+                                            && !std::is_same<T, bool>::value && !std::is_same<T, char>::value>::type>
+    : FixedArg<T, ArgType::UINT64, uint64_t> {};
+
+template <typename T>
+struct ArgTraits<T, typename std::enable_if<std::is_floating_point<T>::value>::type>
+    : FixedArg<T, ArgType::DOUBLE, double> {};
+
+template <typename T>
+struct StringArg {
+    static constexpr ArgType kType = ArgType::STRING;
+
+    static size_t size(const T& val) noexcept { return sizeof(uint32_t) + length(val); }
+
+    static char* encode(char* out, const T& val) noexcept {
+        const auto len = static_cast<uint32_t>(length(val));
+        std::memcpy(out, &len, sizeof(len));
+        std::memcpy(out + sizeof(len), data(val), len);
+        return out + sizeof(len) + len;
+    }
+
+private:
+    static size_t length(const char* val) noexcept { return val == nullptr ? 0 : std::strlen(val); }
+    static const char* data(const char* val) noexcept { return val; }
+    template <typename S>
+    static size_t length(const S& val) noexcept {
+        return val.size();
+    }
+    template <typename S>
+    static const char* data(const S& val) noexcept {
+        return val.data();
+    }
+};
+
+template <>
+struct ArgTraits<const char*> : StringArg<const char*> {};
+
+template <>
+struct ArgTraits<char*> : StringArg<const char*> {};
+
+template <>
+struct ArgTraits<std::string> : StringArg<std::string> {};
+
+template <>
+struct ArgTraits<fmt::string_view> : StringArg<fmt::string_view> {};
+
+template <typename T>
+using ArgOf = ArgTraits<typename std::decay<T>::type>;
+
+inline size_t payloadSize() noexcept { return 0; }
+
+template <typename T, typename... Rest>
+inline size_t payloadSize(const T& first, const Rest&... rest) noexcept {
+    return ArgOf<T>::size(first) + payloadSize(rest...);
+}
+
+inline void encodeArgs(char*) noexcept {}
+
+template <typename T, typename... Rest>
+inline void encodeArgs(char* out, const T& first, const Rest&... rest) noexcept {
+    encodeArgs(ArgOf<T>::encode(out, first), rest...);
+}
+
+/**
+ * @brief 按site的参数类型把参数字节格式化为文本, 数据不完整时抛出std::runtime_error.
+ */
+inline std::string formatPayload(const SiteInfo& site, const char* payload, size_t size) {
+    fmt::dynamic_format_arg_store<fmt::format_context> store;
+    const char* end = payload + size;
+    auto take = [&](void* dst, size_t n) {
+        if (static_cast<size_t>(end - payload) < n) {
+            throw std::runtime_error("truncated binary log record");
+        }
+        std::memcpy(dst, payload, n);
+        payload += n;
+    };
+    for (ArgType type : site.args) {
+        switch (type) {
+            case ArgType::INT64: {
+                int64_t v;
+                take(&v, sizeof(v));
+                store.push_back(v);
+                break;
+            }
+            case ArgType::UINT64: {
+                uint64_t v;
+                take(&v, sizeof(v));
+                store.push_back(v);
+                break;
+            }
+            case ArgType::DOUBLE: {
+                double v;
+                take(&v, sizeof(v));
+                store.push_back(v);
+                break;
+            }
+            case ArgType::BOOL: {
+                uint8_t v;
+                take(&v, sizeof(v));
+                store.push_back(v != 0);
+                break;
+            }
+            case ArgType::CHAR: {
+                char v;
+                take(&v, sizeof(v));
+                store.push_back(v);
+                break;
+            }
+            case ArgType::STRING: {
+                uint32_t len;
+                take(&len, sizeof(len));
+                std::string v(len, '\0');
+                take(&v[0], len);
+                store.push_back(std::move(v));
+                break;
+            }
+            default:
+                throw std::runtime_error("unknown binary log argument type");
+        }
+    }
+    try {
+        return fmt::vformat(site.format, store);
+    }
+    catch (const fmt::format_error& ex) {
+        return fmt::format("[format error: {}] {}", ex.what(), site.format);
+    }
+}
+
+/************************************ 线程缓冲区 ************************************/
+
+/**
+ * 变长记录的SPSC字节环, 记录不跨越末尾: 末尾空间不够时写入一个回绕标记, 从头开始.
+ */
+class ByteRing {
+public:
+    static constexpr uint32_t kWrapMarker = UINT32_MAX;
+
+    // capacity为2的幂的字节数.
+    explicit ByteRing(size_t capacity)
+        : m_storage(capacity / sizeof(uint64_t))
+        , m_capacity(capacity)
+        , m_mask(capacity - 1)
+        , m_tail(0)
+        , m_cached_head(0)
+        , m_head(0) {
+        if (capacity < 64 || (capacity & (capacity - 1)) != 0) {
+            throw std::invalid_argument("capacity must be a power of two >= 64");
+        }
+    }
+
+    ByteRing(const ByteRing&) = delete;
+    ByteRing& operator=(const ByteRing&) = delete;
+
+    // 仅生产者调用, n必须8字节对齐. 空间不足时返回nullptr.
+    char* reserve(size_t n) noexcept {
+        const uint64_t tail = m_tail.load(std::memory_order_relaxed);
+        const size_t pos = tail & m_mask;
+        const size_t skip = m_capacity - pos < n ? m_capacity - pos : 0;
+        if (tail + skip + n - m_cached_head > m_capacity) {
+            m_cached_head = m_head.load(std::memory_order_acquire);
+            if (tail + skip + n - m_cached_head > m_capacity) {
+                return nullptr;
+            }
+        }
+        if (skip > 0) {
+            std::memcpy(base() + pos, &kWrapMarker, sizeof(kWrapMarker));
+            m_tail.store(tail + skip, std::memory_order_release);
+            return base();
+        }
+        return base() + pos;
+    }
+
+    void commit(size_t n) noexcept { m_tail.store(m_tail.load(std::memory_order_relaxed) + n, std::memory_order_release); }
+
+    /**
+     * @brief 仅消费者调用, 对每条记录调用f(const RecordHeader&, const char* payload).
+     * @return 处理的记录数.
+     */
+    template <class F>
+    size_t drain(F&& f) {
+        uint64_t head = m_head.load(std::memory_order_relaxed);
+        const uint64_t tail = m_tail.load(std::memory_order_acquire);
+        size_t count = 0;
+        while (head != tail) {
+            const char* p = base() + (head & m_mask);
+            uint32_t site;
+            std::memcpy(&site, p, sizeof(site));
+            if (site == kWrapMarker) {
+                head += m_capacity - (head & m_mask);
+                continue;
+            }
+            RecordHeader header;
+            std::memcpy(&header, p, sizeof(header));
+            f(header, p + sizeof(RecordHeader));
+            head += alignRecord(sizeof(RecordHeader) + header.size);
+            ++count;
+        }
+        m_head.store(head, std::memory_order_release);
+        return count;
+    }
+
+    bool empty() const noexcept {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const noexcept { return m_capacity; }
+
+private:
+    char* base() const noexcept { return reinterpret_cast<char*>(m_storage.data()); }
+
+    RawStorage<uint64_t> m_storage;
+    const size_t m_capacity;
+    const size_t m_mask;
+    char m_pad0[kCacheLineSize];
+
+    // 生产者独占.
+    std::atomic<uint64_t> m_tail;
+    uint64_t m_cached_head;
+    char m_pad1[kCacheLineSize];
+
+    // 消费者独占.
+    std::atomic<uint64_t> m_head;
+    char m_pad2[kCacheLineSize];
+};
+
+struct ThreadBuffer {
+    explicit ThreadBuffer(size_t capacity)
+        : ring(capacity)
+        , tid(spdlog::details::os::thread_id()) {}
+
+    ByteRing ring;
+    const size_t tid;
+    // 缓冲区满时丢弃的条数, 只由所属线程写.
+    std::atomic<uint64_t> dropped{0};
+    // 所属线程已退出, 写线程取空后回收.
+    std::atomic<bool> retired{false};
+};
+
+/**
+ * 全局注册表: 调用处信息与各线程的缓冲区.
+ */
+class Registry {
+public:
+    static constexpr size_t kDefaultBufferSize = 1 << 20;
+
+    static Registry& instance() {
+        static Registry registry;
+        return registry;
+    }
+
+    template <typename... Args>
+    uint32_t registerSite(Site& site) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint32_t id = site.id.load(std::memory_order_relaxed);
+        if (id != 0) {
+            return id;
+        }
+        const char* file = std::strrchr(site.file, '/');
+        sites_.push_back(SiteInfo{site.level, file ? file + 1 : site.file, site.line, site.format,
+                                  std::vector<ArgType>{ArgOf<Args>::kType...}});
+        id = static_cast<uint32_t>(sites_.size());
+        site.id.store(id, std::memory_order_release);
+        return id;
+    }
+
+    // 把out之后新注册的调用处追加到out, id为下标加一.
+    void copySites(std::vector<SiteInfo>& out) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        out.insert(out.end(), sites_.begin() + static_cast<std::ptrdiff_t>(out.size()), sites_.end());
+    }
+
+    std::shared_ptr<ThreadBuffer> newBuffer() {
+        auto buffer = std::make_shared<ThreadBuffer>(buffer_size_.load(std::memory_order_relaxed));
+        std::lock_guard<std::mutex> lock(mutex_);
+        buffers_.push_back(buffer);
+        ++buffers_version_;
+        return buffer;
+    }
+
+    // buffers_有变化时拷贝到out, 并回收已退出且取空的线程缓冲区.
+    void syncBuffers(std::vector<std::shared_ptr<ThreadBuffer>>& out, uint64_t& version) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = std::remove_if(buffers_.begin(), buffers_.end(), [this](const std::shared_ptr<ThreadBuffer>& b) {
+            if (b->retired.load(std::memory_order_acquire) && b->ring.empty()) {
+                retired_dropped_ += b->dropped.load(std::memory_order_relaxed);
+                return true;
+            }
+            return false;
+        });
+        if (it != buffers_.end()) {
+            buffers_.erase(it, buffers_.end());
+            ++buffers_version_;
+        }
+        if (version != buffers_version_) {
+            out = buffers_;
+            version = buffers_version_;
+        }
+    }
+
+    uint64_t dropped() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint64_t total = retired_dropped_;
+        for (auto& buffer : buffers_) {
+            total += buffer->dropped.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    // 之后新建的线程缓冲区大小.
+    void setBufferSize(size_t bytes) noexcept { buffer_size_.store(bytes, std::memory_order_relaxed); }
+
+    std::atomic<int> level{spdlog::level::info};
+    // 同时只允许一个写线程消费缓冲区.
+    std::atomic<bool> writer_active{false};
+
+private:
+    std::mutex mutex_;
+    std::vector<SiteInfo> sites_;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers_;
+    uint64_t buffers_version_{0};
+    uint64_t retired_dropped_{0};
+    std::atomic<size_t> buffer_size_{kDefaultBufferSize};
+};
+
+inline bool shouldLog(spdlog::level::level_enum lvl) noexcept {
+    return lvl >= Registry::instance().level.load(std::memory_order_relaxed);
+}
+
+inline void setLevel(spdlog::level::level_enum lvl) noexcept {
+    Registry::instance().level.store(lvl, std::memory_order_relaxed);
+}
+
+namespace detail {
+
+// 线程退出时标记缓冲区, 由写线程取空后回收.
+struct ThreadBufferHolder {
+    std::shared_ptr<ThreadBuffer> buffer;
+
+    ~ThreadBufferHolder() {
+        if (buffer) {
+            buffer->retired.store(true, std::memory_order_release);
+        }
+    }
+};
+
+inline ThreadBuffer& newLocalBuffer(ThreadBuffer*& cache) {
+    static thread_local ThreadBufferHolder holder;
+    holder.buffer = Registry::instance().newBuffer();
+    cache = holder.buffer.get();
+    return *cache;
+}
+
+// 快路径只读一个平凡的thread_local指针.
+inline ThreadBuffer& localBuffer() {
+    static thread_local ThreadBuffer* buffer = nullptr;
+    return buffer != nullptr ? *buffer : newLocalBuffer(buffer);
+}
+
+} // namespace detail
+
+/**
+ * @brief 记录一条日志: 只拷贝参数字节, 不格式化. 缓冲区满时丢弃并计数.
+ */
+template <typename... Args>
+inline void write(Site& site, const Args&... args) {
+    uint32_t id = site.id.load(std::memory_order_acquire);
+    if (id == 0) {
+        id = Registry::instance().registerSite<Args...>(site);
+    }
+    const size_t payload = payloadSize(args...);
+    const size_t total = alignRecord(sizeof(RecordHeader) + payload);
+    ThreadBuffer& buffer = detail::localBuffer();
+    char* out = buffer.ring.reserve(total);
+    if (out == nullptr) {
+        buffer.dropped.store(buffer.dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+    const RecordHeader header{id, static_cast<uint32_t>(payload), nowTicks()};
+    std::memcpy(out, &header, sizeof(header));
+    encodeArgs(out + sizeof(header), args...);
+    buffer.ring.commit(total);
+}
+
+/************************************ 文件格式 ************************************/
+
+/**
+ * 二进制日志文件: FileHeader之后是一串记录, 每条以一个字节的kind开头.
+ *   SITE: u32 id, u8 level, i32 line, u16 len + file, u16 len + format, u8 nargs, u8 types[nargs]
+ *   LOG : u64 tid, RecordHeader, payload
+ * 调用处在第一次被引用之前写入, 文件是自描述的.
+ */
+struct FileHeader {
+    static constexpr uint32_t kMagic = 0x4c424654; // "TFBL"
+    static constexpr uint32_t kVersion = 1;
+
+    uint32_t magic;
+    uint32_t version;
+    // 同一时刻的系统时间与ticks, 用于把ticks换算为墙上时间.
+    int64_t anchor_system_ns;
+    int64_t anchor_ticks;
+};
+
+enum class FileRecord : uint8_t {
+    SITE = 1,
+    LOG = 2,
+};
+
+inline FileHeader makeFileHeader() noexcept {
+    FileHeader header{};
+    header.magic = FileHeader::kMagic;
+    header.version = FileHeader::kVersion;
+    header.anchor_ticks = nowTicks();
+    header.anchor_system_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(spdlog::log_clock::now().time_since_epoch()).count();
+    return header;
+}
+
+inline spdlog::log_clock::time_point toLogTime(const FileHeader& anchor, int64_t ticks) noexcept {
+    return spdlog::log_clock::time_point(std::chrono::duration_cast<spdlog::log_clock::duration>(
+      std::chrono::nanoseconds(anchor.anchor_system_ns + (ticks - anchor.anchor_ticks))));
+}
+
+/**
+ * 离线读取二进制日志文件, 逐条还原为log_msg.
+ */
+class BinaryLogReader {
+public:
+    explicit BinaryLogReader(std::istream& in)
+        : in_(in) {
+        read(&header_, sizeof(header_));
+        if (header_.magic != FileHeader::kMagic || header_.version != FileHeader::kVersion) {
+            throw std::runtime_error("not a binary log file");
+        }
+    }
+
+    /**
+     * @brief 读取下一条日志, 文件结束时返回false. msg中的字符串在下一次调用前有效.
+     */
+    bool next(spdlog::details::log_msg& msg) {
+        while (true) {
+            uint8_t kind;
+            if (!in_.read(reinterpret_cast<char*>(&kind), 1)) {
+                return false;
+            }
+            if (kind == static_cast<uint8_t>(FileRecord::SITE)) {
+                readSite();
+                continue;
+            }
+            if (kind != static_cast<uint8_t>(FileRecord::LOG)) {
+                throw std::runtime_error("corrupted binary log file");
+            }
+            uint64_t tid;
+            RecordHeader header;
+            read(&tid, sizeof(tid));
+            read(&header, sizeof(header));
+            payload_.resize(header.size);
+            read(&payload_[0], header.size);
+            if (header.site == 0 || header.site > sites_.size()) {
+                throw std::runtime_error("unknown binary log site");
+            }
+            const SiteInfo& site = sites_[header.site - 1];
+            text_ = formatPayload(site, payload_.data(), payload_.size());
+            msg = spdlog::details::log_msg(toLogTime(header_, header.ticks),
+                                           spdlog::source_loc{site.file.c_str(), site.line, ""}, "", site.level, text_);
+            msg.thread_id = static_cast<size_t>(tid);
+            return true;
+        }
+    }
+
+private:
+    void read(void* dst, size_t n) {
+        if (n > 0 && !in_.read(static_cast<char*>(dst), static_cast<std::streamsize>(n))) {
+            throw std::runtime_error("truncated binary log file");
+        }
+    }
+
+    std::string readString() {
+        uint16_t len;
+        read(&len, sizeof(len));
+        std::string s(len, '\0');
+        read(&s[0], len);
+        return s;
+    }
+
+    void readSite() {
+        uint32_t id;
+        uint8_t level;
+        int32_t line;
+        read(&id, sizeof(id));
+        read(&level, sizeof(level));
+        read(&line, sizeof(line));
+        SiteInfo site;
+        site.level = static_cast<spdlog::level::level_enum>(level);
+        site.line = line;
+        site.file = readString();
+        site.format = readString();
+        uint8_t nargs;
+        read(&nargs, sizeof(nargs));
+        site.args.resize(nargs);
+        read(site.args.data(), nargs);
+        if (id != sites_.size() + 1) {
+            throw std::runtime_error("corrupted binary log site table");
+        }
+        sites_.push_back(std::move(site));
+    }
+
+    std::istream& in_;
+    FileHeader header_{};
+    std::vector<SiteInfo> sites_;
+    std::string payload_;
+    std::string text_;
+};
+
+constexpr const char* kDecodePattern = "[%C-%m-%d %T.%e (T)%t] [%l] [%s:%#] %v";
+
+/**
+ * @brief 把二进制日志文件解码为文本.
+ * @return 解码的日志条数.
+ */
+inline size_t decodeBinaryLog(std::istream& in, std::ostream& out, const std::string& pattern = kDecodePattern) {
+    BinaryLogReader reader(in);
+    spdlog::pattern_formatter formatter(pattern);
+    spdlog::details::log_msg msg;
+    spdlog::memory_buf_t buf;
+    size_t count = 0;
+    while (reader.next(msg)) {
+        buf.clear();
+        formatter.format(msg, buf);
+        out.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+        ++count;
+    }
+    return count;
+}
+
+} // namespace binlog
+
+/**
+ * 二进制日志的后台写线程, 定期取空所有线程缓冲区. 同时只能存在一个.
+ *
+ * 文本模式: 解码后按logger的sinks与格式输出, 格式化只发生在写线程.
+ * 二进制模式: 原始记录追加到文件, 之后由binlog::decodeBinaryLog或binlog_decode工具离线解码.
+ * 析构时写完已记录的日志.
+ */
+class BinaryLogWriter {
+public:
+    explicit BinaryLogWriter(std::shared_ptr<spdlog::logger> logger,
+                             std::chrono::milliseconds interval = std::chrono::milliseconds(1))
+        : logger_(std::move(logger))
+        , interval_(interval) {
+        start();
+    }
+
+    explicit BinaryLogWriter(const std::string& path, std::chrono::milliseconds interval = std::chrono::milliseconds(1))
+        : interval_(interval) {
+        file_ = std::fopen(path.c_str(), "wb");
+        if (file_ == nullptr) {
+            throw std::system_error(errno, std::system_category(), "open " + path);
+        }
+        std::setvbuf(file_, nullptr, _IOFBF, 1 << 20);
+        std::fwrite(&anchor_, sizeof(anchor_), 1, file_);
+        start();
+    }
+
+    ~BinaryLogWriter() noexcept {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_one();
+        thread_.join();
+        if (file_ != nullptr) {
+            std::fclose(file_);
+        }
+        binlog::Registry::instance().writer_active.store(false, std::memory_order_release);
+    }
+
+    BinaryLogWriter(const BinaryLogWriter&) = delete;
+    BinaryLogWriter& operator=(const BinaryLogWriter&) = delete;
+
+    // 各线程因缓冲区满而丢弃的总条数.
+    uint64_t dropped() const { return binlog::Registry::instance().dropped(); }
+
+private:
+    void start() {
+        if (binlog::Registry::instance().writer_active.exchange(true, std::memory_order_acq_rel)) {
+            if (file_ != nullptr) {
+                std::fclose(file_);
+            }
+            throw std::logic_error("another BinaryLogWriter is running");
+        }
+        thread_ = std::thread(&BinaryLogWriter::run, this);
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stop_) {
+            lock.unlock();
+            const size_t n = drainAll();
+            lock.lock();
+            if (n == 0) {
+                flushOutput();
+                cv_.wait_for(lock, interval_, [this]() { return stop_; });
+            }
+        }
+        lock.unlock();
+        // 退出前再取一次, 保证stop之前记录的日志都已写出.
+        drainAll();
+        flushOutput();
+    }
+
+    size_t drainAll() {
+        binlog::Registry::instance().syncBuffers(buffers_, buffers_version_);
+        size_t count = 0;
+        for (auto& buffer : buffers_) {
+            const size_t tid = buffer->tid;
+            count += buffer->ring.drain([this, tid](const binlog::RecordHeader& header, const char* payload) {
+                try {
+                    handle(tid, header, payload);
+                }
+                catch (const std::exception& ex) {
+                    std::fprintf(stderr, "binary log write failed: %s\n", ex.what());
+                }
+            });
+        }
+        return count;
+    }
+
+    const binlog::SiteInfo& site(uint32_t id) {
+        if (id > sites_.size()) {
+            binlog::Registry::instance().copySites(sites_);
+        }
+        return sites_[id - 1];
+    }
+
+    void handle(size_t tid, const binlog::RecordHeader& header, const char* payload) {
+        const binlog::SiteInfo& info = site(header.site);
+        if (file_ != nullptr) {
+            writeBinary(tid, header, payload);
+            return;
+        }
+        const std::string text = binlog::formatPayload(info, payload, header.size);
+        spdlog::details::log_msg msg(binlog::toLogTime(anchor_, header.ticks),
+                                     spdlog::source_loc{info.file.c_str(), info.line, ""}, logger_->name(), info.level,
+                                     text);
+        msg.thread_id = tid;
+        for (auto& sink : logger_->sinks()) {
+            if (sink->should_log(msg.level)) {
+                sink->log(msg);
+            }
+        }
+    }
+
+    void writeBinary(size_t tid, const binlog::RecordHeader& header, const char* payload) {
+        while (written_sites_ < header.site) {
+            const binlog::SiteInfo& s = sites_[written_sites_++];
+            const uint32_t id = written_sites_;
+            const auto level = static_cast<uint8_t>(s.level);
+            const auto line = static_cast<int32_t>(s.line);
+            const auto nargs = static_cast<uint8_t>(s.args.size());
+            put(static_cast<uint8_t>(binlog::FileRecord::SITE));
+            put(id);
+            put(level);
+            put(line);
+            putString(s.file);
+            putString(s.format);
+            put(nargs);
+            std::fwrite(s.args.data(), 1, s.args.size(), file_);
+        }
+        put(static_cast<uint8_t>(binlog::FileRecord::LOG));
+        put(static_cast<uint64_t>(tid));
+        put(header);
+        std::fwrite(payload, 1, header.size, file_);
+    }
+
+    template <typename T>
+    void put(const T& val) {
+        std::fwrite(&val, sizeof(T), 1, file_);
+    }
+
+    void putString(const std::string& s) {
+        const auto len = static_cast<uint16_t>(std::min<size_t>(s.size(), UINT16_MAX));
+        put(len);
+        std::fwrite(s.data(), 1, len, file_);
+    }
+
+    void flushOutput() {
+        if (file_ != nullptr) {
+            std::fflush(file_);
+            return;
+        }
+        for (auto& sink : logger_->sinks()) {
+            sink->flush();
+        }
+    }
+
+    std::shared_ptr<spdlog::logger> logger_;
+    std::FILE* file_{nullptr};
+    const binlog::FileHeader anchor_{binlog::makeFileHeader()};
+    const std::chrono::milliseconds interval_;
+
+    // 以下只由写线程访问.
+    std::vector<std::shared_ptr<binlog::ThreadBuffer>> buffers_;
+    uint64_t buffers_version_{0};
+    std::vector<binlog::SiteInfo> sites_;
+    uint32_t written_sites_{0};
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stop_{false};
+    std::thread thread_;
+};
+
+} // namespace logger
+} // namespace helper
+
+#endif // TINY_FUTURE_BINARY_LOGGER_HPP
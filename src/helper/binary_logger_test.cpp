@@ -0,0 +1,107 @@
+/* Proj: tiny-future
+ * File: binary_logger_test.cpp
+ * Created Date: 2023/5/13
+ * Author: yangyangyang
+ * Description:
+ * -----
+ * Last Modified: 2023/5/13 18:12:20
+ * -----
+ * Copyright (c) 2023  . All rights reserved.
+ */
+
+#include <gtest/gtest.h>
+
+#include "./binary_logger.hpp"
+
+#include <spdlog/sinks/ostream_sink.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+using namespace helper::logger;
+
+namespace {
+
+std::vector<std::string> splitLines(const std::string& text) {
+    std::vector<std::string> lines;
+    std::istringstream in(text);
+    for (std::string line; std::getline(in, line);) {
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+} // namespace
+
+TEST(BinaryLogger, TextModeFormatsOnWriter) {
+    std::ostringstream out;
+    auto sink = std::make_shared<spdlog::sinks::ostream_sink_mt>(out);
+    auto logger = std::make_shared<spdlog::logger>("binlog", sink);
+    logger->set_pattern("[%l] %v");
+    {
+        BinaryLogWriter writer(logger);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 2; ++t) {
+            threads.emplace_back([t]() {
+                for (int i = 0; i < 100; ++i) {
+                    BLOG_INFO("thread {} item {} name {} ratio {:.1f}", t, i, std::string("x"), 0.5);
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        BLOG_WARN("no args");
+        // 低于级别的日志不会被记录.
+        BLOG_DEBUG("hidden {}", 1);
+    }
+    auto lines = splitLines(out.str());
+    ASSERT_EQ(lines.size(), 201);
+    EXPECT_NE(std::find(lines.begin(), lines.end(), "[info] thread 1 item 99 name x ratio 0.5"), lines.end());
+    EXPECT_NE(std::find(lines.begin(), lines.end(), "[warning] no args"), lines.end());
+}
+
+TEST(BinaryLogger, BinaryFileRoundTrip) {
+    const std::string path = "/tmp/tiny_future_binlog_" + std::to_string(::getpid()) + ".bin";
+    {
+        BinaryLogWriter writer(path);
+        const char* name = "disk0";
+        BLOG_ERROR("{} {} {} {} {} {}", -7, 42u, true, 'c', name, 1.25);
+        BLOG_INFO("empty string [{}]", "");
+    }
+    std::ifstream in(path, std::ios::binary);
+    std::ostringstream out;
+    EXPECT_EQ(binlog::decodeBinaryLog(in, out, "[%l] [%s] %v"), 2);
+    const auto lines = splitLines(out.str());
+    ASSERT_EQ(lines.size(), 2);
+    EXPECT_EQ(lines[0], "[error] [binary_logger_test.cpp] -7 42 true c disk0 1.25");
+    EXPECT_EQ(lines[1], "[info] [binary_logger_test.cpp] empty string []");
+    ::unlink(path.c_str());
+}
+
+TEST(BinaryLogger, DropsWhenBufferFull) {
+    auto& registry = binlog::Registry::instance();
+    const uint64_t before = registry.dropped();
+    registry.setBufferSize(256);
+    // 没有写线程时, 新线程的小缓冲区很快写满.
+    std::thread([]() {
+        for (int i = 0; i < 100; ++i) {
+            BLOG_INFO("value {}", i);
+        }
+    }).join();
+    registry.setBufferSize(binlog::Registry::kDefaultBufferSize);
+    EXPECT_GT(registry.dropped() - before, 80);
+
+    std::ostringstream out;
+    auto logger = std::make_shared<spdlog::logger>("binlog", std::make_shared<spdlog::sinks::ostream_sink_mt>(out));
+    logger->set_pattern("%v");
+    {
+        BinaryLogWriter writer(logger);
+        EXPECT_THROW(BinaryLogWriter(std::make_shared<spdlog::logger>("other")), std::logic_error);
+    }
+    // 已退出线程中缓冲的日志仍然会被写出.
+    const auto lines = splitLines(out.str());
+    ASSERT_FALSE(lines.empty());
+    EXPECT_EQ(lines[0], "value 0");
+}
@@ -1,43 +1,109 @@
 #pragma once
 
+#include "future_wrapper/define.hpp"
+
+#include <algorithm>
+#include <atomic>
 #include <boost/circular_buffer.hpp>
+#include <cassert>
+#include <chrono>
+#include <climits>
 #include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <linux/futex.h>
+#include <memory>
 #include <mutex>
+#include <new>
 #include <stdexcept>
+#include <sys/syscall.h>
 #include <thread>
+#include <type_traits>
+#include <unistd.h>
 #include <utility>
 #include <vector>
 
-class MoveOnlyAble {
+// 连续内存视图.
+template <typename T>
+struct Span {
+    T* data;
+    size_t size;
+};
+
+// 环形缓冲区上的一段区域, 跨越末尾时分为两段连续内存.
+template <typename T>
+struct SpanPair {
+    Span<T> first;
+    Span<T> second;
+
+    size_t size() const noexcept { return first.size + second.size; }
+};
+
+// 未初始化的定长存储, 只负责内存的分配与释放, 元素的构造与析构由使用者负责.
+template <typename T>
+class RawStorage : public MoveOnlyAble {
 public:
-    explicit MoveOnlyAble() noexcept = default;
-    MoveOnlyAble(MoveOnlyAble&&) noexcept = default;
-    MoveOnlyAble& operator=(MoveOnlyAble&&) noexcept = default;
+    explicit RawStorage(size_t capacity)
+        : m_data(static_cast<T*>(::operator new(capacity * sizeof(T))))
+        , m_capacity(capacity) {}
+
+    ~RawStorage() noexcept { ::operator delete(m_data); }
+
+    RawStorage(RawStorage&& other) noexcept
+        : m_data(other.m_data)
+        , m_capacity(other.m_capacity) {
+        other.m_data = nullptr;
+        other.m_capacity = 0;
+    }
+
+    RawStorage& operator=(RawStorage&& other) noexcept {
+        std::swap(m_data, other.m_data);
+        std::swap(m_capacity, other.m_capacity);
+        return *this;
+    }
+
+    inline T* data() const noexcept { return m_data; }
+
+    inline T& operator[](size_t idx) const noexcept { return m_data[idx]; }
+
+    inline size_t capacity() const noexcept { return m_capacity; }
+
+private:
+    T* m_data;
+    size_t m_capacity;
 };
 
 template <typename T>
 class RingBuffer : public MoveOnlyAble {
 public:
     explicit RingBuffer(size_t size)
-        : m_data(nullptr)
-        , m_capacity(0)
+        : m_storage(check_size(size))
         , m_head(0)
         , m_tail(0)
-        , m_size(0) {
+        , m_size(0) {}
 
-        if (size <= 0) {
-            throw std::invalid_argument("size must be non-negative");
-        }
-        m_data = new T[size];
-        m_capacity = size;
+    ~RingBuffer() noexcept { release(m_size); }
+
+    RingBuffer(RingBuffer&& other) noexcept
+        : m_storage(std::move(other.m_storage))
+        , m_head(other.m_head)
+        , m_tail(other.m_tail)
+        , m_size(other.m_size) {
+        other.m_head = other.m_tail = other.m_size = 0;
     }
 
-    ~RingBuffer() noexcept {
-        if (m_data != nullptr) {
-            delete[] m_data;
-            m_data = nullptr;
+    RingBuffer& operator=(RingBuffer&& other) noexcept {
+        if (this != &other) {
+            release(m_size);
+            m_storage = std::move(other.m_storage);
+            m_head = other.m_head;
+            m_tail = other.m_tail;
+            m_size = other.m_size;
+            other.m_head = other.m_tail = other.m_size = 0;
         }
-        m_head = m_tail = m_size = m_capacity = 0;
+        return *this;
     }
 
     template <class U>
@@ -45,8 +111,8 @@ public:
         if (full()) {
             return false;
         }
-        m_data[m_tail] = std::forward<U>(val);
-        increment_pos(m_tail);
+        new (&m_storage[m_tail]) T(std::forward<U>(val));
+        increment_pos(m_tail, 1);
         ++m_size;
         return true;
     }
@@ -55,26 +121,668 @@ public:
         if (empty()) {
             return false;
         }
-        val = std::move_if_noexcept(m_data[m_head]);
-        increment_pos(m_head);
-        --m_size;
+        val = std::move_if_noexcept(m_storage[m_head]);
+        release(1);
         return true;
     }
 
-    inline bool full() const noexcept { return m_size == m_capacity; };
+    /**
+     * @brief 生产者两阶段写入的第一步: 取得最多n个空闲槽位, 不移动tail.
+     * 槽位是未初始化的内存, 非平凡类型需要用placement new构造, 然后调用commit.
+     */
+    SpanPair<T> reserve(size_t n) noexcept { return regions(m_tail, std::min(n, m_storage.capacity() - m_size)); }
+
+    // 发布reserve得到的前n个槽位(必须已构造).
+    void commit(size_t n) noexcept {
+        assert(n <= m_storage.capacity() - m_size);
+        increment_pos(m_tail, n);
+        m_size += n;
+    }
+
+    // 消费者原地读取: 取得最多n个可读元素, 不移动head.
+    SpanPair<T> peek(size_t n) noexcept { return regions(m_head, std::min(n, m_size)); }
+
+    // 析构并释放最前面的n个元素.
+    void release(size_t n) noexcept {
+        assert(n <= m_size);
+        if (!std::is_trivially_destructible<T>::value) {
+            for (size_t i = 0, pos = m_head; i < n; ++i) {
+                m_storage[pos].~T();
+                increment_pos(pos, 1);
+            }
+        }
+        increment_pos(m_head, n);
+        m_size -= n;
+    }
+
+    /**
+     * @brief 批量写入最多n个元素, 至多两次memcpy.
+     * @return 实际写入的个数.
+     */
+    template <typename U = T, typename = typename std::enable_if<std::is_trivially_copyable<U>::value>::type>
+    size_t push_n(const T* src, size_t n) noexcept {
+        auto spans = reserve(n);
+        // n为0, 已满或被移走(存储为空指针)时不调用memcpy: 空指针即使长度为0也是未定义行为.
+        if (spans.first.size == 0) {
+            return 0;
+        }
+        std::memcpy(spans.first.data, src, spans.first.size * sizeof(T));
+        if (spans.second.size > 0) {
+            std::memcpy(spans.second.data, src + spans.first.size, spans.second.size * sizeof(T));
+        }
+        commit(spans.size());
+        return spans.size();
+    }
+
+    /**
+     * @brief 批量读出最多n个元素, 至多两次memcpy.
+     * @return 实际读出的个数.
+     */
+    template <typename U = T, typename = typename std::enable_if<std::is_trivially_copyable<U>::value>::type>
+    size_t pop_n(T* dst, size_t n) noexcept {
+        auto spans = peek(n);
+        if (spans.first.size == 0) {
+            return 0;
+        }
+        std::memcpy(dst, spans.first.data, spans.first.size * sizeof(T));
+        if (spans.second.size > 0) {
+            std::memcpy(dst + spans.first.size, spans.second.data, spans.second.size * sizeof(T));
+        }
+        release(spans.size());
+        return spans.size();
+    }
+
+    inline bool full() const noexcept { return m_size == m_storage.capacity(); };
 
     inline bool empty() const noexcept { return m_size == 0; };
 
     inline size_t size() const noexcept { return m_size; }
 
-    inline size_t captity() const noexcept { return m_capacity; }
+    inline size_t captity() const noexcept { return m_storage.capacity(); }
+
+private:
+    static size_t check_size(size_t size) {
+        if (size <= 0) {
+            throw std::invalid_argument("size must be non-negative");
+        }
+        return size;
+    }
+
+    SpanPair<T> regions(size_t pos, size_t n) const noexcept {
+        const size_t first = std::min(n, m_storage.capacity() - pos);
+        return {
+          {m_storage.data() + pos, first    },
+          {m_storage.data(),       n - first},
+        };
+    }
+
+    // n <= capacity, 用比较代替取模.
+    inline void increment_pos(size_t& pos, size_t n) noexcept {
+        pos += n;
+        if (pos >= m_storage.capacity()) {
+            pos -= m_storage.capacity();
+        }
+    }
 
 private:
-    inline void increment_pos(size_t& pos) noexcept { pos = (pos + 1) % m_capacity; }
+    RawStorage<T> m_storage;
+    size_t m_head, m_tail, m_size;
+};
+
+constexpr size_t kCacheLineSize = 64;
+
+/**
+ * 无锁单生产者单消费者环形队列, 只允许一个线程push, 一个线程pop.
+ *
+ * 容量向上取整为2的幂, 下标单调递增并通过掩码取模. 生产者与消费者的下标分别独占缓存行,
+ * 并各自缓存对方下标的副本, 只有副本显示满/空时才读取对方的原子变量, 减少缓存行争用.
+ */
+template <typename T>
+class SpscRingBuffer {
+public:
+    explicit SpscRingBuffer(size_t size)
+        : m_data(nullptr)
+        , m_mask(0)
+        , m_tail(0)
+        , m_cached_head(0)
+        , m_head(0)
+        , m_cached_tail(0) {
+
+        if (size <= 0) {
+            throw std::invalid_argument("size must be non-negative");
+        }
+        size_t capacity = 1;
+        while (capacity < size) {
+            capacity <<= 1;
+        }
+        m_data = static_cast<T*>(::operator new(capacity * sizeof(T)));
+        m_mask = capacity - 1;
+    }
+
+    ~SpscRingBuffer() noexcept {
+        const size_t tail = m_tail.load(std::memory_order_acquire);
+        for (size_t head = m_head.load(std::memory_order_acquire); head != tail; ++head) {
+            m_data[head & m_mask].~T();
+        }
+        ::operator delete(m_data);
+        m_data = nullptr;
+    }
+
+    SpscRingBuffer(const SpscRingBuffer&) = delete;
+    SpscRingBuffer& operator=(const SpscRingBuffer&) = delete;
+
+    // 仅生产者线程调用.
+    template <class U>
+    bool try_push(U&& val) noexcept(std::is_nothrow_constructible<T, U&&>::value) {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_cached_head > m_mask) {
+            m_cached_head = m_head.load(std::memory_order_acquire);
+            if (tail - m_cached_head > m_mask) {
+                return false;
+            }
+        }
+        new (&m_data[tail & m_mask]) T(std::forward<U>(val));
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 仅消费者线程调用.
+    bool try_pop(T& val) noexcept {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_cached_tail) {
+            m_cached_tail = m_tail.load(std::memory_order_acquire);
+            if (head == m_cached_tail) {
+                return false;
+            }
+        }
+        T& slot = m_data[head & m_mask];
+        val = std::move_if_noexcept(slot);
+        slot.~T();
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 以下查询在并发时只是近似值.
+    inline bool full() const noexcept { return size() > m_mask; };
+
+    inline bool empty() const noexcept { return size() == 0; };
+
+    inline size_t size() const noexcept {
+        const size_t head = m_head.load(std::memory_order_acquire);
+        const size_t tail = m_tail.load(std::memory_order_acquire);
+        return tail - head;
+    }
+
+    inline size_t capacity() const noexcept { return m_mask + 1; }
 
 private:
+    // 只读字段.
     T* m_data;
-    size_t m_head, m_tail, m_size, m_capacity;
+    size_t m_mask;
+    char m_pad0[kCacheLineSize];
+
+    // 生产者独占.
+    std::atomic<size_t> m_tail;
+    size_t m_cached_head;
+    char m_pad1[kCacheLineSize];
+
+    // 消费者独占.
+    std::atomic<size_t> m_head;
+    size_t m_cached_tail;
+    char m_pad2[kCacheLineSize];
+};
+
+namespace detail {
+
+inline void futexWait(const std::atomic<uint32_t>* addr, uint32_t expected) noexcept {
+    ::syscall(SYS_futex, reinterpret_cast<const uint32_t*>(addr), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+}
+
+inline void futexWakeAll(const std::atomic<uint32_t>* addr) noexcept {
+    ::syscall(SYS_futex, reinterpret_cast<const uint32_t*>(addr), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+}
+
+} // namespace detail
+
+/**
+ * EventCount: 把"条件不满足时阻塞"加到无锁结构上, 没有等待者时notify只是一次原子读.
+ *
+ * 等待方:  key = prepareWait(); 重新检查条件; 满足则cancelWait(), 否则wait(key).
+ * 通知方:  修改状态后调用notify().
+ */
+class EventCount {
+public:
+    using Key = uint32_t;
+
+    Key prepareWait() noexcept {
+        waiters_.fetch_add(1, std::memory_order_seq_cst);
+        return epoch_.load(std::memory_order_acquire);
+    }
+
+    void cancelWait() noexcept { waiters_.fetch_sub(1, std::memory_order_seq_cst); }
+
+    void wait(Key key) noexcept {
+        while (epoch_.load(std::memory_order_acquire) == key) {
+            detail::futexWait(&epoch_, key);
+        }
+        waiters_.fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+    void notify() noexcept {
+        // 与prepareWait中的fetch_add配对, 保证要么通知方看到等待者, 要么等待方看到新状态.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters_.load(std::memory_order_relaxed) == 0) {
+            return;
+        }
+        epoch_.fetch_add(1, std::memory_order_release);
+        detail::futexWakeAll(&epoch_);
+    }
+
+private:
+    std::atomic<uint32_t> epoch_{0};
+    std::atomic<uint32_t> waiters_{0};
+};
+
+/**
+ * 有界无锁多生产者多消费者队列(Vyukov), 接口与ThreadSafeQueue一致, 可直接替换.
+ *
+ * 每个槽位带序号: seq == pos 表示可写, seq == pos + 1 表示可读. 生产者/消费者只在各自的下标上CAS,
+ * 槽位按缓存行对齐, 相邻槽位不会伪共享. wait_*版本只在失败时才经由EventCount阻塞.
+ */
+template <typename T>
+class MpmcQueue {
+public:
+    using Value = T;
+    using Self = MpmcQueue;
+
+    explicit MpmcQueue(size_t capacity)
+        : cells_(nullptr)
+        , mask_(0)
+        , enqueue_pos_(0)
+        , dequeue_pos_(0) {
+        if (capacity <= 0) {
+            throw std::invalid_argument("capacity must be non-negative");
+        }
+        size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        void* mem = nullptr;
+        if (::posix_memalign(&mem, kCacheLineSize, size * sizeof(Cell)) != 0) {
+            throw std::bad_alloc();
+        }
+        cells_ = static_cast<Cell*>(mem);
+        for (size_t i = 0; i < size; ++i) {
+            new (&cells_[i]) Cell();
+            cells_[i].seq.store(i, std::memory_order_relaxed);
+        }
+        mask_ = size - 1;
+    }
+
+    ~MpmcQueue() noexcept {
+        const size_t tail = enqueue_pos_.load(std::memory_order_acquire);
+        for (size_t pos = dequeue_pos_.load(std::memory_order_acquire); pos != tail; ++pos) {
+            cells_[pos & mask_].ptr()->~T();
+        }
+        for (size_t i = 0; i <= mask_; ++i) {
+            cells_[i].~Cell();
+        }
+        ::free(cells_);
+    }
+
+    MpmcQueue(const MpmcQueue&) = delete;
+    MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+    template <typename U>
+    bool try_push(U&& val) noexcept {
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells_[pos & mask_];
+            const size_t seq = cell->seq.load(std::memory_order_acquire);
+            const auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            else if (diff < 0) {
+                return false;
+            }
+            else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        new (cell->ptr()) T(std::forward<U>(val));
+        cell->seq.store(pos + 1, std::memory_order_release);
+        not_empty_.notify();
+        return true;
+    }
+
+    template <typename U>
+    void wait_and_push(U&& val) noexcept {
+        // try_push只在成功时才会移动val, 因此可以重复转发.
+        while (!try_push(std::forward<U>(val))) {
+            const auto key = not_full_.prepareWait();
+            if (try_push(std::forward<U>(val))) {
+                not_full_.cancelWait();
+                return;
+            }
+            not_full_.wait(key);
+        }
+    }
+
+    bool try_pop(Value& res) noexcept {
+        size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells_[pos & mask_];
+            const size_t seq = cell->seq.load(std::memory_order_acquire);
+            const auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            else if (diff < 0) {
+                return false;
+            }
+            else {
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        T* slot = cell->ptr();
+        res = std::move_if_noexcept(*slot);
+        slot->~T();
+        cell->seq.store(pos + mask_ + 1, std::memory_order_release);
+        not_full_.notify();
+        return true;
+    }
+
+    Value wait_and_pop() noexcept {
+        Value res;
+        while (!try_pop(res)) {
+            const auto key = not_empty_.prepareWait();
+            if (try_pop(res)) {
+                not_empty_.cancelWait();
+                break;
+            }
+            not_empty_.wait(key);
+        }
+        return res;
+    }
+
+    // 以下查询在并发时只是近似值.
+    inline size_t size() const noexcept {
+        const size_t head = dequeue_pos_.load(std::memory_order_acquire);
+        const size_t tail = enqueue_pos_.load(std::memory_order_acquire);
+        return tail > head ? tail - head : 0;
+    }
+
+    inline bool full() const noexcept { return size() > mask_; }
+
+    inline bool empty() const noexcept { return size() == 0; }
+
+    inline size_t capacity() const noexcept { return mask_ + 1; }
+
+private:
+    struct alignas(kCacheLineSize) Cell {
+        std::atomic<size_t> seq;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+
+        T* ptr() noexcept { return reinterpret_cast<T*>(&storage); }
+    };
+
+    Cell* cells_;
+    size_t mask_;
+    char pad0_[kCacheLineSize];
+    std::atomic<size_t> enqueue_pos_;
+    char pad1_[kCacheLineSize];
+    std::atomic<size_t> dequeue_pos_;
+    char pad2_[kCacheLineSize];
+    EventCount not_empty_;
+    EventCount not_full_;
+};
+
+// 多播环形队列中的序号, 前后各填充一个缓存行, 避免与相邻的序号伪共享.
+class Sequence {
+public:
+    static constexpr int64_t kInitial = -1;
+
+    int64_t get() const noexcept { return value_.load(std::memory_order_acquire); }
+
+    void set(int64_t value) noexcept { value_.store(value, std::memory_order_release); }
+
+private:
+    char pad0_[kCacheLineSize];
+    std::atomic<int64_t> value_{kInitial};
+    char pad1_[kCacheLineSize];
+};
+
+// 忙等, 延迟最低, 每个等待者独占一个核.
+struct BusySpinWaitStrategy {
+    template <class Ready>
+    void waitUntil(const Ready& ready) noexcept {
+        while (!ready()) {
+        }
+    }
+
+    void notify() noexcept {}
+};
+
+// 先自旋一段时间, 然后让出CPU.
+struct YieldingWaitStrategy {
+    static constexpr int kSpinTries = 100;
+
+    template <class Ready>
+    void waitUntil(const Ready& ready) noexcept {
+        for (int spin = 0; !ready(); ++spin) {
+            if (spin >= kSpinTries) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    void notify() noexcept {}
+};
+
+// 经由EventCount阻塞, 没有等待者时notify只有一次内存屏障的开销.
+struct BlockingWaitStrategy {
+    template <class Ready>
+    void waitUntil(const Ready& ready) noexcept {
+        while (!ready()) {
+            const auto key = event_.prepareWait();
+            if (ready()) {
+                event_.cancelWait();
+                return;
+            }
+            event_.wait(key);
+        }
+    }
+
+    void notify() noexcept { event_.notify(); }
+
+private:
+    EventCount event_;
+};
+
+/**
+ * Disruptor风格的单生产者多播环形队列: 每个事件只写一次, 所有消费者按序号原地读取, 无拷贝无锁.
+ *
+ * 消费者可以依赖其他消费者(序号屏障), 只有上游处理完的事件才对下游可见, 由此组成流水线;
+ * 生产者只有在所有消费者都读过某个槽位后才复用它. 槽位在构造时默认构造, 之后一直复用, 不会析构.
+ * 所有消费者必须在生产开始之前通过addConsumer添加.
+ */
+template <typename T, typename WaitStrategy = BlockingWaitStrategy>
+class MulticastRing {
+public:
+    class Consumer {
+    public:
+        Consumer(const Consumer&) = delete;
+        Consumer& operator=(const Consumer&) = delete;
+
+        /**
+         * @brief 阻塞至有可读事件, 依次调用handler(T&, int64_t seq)处理所有可读事件.
+         * @return 处理的事件数, 队列已halt且所有事件都已处理时返回0.
+         */
+        template <class Handler>
+        size_t poll(Handler&& handler) {
+            const int64_t next = sequence_.get() + 1;
+            int64_t avail = available();
+            if (avail < next) {
+                ring_->wait_.waitUntil([&]() {
+                    avail = available();
+                    // halt之后仍需等待上游处理完已发布的事件.
+                    return avail >= next || (ring_->halted() && next > ring_->cursor_.get());
+                });
+                if (avail < next) {
+                    return 0;
+                }
+            }
+            return consume(next, avail, handler);
+        }
+
+        // 非阻塞版本, 没有可读事件时返回0.
+        template <class Handler>
+        size_t tryPoll(Handler&& handler) {
+            const int64_t next = sequence_.get() + 1;
+            const int64_t avail = available();
+            return avail < next ? 0 : consume(next, avail, handler);
+        }
+
+        // 已处理的最后一个序号.
+        int64_t sequence() const noexcept { return sequence_.get(); }
+
+    private:
+        friend class MulticastRing;
+
+        Consumer(MulticastRing* ring, std::vector<const Sequence*>&& deps)
+            : ring_(ring)
+            , deps_(std::move(deps)) {}
+
+        int64_t available() const noexcept {
+            int64_t avail = INT64_MAX;
+            for (const Sequence* dep : deps_) {
+                avail = std::min(avail, dep->get());
+            }
+            return avail;
+        }
+
+        template <class Handler>
+        size_t consume(int64_t next, int64_t avail, Handler& handler) {
+            for (int64_t seq = next; seq <= avail; ++seq) {
+                handler((*ring_)[seq], seq);
+            }
+            sequence_.set(avail);
+            ring_->wait_.notify();
+            return static_cast<size_t>(avail - next + 1);
+        }
+
+        MulticastRing* ring_;
+        // 为空时依赖生产者的cursor.
+        std::vector<const Sequence*> deps_;
+        Sequence sequence_;
+    };
+
+    explicit MulticastRing(size_t capacity)
+        : storage_(roundUp(capacity))
+        , mask_(storage_.capacity() - 1) {
+        for (size_t i = 0; i < storage_.capacity(); ++i) {
+            new (&storage_[i]) T();
+        }
+    }
+
+    ~MulticastRing() noexcept {
+        for (size_t i = 0; i < storage_.capacity(); ++i) {
+            storage_[i].~T();
+        }
+    }
+
+    MulticastRing(const MulticastRing&) = delete;
+    MulticastRing& operator=(const MulticastRing&) = delete;
+
+    /**
+     * @brief 添加消费者, 只能看到deps中所有消费者都已处理的事件; deps为空时直接依赖生产者.
+     */
+    Consumer& addConsumer(std::initializer_list<const Consumer*> deps = {}) {
+        std::vector<const Sequence*> sequences;
+        for (const Consumer* dep : deps) {
+            sequences.push_back(&dep->sequence_);
+        }
+        if (sequences.empty()) {
+            sequences.push_back(&cursor_);
+        }
+        consumers_.emplace_back(new Consumer(this, std::move(sequences)));
+        return *consumers_.back();
+    }
+
+    /**
+     * @brief 生产者申请n个连续槽位, 必要时等待最慢的消费者.
+     * @return 最后一个槽位的序号, 槽位为 [ret - n + 1, ret], 写完后调用publish(ret).
+     */
+    int64_t claim(size_t n = 1) noexcept {
+        assert(n > 0 && n <= storage_.capacity());
+        const int64_t hi = next_ + static_cast<int64_t>(n);
+        const int64_t wrap = hi - static_cast<int64_t>(storage_.capacity());
+        if (wrap > cached_gating_) {
+            wait_.waitUntil([&]() {
+                cached_gating_ = minGating();
+                return wrap <= cached_gating_;
+            });
+        }
+        next_ = hi;
+        return hi;
+    }
+
+    // 发布截至seq(含)的所有已申请槽位.
+    void publish(int64_t seq) noexcept {
+        cursor_.set(seq);
+        wait_.notify();
+    }
+
+    T& operator[](int64_t seq) noexcept { return storage_[static_cast<size_t>(seq) & mask_]; }
+
+    // 生产结束, 消费者处理完已发布的事件后poll返回0.
+    void halt() noexcept {
+        halted_.store(true, std::memory_order_release);
+        wait_.notify();
+    }
+
+    bool halted() const noexcept { return halted_.load(std::memory_order_acquire); }
+
+    int64_t cursor() const noexcept { return cursor_.get(); }
+
+    size_t capacity() const noexcept { return storage_.capacity(); }
+
+private:
+    static size_t roundUp(size_t capacity) {
+        if (capacity <= 0) {
+            throw std::invalid_argument("capacity must be non-negative");
+        }
+        size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    int64_t minGating() const noexcept {
+        int64_t gating = INT64_MAX;
+        for (const auto& consumer : consumers_) {
+            gating = std::min(gating, consumer->sequence_.get());
+        }
+        return gating;
+    }
+
+    RawStorage<T> storage_;
+    const size_t mask_;
+    std::vector<std::unique_ptr<Consumer>> consumers_;
+    WaitStrategy wait_;
+    // 以下两个只由生产者访问.
+    int64_t next_{Sequence::kInitial};
+    int64_t cached_gating_{Sequence::kInitial};
+    Sequence cursor_;
+    std::atomic<bool> halted_{false};
 };
 
 template <typename T>
@@ -128,31 +836,54 @@ public:
         std::lock_guard<std::mutex> lk(mutex_);
         if (buffer_.empty())
             return false;
-        res = std::move_if_noexcept(buffer_.back());
-        buffer_.pop_back();
+        res = std::move_if_noexcept(buffer_.front());
+        buffer_.pop_front();
         not_full_.notify_one();
         return true;
     }
 
-    // template <class Rep, class Period>
-    // std::vector<Value> wait_and_pop(const std::chrono::duration<Rep, Period>& timeout) noexcept {
-    //     std::unique_lock<std::mutex> lk(mutex_);
-    //     not_empty_.wait_for(lk, timeout, [this] { return !buffer_.empty(); });
-    //     Value res = std::move_if_noexcept(buffer_.back());
-    //     buffer_.pop_back();
-    //     not_full_.notify_one();
-    //     return res;
-    // }
+    template <class Rep, class Period>
+    bool wait_and_pop(Value& res, const std::chrono::duration<Rep, Period>& timeout) noexcept {
+        std::unique_lock<std::mutex> lk(mutex_);
+        if (!not_empty_.wait_for(lk, timeout, [this] { return !buffer_.empty(); }))
+            return false;
+        res = std::move_if_noexcept(buffer_.front());
+        buffer_.pop_front();
+        not_full_.notify_one();
+        return true;
+    }
 
     Value wait_and_pop() noexcept {
         std::unique_lock<std::mutex> lk(mutex_);
         not_empty_.wait(lk, [this] { return !buffer_.empty(); });
-        Value res = std::move_if_noexcept(buffer_.back());
-        buffer_.pop_back();
+        Value res = std::move_if_noexcept(buffer_.front());
+        buffer_.pop_front();
         not_full_.notify_one();
         return res;
     }
 
+    /**
+     * @brief 一次加锁取出最多max_n个元素(按FIFO顺序追加到out), 不等待.
+     * @return 取出的元素个数.
+     */
+    size_t pop_batch(std::vector<Value>& out, size_t max_n) noexcept {
+        std::lock_guard<std::mutex> lk(mutex_);
+        return drain_locked(out, max_n);
+    }
+
+    /**
+     * @brief 等待至多timeout直到队列非空, 然后一次取出最多max_n个元素.
+     * @return 取出的元素个数, 超时为0.
+     */
+    template <class Rep, class Period>
+    size_t wait_pop_batch_for(std::vector<Value>& out, size_t max_n,
+                              const std::chrono::duration<Rep, Period>& timeout) noexcept {
+        std::unique_lock<std::mutex> lk(mutex_);
+        if (!not_empty_.wait_for(lk, timeout, [this] { return !buffer_.empty(); }))
+            return 0;
+        return drain_locked(out, max_n);
+    }
+
     inline size_t size() const noexcept {
         std::lock_guard<std::mutex> lk(mutex_);
         return buffer_.size();
@@ -188,6 +919,22 @@ public:
     };
 
 private:
+    // 调用方需持有mutex_. 取出多个元素后只通知一次, 可能有多个生产者在等待空位.
+    size_t drain_locked(std::vector<Value>& out, size_t max_n) noexcept {
+        const size_t n = std::min(max_n, buffer_.size());
+        for (size_t i = 0; i < n; ++i) {
+            out.push_back(std::move_if_noexcept(buffer_.front()));
+            buffer_.pop_front();
+        }
+        if (n == 1) {
+            not_full_.notify_one();
+        }
+        else if (n > 1) {
+            not_full_.notify_all();
+        }
+        return n;
+    }
+
     mutable std::mutex mutex_;
     boost::circular_buffer<T> buffer_;
     std::condition_variable not_full_;
@@ -14,6 +14,65 @@ TEST(BUFFER, BoundedQueue) {
     EXPECT_TRUE(queue.full());
 }
 
+TEST(BUFFER, FifoOrder) {
+    ThreadSafeQueue<String> queue(4);
+    queue.wait_and_push("0");
+    queue.wait_and_push("1");
+    queue.wait_and_push("2");
+
+    String val;
+    EXPECT_TRUE(queue.try_pop(val));
+    EXPECT_EQ(val, "0"_str);
+    EXPECT_EQ(queue.wait_and_pop(), "1"_str);
+    EXPECT_TRUE(queue.wait_and_pop(val, std::chrono::milliseconds(1)));
+    EXPECT_EQ(val, "2"_str);
+    EXPECT_FALSE(queue.wait_and_pop(val, std::chrono::milliseconds(1)));
+}
+
+TEST(BUFFER, PopBatch) {
+    ThreadSafeQueue<int> queue(8);
+    for (int i = 0; i < 5; ++i) {
+        queue.wait_and_push(i);
+    }
+
+    std::vector<int> out;
+    EXPECT_EQ(queue.pop_batch(out, 3), 3);
+    EXPECT_EQ(out, (std::vector<int>{0, 1, 2}));
+    EXPECT_EQ(queue.pop_batch(out, 10), 2);
+    EXPECT_EQ(out, (std::vector<int>{0, 1, 2, 3, 4}));
+    EXPECT_EQ(queue.pop_batch(out, 10), 0);
+
+    out.clear();
+    EXPECT_EQ(queue.wait_pop_batch_for(out, 4, std::chrono::milliseconds(1)), 0);
+    std::thread producer([&queue]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        queue.wait_and_push(7);
+    });
+    EXPECT_EQ(queue.wait_pop_batch_for(out, 4, std::chrono::seconds(5)), 1);
+    EXPECT_EQ(out, (std::vector<int>{7}));
+    producer.join();
+}
+
+TEST(BUFFER, PopBatchWakesBlockedProducers) {
+    ThreadSafeQueue<int> queue(2);
+    queue.wait_and_push(0);
+    queue.wait_and_push(1);
+
+    std::vector<std::thread> producers;
+    for (int i = 2; i < 4; ++i) {
+        producers.emplace_back([&queue, i]() { queue.wait_and_push(i); });
+    }
+    std::vector<int> out;
+    while (out.size() < 4) {
+        queue.wait_pop_batch_for(out, 2, std::chrono::milliseconds(100));
+    }
+    for (auto& t : producers) {
+        t.join();
+    }
+    EXPECT_EQ(out[0], 0);
+    EXPECT_EQ(out[1], 1);
+}
+
 TEST(RingBuffer, Captity) {
     RingBuffer<String> buffer(2);
     EXPECT_TRUE(buffer.try_push("0"));
@@ -27,3 +86,243 @@ TEST(RingBuffer, Captity) {
     EXPECT_EQ(val, "1"_str);
     EXPECT_TRUE(!buffer.try_pop(val));
 }
+
+TEST(RingBuffer, ReserveCommitPeekRelease) {
+    RingBuffer<String> buffer(4);
+    EXPECT_TRUE(buffer.try_push("0"));
+    EXPECT_TRUE(buffer.try_push("1"));
+    String val;
+    EXPECT_TRUE(buffer.try_pop(val));
+
+    // tail在下标2, 预留3个槽位会跨越末尾.
+    auto spans = buffer.reserve(10);
+    ASSERT_EQ(spans.size(), 3);
+    EXPECT_EQ(spans.first.size, 2);
+    EXPECT_EQ(spans.second.size, 1);
+    new (&spans.first.data[0]) String("2");
+    new (&spans.first.data[1]) String("3");
+    new (&spans.second.data[0]) String("4");
+    buffer.commit(3);
+    EXPECT_TRUE(buffer.full());
+
+    auto readable = buffer.peek(3);
+    ASSERT_EQ(readable.size(), 3);
+    EXPECT_EQ(readable.first.data[0], "1"_str);
+    EXPECT_EQ(readable.first.data[1], "2"_str);
+    EXPECT_EQ(readable.first.data[2], "3"_str);
+    buffer.release(3);
+    EXPECT_EQ(buffer.size(), 1);
+    EXPECT_TRUE(buffer.try_pop(val));
+    EXPECT_EQ(val, "4"_str);
+    EXPECT_TRUE(buffer.empty());
+}
+
+TEST(RingBuffer, BulkCopy) {
+    RingBuffer<int> buffer(8);
+    std::vector<int> in(12);
+    for (int i = 0; i < 12; ++i) {
+        in[i] = i;
+    }
+    EXPECT_EQ(buffer.push_n(in.data(), 6), 6);
+
+    std::vector<int> out(12, -1);
+    EXPECT_EQ(buffer.pop_n(out.data(), 4), 4);
+    // 剩余2个, 最多再写6个, 且会绕回开头.
+    EXPECT_EQ(buffer.push_n(in.data() + 6, 6), 6);
+    EXPECT_TRUE(buffer.full());
+    EXPECT_EQ(buffer.push_n(in.data(), 1), 0);
+    EXPECT_EQ(buffer.pop_n(out.data() + 4, 100), 8);
+    EXPECT_EQ(out, in);
+    EXPECT_TRUE(buffer.empty());
+
+    // 空批量与被移走的缓冲区不访问存储, dst/src可以为空.
+    EXPECT_EQ(buffer.push_n(nullptr, 0), 0);
+    EXPECT_EQ(buffer.pop_n(nullptr, 0), 0);
+    RingBuffer<int> moved(std::move(buffer));
+    EXPECT_EQ(buffer.push_n(in.data(), 4), 0);
+    EXPECT_EQ(buffer.pop_n(out.data(), 4), 0);
+}
+
+TEST(SpscRingBuffer, Capacity) {
+    SpscRingBuffer<String> buffer(3);
+    EXPECT_EQ(buffer.capacity(), 4);
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_TRUE(buffer.try_push(std::to_string(i)));
+    }
+    EXPECT_TRUE(buffer.full());
+    EXPECT_FALSE(buffer.try_push("4"));
+
+    String val;
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_TRUE(buffer.try_pop(val));
+        EXPECT_EQ(val, std::to_string(i));
+    }
+    EXPECT_TRUE(buffer.empty());
+    EXPECT_FALSE(buffer.try_pop(val));
+
+    // 未被消费的元素由析构函数释放.
+    EXPECT_TRUE(buffer.try_push("left"));
+}
+
+TEST(SpscRingBuffer, ProducerConsumerStress) {
+    constexpr uint64_t kCount = 2000000;
+    SpscRingBuffer<uint64_t> buffer(1024);
+
+    std::thread producer([&buffer]() {
+        for (uint64_t i = 0; i < kCount; ++i) {
+            while (!buffer.try_push(i)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    uint64_t expected = 0;
+    uint64_t val;
+    while (expected < kCount) {
+        if (!buffer.try_pop(val)) {
+            std::this_thread::yield();
+            continue;
+        }
+        ASSERT_EQ(val, expected);
+        ++expected;
+    }
+    producer.join();
+    EXPECT_TRUE(buffer.empty());
+}
+
+TEST(MpmcQueue, BoundedQueue) {
+    MpmcQueue<String> queue(4);
+    queue.wait_and_push("0");
+    queue.wait_and_push("1");
+    queue.wait_and_push("2");
+    queue.wait_and_push("3");
+    EXPECT_TRUE(queue.full());
+    EXPECT_FALSE(queue.try_push("4"));
+
+    String val;
+    EXPECT_TRUE(queue.try_pop(val));
+    EXPECT_EQ(val, "0"_str);
+    EXPECT_EQ(queue.wait_and_pop(), "1"_str);
+    EXPECT_EQ(queue.size(), 2);
+}
+
+TEST(MpmcQueue, BlockingProducersConsumers) {
+    constexpr int kProducers = 4;
+    constexpr int kConsumers = 4;
+    constexpr uint64_t kPerProducer = 100000;
+    MpmcQueue<uint64_t> queue(64);
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < kProducers; ++p) {
+        threads.emplace_back([&queue]() {
+            for (uint64_t i = 1; i <= kPerProducer; ++i) {
+                queue.wait_and_push(i);
+            }
+        });
+    }
+    std::atomic<uint64_t> sum{0};
+    for (int c = 0; c < kConsumers; ++c) {
+        threads.emplace_back([&queue, &sum]() {
+            uint64_t local = 0;
+            for (uint64_t i = 0; i < kPerProducer * kProducers / kConsumers; ++i) {
+                local += queue.wait_and_pop();
+            }
+            sum += local;
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    EXPECT_EQ(sum.load(), kProducers * kPerProducer * (kPerProducer + 1) / 2);
+    EXPECT_TRUE(queue.empty());
+}
+
+namespace {
+
+struct Event {
+    uint64_t value;
+    uint64_t doubled;
+};
+
+// 生产者 -> parse -> enrich, 另有一个只依赖生产者的audit, 所有阶段读同一份事件.
+template <typename WaitStrategy>
+void runPipeline(uint64_t events) {
+    MulticastRing<Event, WaitStrategy> ring(64);
+    auto& parse = ring.addConsumer();
+    auto& audit = ring.addConsumer();
+    auto& enrich = ring.addConsumer({&parse});
+
+    uint64_t parse_sum = 0, audit_sum = 0, enrich_sum = 0;
+    bool in_order = true;
+    std::thread parse_thread([&]() {
+        while (parse.poll([&](Event& e, int64_t) {
+            e.doubled = e.value * 2;
+            parse_sum += e.value;
+        })) {
+        }
+    });
+    std::thread audit_thread([&]() {
+        int64_t expected = 0;
+        while (audit.poll([&](Event& e, int64_t seq) {
+            in_order = in_order && seq == expected++;
+            audit_sum += e.value;
+        })) {
+        }
+    });
+    std::thread enrich_thread([&]() {
+        while (enrich.poll([&](Event& e, int64_t) { enrich_sum += e.doubled; })) {
+        }
+    });
+
+    for (uint64_t i = 1; i <= events;) {
+        const size_t batch = static_cast<size_t>(std::min<uint64_t>(8, events - i + 1));
+        const int64_t hi = ring.claim(batch);
+        for (int64_t seq = hi - static_cast<int64_t>(batch) + 1; seq <= hi; ++seq) {
+            ring[seq].value = i++;
+        }
+        ring.publish(hi);
+    }
+    ring.halt();
+    parse_thread.join();
+    audit_thread.join();
+    enrich_thread.join();
+
+    const uint64_t expected = events * (events + 1) / 2;
+    EXPECT_TRUE(in_order);
+    EXPECT_EQ(parse_sum, expected);
+    EXPECT_EQ(audit_sum, expected);
+    EXPECT_EQ(enrich_sum, expected * 2);
+    EXPECT_EQ(enrich.sequence(), static_cast<int64_t>(events) - 1);
+}
+
+} // namespace
+
+TEST(MulticastRing, DependencyBarrier) {
+    MulticastRing<int, YieldingWaitStrategy> ring(4);
+    auto& first = ring.addConsumer();
+    auto& second = ring.addConsumer({&first});
+    EXPECT_EQ(ring.capacity(), 4);
+
+    const int64_t hi = ring.claim(2);
+    ring[hi - 1] = 1;
+    ring[hi] = 2;
+    ring.publish(hi);
+
+    int sum = 0;
+    auto add = [&sum](int& v, int64_t) { sum += v; };
+    // first处理之前second看不到任何事件.
+    EXPECT_EQ(second.tryPoll(add), 0);
+    EXPECT_EQ(first.tryPoll(add), 2);
+    EXPECT_EQ(second.tryPoll(add), 2);
+    EXPECT_EQ(sum, 6);
+
+    ring.halt();
+    EXPECT_EQ(first.poll(add), 0);
+    EXPECT_EQ(second.poll(add), 0);
+}
+
+TEST(MulticastRing, BlockingPipeline) { runPipeline<BlockingWaitStrategy>(200000); }
+
+TEST(MulticastRing, YieldingPipeline) { runPipeline<YieldingWaitStrategy>(200000); }
+
+TEST(MulticastRing, BusySpinPipeline) { runPipeline<BusySpinWaitStrategy>(2000); }
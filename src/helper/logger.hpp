@@ -14,6 +14,7 @@
 #include <spdlog/common.h>
 #include <spdlog/details/circular_q.h>
 #include <spdlog/details/file_helper.h>
+#include <spdlog/details/log_msg_buffer.h>
 #include <spdlog/details/null_mutex.h>
 #include <spdlog/details/os.h>
 #include <spdlog/details/synchronous_factory.h>
@@ -26,10 +27,19 @@
 #include <optional>
 #include <regex>
 
+#include "./buffer.hpp"
 #include "./os.hpp"
+#include "./tsc_clock.hpp"
+#include "future_wrapper/executor.hpp"
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <cstdio>
+#include <cstring>
 #include <ctime>
+#include <deque>
+#include <functional>
 #include <iomanip>
 #include <iostream>
 #include <map>
@@ -37,8 +47,17 @@
 #include <mutex>
 #include <set>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <zlib.h>
+
 #ifndef OS_SEP
 #ifdef __MSC_VER__
 #define OS_SEP '\\'
@@ -80,6 +99,28 @@
 #define LOG_CRITICAL(msg, ...) spdlog::log({FILENAME_, __LINE__, ""}, spdlog::level::critical, msg, ##__VA_ARGS__)
 #endif
 
+// 每个调用点独立限速/采样, 被抑制的条数在之后放行时或由后台定时汇总输出, e.g. LOG_RATE_LIMITED(spdlog::level::err, "{}", e);
+#define LOG_WITH_SITE_(level, admit, msg, ...)                                              \
+    do {                                                                                    \
+        if (spdlog::should_log(level)) {                                                    \
+            static ::helper::logger::LogSite log_site_;                                     \
+            if (log_site_.admit) {                                                          \
+                log_site_.reportSuppressed({FILENAME_, __LINE__, ""}, level);               \
+                spdlog::log({FILENAME_, __LINE__, ""}, level, msg, ##__VA_ARGS__);          \
+            }                                                                               \
+            else {                                                                          \
+                log_site_.suppress({FILENAME_, __LINE__, ""}, level);                       \
+            }                                                                               \
+        }                                                                                   \
+    } while (0)
+// 令牌桶, 速率与突发由RateLimitParam配置.
+#define LOG_RATE_LIMITED(level, msg, ...) \
+    LOG_WITH_SITE_(level, tryAcquire(::helper::logger::LogSite::now()), msg, ##__VA_ARGS__)
+// 每RateLimitParam::sampleEvery条输出一条.
+#define LOG_SAMPLED(level, msg, ...) LOG_WITH_SITE_(level, sample(0), msg, ##__VA_ARGS__)
+// 每n条输出一条.
+#define LOG_EVERY_N(level, n, msg, ...) LOG_WITH_SITE_(level, sample(n), msg, ##__VA_ARGS__)
+
 namespace helper {
 namespace logger {
 
@@ -93,12 +134,259 @@ enum class LogLevel : int8_t {
     TRACE = 5,
 };
 
+// 异步日志队列满时的处理方式.
+enum class AsyncOverflow : int8_t {
+    BLOCK = 0,          // 阻塞调用线程直到有空位
+    DROP = 1,           // 直接丢弃
+    DROP_AND_COUNT = 2, // 丢弃并计数, 由写线程输出一条汇总日志
+};
+
+struct AsyncLogParam {
+    bool enable{false};
+    size_t queueSize{8192};
+    AsyncOverflow overflow{AsyncOverflow::BLOCK};
+    // 写线程一次最多取出的日志条数.
+    size_t maxBatch{256};
+};
+
+// 限速/采样日志宏的参数, 对每个调用点单独生效.
+struct RateLimitParam {
+    // 每秒放行的条数, 0表示不限速.
+    uint32_t perSecond{10};
+    // 允许的突发条数.
+    uint32_t burst{20};
+    // LOG_SAMPLED每N条输出一条.
+    uint32_t sampleEvery{100};
+    // 同一调用点两次"suppressed"汇总之间的最小间隔.
+    uint32_t summaryIntervalMs{1000};
+};
+
 struct LoggerParam {
     LogLevel logLevel;
     std::string logDir;
     std::string logName;
     size_t maxFileSize;
     size_t maxRetentionDays;
+    AsyncLogParam asyncParam{};
+    // 日志文件使用mmap追加写入.
+    bool mmapFile{false};
+    // 轮转后的分段在后台压缩为.gz.
+    bool compressRotated{false};
+    RateLimitParam rateLimitParam{};
+};
+
+/**
+ * 一个日志调用点的限速状态, 由LOG_RATE_LIMITED等宏以函数内static变量的形式创建.
+ * 限速使用GCRA形式的令牌桶, 只有一个原子变量(理论到达时间). 被抑制时读一次该变量, 再对本线程的计数槽做一次
+ * relaxed自增; 计数槽按线程分散在不同缓存行上, 多个线程同时被抑制时不争用同一缓存行.
+ * 只有令牌桶在每次调用时读时钟, 采样只在放行且有待汇总的条数时读一次.
+ * 首次被抑制时调用点登记到后台汇总线程, 日志停止后剩余的被抑制条数也会在一个汇总间隔内输出.
+ */
+class LogSite {
+public:
+    LogSite() = default;
+
+    ~LogSite() {
+        if (registered_.load(std::memory_order_acquire)) {
+            auto& reg = registry_();
+            std::lock_guard<std::mutex> lock(reg.mutex);
+            reg.sites.erase(std::remove(reg.sites.begin(), reg.sites.end(), this), reg.sites.end());
+        }
+    }
+
+    LogSite(const LogSite&) = delete;
+    LogSite& operator=(const LogSite&) = delete;
+
+    static void configure(const RateLimitParam& param) noexcept {
+        interval_ns().store(param.perSecond == 0 ? 0 : 1000000000LL / param.perSecond, std::memory_order_relaxed);
+        burst().store(std::max<uint32_t>(param.burst, 1), std::memory_order_relaxed);
+        sample_every().store(std::max<uint32_t>(param.sampleEvery, 1), std::memory_order_relaxed);
+        summary_interval_ns().store(param.summaryIntervalMs * 1000000LL, std::memory_order_relaxed);
+    }
+
+    static int64_t now() noexcept { return ::helper::TscClock::nowNanos(); }
+
+    bool tryAcquire(int64_t now) noexcept {
+        const int64_t interval = interval_ns().load(std::memory_order_relaxed);
+        if (interval == 0) {
+            return true;
+        }
+        const int64_t tolerance = interval * burst().load(std::memory_order_relaxed);
+        int64_t tat = tat_.load(std::memory_order_relaxed);
+        while (true) {
+            if (tat - tolerance > now) {
+                return false;
+            }
+            if (tat_.compare_exchange_weak(tat, std::max(tat, now) + interval, std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+    }
+
+    // n为0时使用RateLimitParam::sampleEvery.
+    bool sample(uint32_t n) noexcept {
+        if (n == 0) {
+            n = sample_every().load(std::memory_order_relaxed);
+        }
+        return n <= 1 || count_.fetch_add(1, std::memory_order_relaxed) % n == 0;
+    }
+
+    // 记录一条被抑制的日志, loc/level用于后台输出汇总.
+    void suppress(const spdlog::source_loc& loc, spdlog::level::level_enum level) noexcept {
+        slots_[slot_index_()].value.fetch_add(1, std::memory_order_relaxed);
+        // 每个汇总间隔只写一次, 之后的被抑制调用只读共享的缓存行.
+        if (!pending_.load(std::memory_order_relaxed)) {
+            pending_.store(true, std::memory_order_relaxed);
+        }
+        if (!registered_.load(std::memory_order_relaxed)) {
+            register_(loc, level);
+        }
+    }
+
+    // 放行时调用: 有被抑制的日志且距上次汇总超过间隔时, 输出一条汇总. 没有被抑制的日志时不读时钟.
+    void reportSuppressed(const spdlog::source_loc& loc, spdlog::level::level_enum level) noexcept {
+        if (pending_.load(std::memory_order_relaxed)) {
+            summarize_(now(), loc, level);
+        }
+    }
+
+    uint64_t suppressed() const noexcept {
+        uint64_t total = 0;
+        for (const auto& slot : slots_) {
+            total += slot.value.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+private:
+    static constexpr size_t kSlots = 8;
+
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> value{0};
+    };
+
+    // 登记过的调用点. 不析构, 进程退出时静态LogSite的析构仍可以安全地注销自己.
+    struct Registry {
+        std::mutex mutex;
+        std::vector<LogSite*> sites;
+    };
+
+    // 后台汇总线程, 每个汇总间隔检查一次所有登记的调用点.
+    class Reporter {
+    public:
+        Reporter() : thread_(&Reporter::loop_, this) {}
+
+        ~Reporter() {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stop_ = true;
+            }
+            cv_.notify_one();
+            thread_.join();
+        }
+
+    private:
+        void loop_() {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (true) {
+                const int64_t period = std::max<int64_t>(summary_interval_ns().load(std::memory_order_relaxed), 10000000);
+                if (cv_.wait_for(lock, std::chrono::nanoseconds(period), [this]() { return stop_; })) {
+                    return;
+                }
+                auto& reg = registry_();
+                std::lock_guard<std::mutex> sites_lock(reg.mutex);
+                const int64_t now = LogSite::now();
+                for (LogSite* site : reg.sites) {
+                    // 不只看pending_: 与summarize_并发的suppress可能在pending_清除之前计数.
+                    if (site->pending_.load(std::memory_order_relaxed) || site->suppressed() != 0) {
+                        site->summarize_(now, site->loc_, site->level_);
+                    }
+                }
+            }
+        }
+
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        bool stop_{false};
+        std::thread thread_;
+    };
+
+    static std::atomic<int64_t>& interval_ns() noexcept {
+        static std::atomic<int64_t> value{1000000000LL / RateLimitParam{}.perSecond};
+        return value;
+    }
+
+    static std::atomic<uint32_t>& burst() noexcept {
+        static std::atomic<uint32_t> value{RateLimitParam{}.burst};
+        return value;
+    }
+
+    static std::atomic<uint32_t>& sample_every() noexcept {
+        static std::atomic<uint32_t> value{RateLimitParam{}.sampleEvery};
+        return value;
+    }
+
+    static std::atomic<int64_t>& summary_interval_ns() noexcept {
+        static std::atomic<int64_t> value{RateLimitParam{}.summaryIntervalMs * 1000000LL};
+        return value;
+    }
+
+    static Registry& registry_() noexcept {
+        static auto* registry = new Registry();
+        return *registry;
+    }
+
+    static size_t slot_index_() noexcept {
+        static std::atomic<uint32_t> next{0};
+        static thread_local const size_t index = next.fetch_add(1, std::memory_order_relaxed) % kSlots;
+        return index;
+    }
+
+    // 先以last_summary_限定每个间隔只有一个线程进入, 再取走各计数槽.
+    void summarize_(int64_t now, const spdlog::source_loc& loc, spdlog::level::level_enum level) noexcept {
+        int64_t last = last_summary_.load(std::memory_order_relaxed);
+        if (now - last < summary_interval_ns().load(std::memory_order_relaxed) ||
+            !last_summary_.compare_exchange_strong(last, now, std::memory_order_relaxed)) {
+            return;
+        }
+        pending_.store(false, std::memory_order_relaxed);
+        uint64_t suppressed = 0;
+        for (auto& slot : slots_) {
+            suppressed += slot.value.exchange(0, std::memory_order_relaxed);
+        }
+        if (suppressed > 0) {
+            spdlog::default_logger()->log(loc, level, "suppressed {} messages", suppressed);
+        }
+    }
+
+    void register_(const spdlog::source_loc& loc, spdlog::level::level_enum level) noexcept {
+        if (registered_.exchange(true, std::memory_order_acq_rel)) {
+            return;
+        }
+        try {
+            auto& reg = registry_();
+            {
+                std::lock_guard<std::mutex> lock(reg.mutex);
+                loc_ = loc;
+                level_ = level;
+                reg.sites.push_back(this);
+            }
+            static Reporter reporter;
+        }
+        catch (...) {
+            // 无法登记或启动汇总线程时, 汇总只在之后放行日志时输出.
+        }
+    }
+
+    std::atomic<int64_t> tat_{0};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<int64_t> last_summary_{0};
+    // 上次汇总之后有被抑制的日志.
+    std::atomic<bool> pending_{false};
+    std::atomic<bool> registered_{false};
+    spdlog::source_loc loc_{};
+    spdlog::level::level_enum level_{spdlog::level::off};
+    Slot slots_[kSlots];
 };
 
 namespace detail {
@@ -145,30 +433,304 @@ inline void removeInvalidLogDir(const std::string& base_log_dir_path,
     }
 }
 
+/**
+ * @brief 把src压缩为dst(gzip), 先写临时文件再rename, 成功后删除src.
+ * @param bytes_per_sec 读取速率上限, 0表示不限制.
+ */
+inline bool gzipFile(const std::string& src, const std::string& dst, size_t bytes_per_sec) noexcept {
+    const int in = ::open(src.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+        return false;
+    }
+    struct stat src_stat {};
+    ::fstat(in, &src_stat);
+
+    const std::string tmp = dst + ".tmp";
+    gzFile out = gzopen(tmp.c_str(), "wb6");
+    if (out == nullptr) {
+        ::close(in);
+        return false;
+    }
+    std::vector<char> buf(64 << 10);
+    const auto start = std::chrono::steady_clock::now();
+    size_t total = 0;
+    bool ok = true;
+    while (true) {
+        const ssize_t n = ::read(in, buf.data(), buf.size());
+        if (n < 0) {
+            ok = false;
+            break;
+        }
+        if (n == 0) {
+            break;
+        }
+        if (gzwrite(out, buf.data(), static_cast<unsigned>(n)) != n) {
+            ok = false;
+            break;
+        }
+        total += static_cast<size_t>(n);
+        if (bytes_per_sec > 0) {
+            // 按速率限制推迟下一块, 限制后台压缩占用的CPU.
+            const auto due = start + std::chrono::microseconds(total * 1000000 / bytes_per_sec);
+            std::this_thread::sleep_until(due);
+        }
+    }
+    ::close(in);
+    ok = gzclose(out) == Z_OK && ok;
+    if (!ok || ::rename(tmp.c_str(), dst.c_str()) != 0) {
+        ::unlink(tmp.c_str());
+        return false;
+    }
+    // 压缩期间src可能已被新的轮转替换, 只删除被压缩的那个文件.
+    struct stat now_stat {};
+    if (::stat(src.c_str(), &now_stat) == 0 && now_stat.st_ino == src_stat.st_ino && now_stat.st_dev == src_stat.st_dev) {
+        ::unlink(src.c_str());
+    }
+    return true;
+}
+
 } // namespace detail
 
+/**
+ * 日志文件的后台维护线程: 已关闭分段的压缩, 过期日志的删除.
+ * 任务按提交顺序在单线程ThreadExecutor上执行, 该线程降低了优先级, 提交不会阻塞日志调用线程.
+ * 析构(进程退出)时仍会执行完队列中的删除任务, 但跳过还没开始的压缩任务: 压缩按速率限制, 可能让退出等待很久.
+ */
+class LogMaintenance {
+public:
+    static LogMaintenance& instance() {
+        static LogMaintenance maintenance;
+        return maintenance;
+    }
+
+    /**
+     * @param skip_on_shutdown 析构开始时还未执行的任务直接跳过.
+     */
+    void submit(std::function<void()>&& task, bool skip_on_shutdown = false) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++pending_;
+        }
+        executor_.submit([this, task = std::move(task), skip_on_shutdown]() {
+            try {
+                if (!skip_on_shutdown || !stopping_.load(std::memory_order_acquire)) {
+                    task();
+                }
+            }
+            catch (const std::exception& ex) {
+                fprintf(stderr, "%s:%d log maintenance failed: %s\n", FILENAME_, __LINE__, ex.what());
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--pending_ == 0) {
+                idle_cv_.notify_all();
+            }
+        });
+    }
+
+    // 等待已提交的任务全部执行完.
+    void drain() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        idle_cv_.wait(lock, [this]() { return pending_ == 0; });
+    }
+
+    // 压缩时的读取速率上限(字节/秒), 0表示不限制.
+    void setCompressRate(size_t bytes_per_sec) noexcept { compress_rate_.store(bytes_per_sec); }
+
+    size_t compressRate() const noexcept { return compress_rate_.load(); }
+
+private:
+    LogMaintenance()
+        : executor_(1) {
+        // 只降低worker线程的优先级.
+        executor_.submit([]() { ::setpriority(PRIO_PROCESS, static_cast<id_t>(::syscall(SYS_gettid)), 10); });
+    }
+
+    // 在executor_析构(执行剩余任务)之前标记.
+    ~LogMaintenance() { stopping_.store(true, std::memory_order_release); }
+
+    std::mutex mutex_;
+    std::condition_variable idle_cv_;
+    size_t pending_{0};
+    std::atomic<size_t> compress_rate_{32 << 20};
+    std::atomic<bool> stopping_{false};
+    // 最后声明, 最先析构: 析构时执行完队列中剩余的任务, 任务仍可访问上面的成员.
+    ThreadExecutor executor_;
+};
+
 } // namespace logger
 } // namespace helper
 
 namespace spdlog {
+namespace details {
+
+/**
+ * 与file_helper接口相同的mmap追加写入: 文件按chunk用fallocate预先扩展, 日志直接拷贝进映射,
+ * 写入本身不产生系统调用. close时截断到实际大小.
+ *
+ * 进程崩溃时文件末尾会残留预分配的0字节, 重新open时会跳过它们继续追加.
+ */
+class mmap_file_helper {
+public:
+    static constexpr size_t kDefaultChunkSize = 4 << 20;
+    // flush只在累计这么多未同步的字节后才调用msync.
+    static constexpr size_t kSyncBytes = 1 << 20;
+
+    explicit mmap_file_helper(size_t chunk_size = kDefaultChunkSize)
+        : page_size_(static_cast<size_t>(::sysconf(_SC_PAGESIZE)))
+        , chunk_size_((std::max(chunk_size, page_size_) + page_size_ - 1) / page_size_ * page_size_) {}
+
+    mmap_file_helper(const mmap_file_helper&) = delete;
+    mmap_file_helper& operator=(const mmap_file_helper&) = delete;
+
+    ~mmap_file_helper() { close(); }
+
+    void open(const filename_t& fname, bool truncate = false) {
+        close();
+        filename_ = fname;
+        os::create_dir(os::dir_name(fname));
+        fd_ = ::open(fname.c_str(), O_RDWR | O_CREAT | O_CLOEXEC | (truncate ? O_TRUNC : 0), 0644);
+        if (fd_ < 0) {
+            throw_spdlog_ex("Failed opening file " + os::filename_to_str(fname) + " for writing", errno);
+        }
+        size_ = logical_size_();
+        synced_ = size_;
+        map_window_(0);
+    }
+
+    void flush() {
+        if (map_ != nullptr && size_ - synced_ >= kSyncBytes) {
+            sync_();
+        }
+    }
+
+    void close() {
+        if (fd_ < 0) {
+            return;
+        }
+        unmap_();
+        if (::ftruncate(fd_, static_cast<off_t>(size_)) != 0) {
+            fprintf(stderr, "%s:%d truncate %s failed: %d\n", FILENAME_, __LINE__, filename_.c_str(), errno);
+        }
+        ::close(fd_);
+        fd_ = -1;
+    }
+
+    void write(const memory_buf_t& buf) {
+        const size_t n = buf.size();
+        if (size_ + n > map_offset_ + map_size_) {
+            map_window_(n);
+        }
+        std::memcpy(map_ + (size_ - map_offset_), buf.data(), n);
+        size_ += n;
+    }
+
+    size_t size() const { return size_; }
+
+    const filename_t& filename() const { return filename_; }
+
+private:
+    // 文件末尾可能是上次崩溃残留的预分配0字节, 向前找到最后一个非0字节.
+    size_t logical_size_() {
+        struct stat st {};
+        if (::fstat(fd_, &st) != 0) {
+            throw_spdlog_ex("Failed stat file " + os::filename_to_str(filename_), errno);
+        }
+        size_t end = static_cast<size_t>(st.st_size);
+        char block[4096];
+        while (end > 0) {
+            const size_t len = std::min(end, sizeof(block));
+            if (::pread(fd_, block, len, static_cast<off_t>(end - len)) != static_cast<ssize_t>(len)) {
+                throw_spdlog_ex("Failed reading file " + os::filename_to_str(filename_), errno);
+            }
+            size_t i = len;
+            while (i > 0 && block[i - 1] == '\0') {
+                --i;
+            }
+            if (i > 0) {
+                return end - len + i;
+            }
+            end -= len;
+        }
+        return 0;
+    }
+
+    // 重新映射从当前大小所在页开始的窗口, 至少容纳need字节.
+    void map_window_(size_t need) {
+        unmap_();
+        map_offset_ = size_ / page_size_ * page_size_;
+        const size_t min_size = size_ - map_offset_ + need;
+        map_size_ = std::max(chunk_size_, (min_size + page_size_ - 1) / page_size_ * page_size_);
+
+        const int err = ::posix_fallocate(fd_, static_cast<off_t>(map_offset_), static_cast<off_t>(map_size_));
+        if (err != 0) {
+            throw_spdlog_ex("Failed allocating file " + os::filename_to_str(filename_), err);
+        }
+        void* addr = ::mmap(nullptr, map_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, static_cast<off_t>(map_offset_));
+        if (addr == MAP_FAILED) {
+            throw_spdlog_ex("Failed mapping file " + os::filename_to_str(filename_), errno);
+        }
+        map_ = static_cast<char*>(addr);
+        ::madvise(map_, map_size_, MADV_SEQUENTIAL);
+    }
+
+    void sync_() {
+        const size_t begin = synced_ / page_size_ * page_size_;
+        if (begin >= map_offset_) {
+            ::msync(map_ + (begin - map_offset_), size_ - begin, MS_ASYNC);
+        }
+        synced_ = size_;
+    }
+
+    void unmap_() {
+        if (map_ == nullptr) {
+            return;
+        }
+        sync_();
+        // 已写完的窗口不会再访问, 尽早释放页表.
+        ::madvise(map_, map_size_, MADV_DONTNEED);
+        ::munmap(map_, map_size_);
+        map_ = nullptr;
+    }
+
+    const size_t page_size_;
+    const size_t chunk_size_;
+    filename_t filename_;
+    int fd_{-1};
+    char* map_{nullptr};
+    size_t map_offset_{0};
+    size_t map_size_{0};
+    // 逻辑大小, 即已写入的字节数.
+    size_t size_{0};
+    size_t synced_{0};
+};
+
+} // namespace details
+
 namespace sinks {
 
-template <typename Mutex>
+template <typename Mutex, typename FileHelper = details::file_helper>
 class easy_file_sink final : public base_sink<Mutex> {
 public:
-    easy_file_sink(filename_t base_log_dir, filename_t log_basename, size_t max_file_bytes, size_t max_retention_days)
+    /**
+     * @param compress_rotated 已关闭的分段在后台压缩为.gz.
+     */
+    easy_file_sink(filename_t base_log_dir, filename_t log_basename, size_t max_file_bytes, size_t max_retention_days,
+                   bool compress_rotated = false)
         : base_log_dir_(std::move(base_log_dir))
         , log_basename_(std::move(log_basename))
         , max_file_bytes_(max_file_bytes)
-        , max_retention_days_(max_retention_days) {
+        , max_retention_days_(max_retention_days)
+        , compress_rotated_(compress_rotated) {
         auto now = log_clock::now();
         auto filename = gen_filename_by_daily(base_log_dir_, log_basename_, now_tm(now));
 
         // remove before logs.
         if (max_retention_days_ > 0) {
             // using namespace std::chrono_literals;
-            ::helper::logger::detail::removeInvalidLogDir(base_log_dir_,
-                                                          now - max_retention_days * std::chrono::hours(24));
+            const auto boundary = now - max_retention_days * std::chrono::hours(24);
+            maintenance().submit([base_log_dir = base_log_dir_, boundary]() {
+                ::helper::logger::detail::removeInvalidLogDir(base_log_dir, boundary);
+            });
         }
 
         file_helper_.open(filename, false);
@@ -186,15 +748,55 @@ public:
         return file_helper_.filename();
     }
 
+    /**
+     * @brief 一次加锁写入一批日志, 格式化结果合并后写入, 轮转时先把已合并的部分写入旧文件.
+     * 轮转行为与逐条写入完全一致.
+     */
+    void sink_batch(const details::log_msg_buffer* msgs, size_t n) {
+        std::lock_guard<Mutex> lock(base_sink<Mutex>::mutex_);
+        batch_buf_.clear();
+        memory_buf_t formatted;
+        for (size_t i = 0; i < n; ++i) {
+            formatted.clear();
+            base_sink<Mutex>::formatter_->format(msgs[i], formatted);
+            if (should_rotate_(msgs[i].time, formatted.size())) {
+                if (batch_buf_.size() > 0) {
+                    file_helper_.write(batch_buf_);
+                    batch_buf_.clear();
+                }
+                rotate_(msgs[i].time);
+            }
+            batch_buf_.append(formatted.data(), formatted.data() + formatted.size());
+        }
+        if (batch_buf_.size() > 0) {
+            file_helper_.write(batch_buf_);
+        }
+    }
+
 protected:
     void sink_it_(const details::log_msg& msg) override {
         memory_buf_t formatted;
         base_sink<Mutex>::formatter_->format(msg, formatted);
-        current_size_ += formatted.size();
+        if (should_rotate_(msg.time, formatted.size())) {
+            rotate_(msg.time);
+        }
+        file_helper_.write(formatted);
+    }
 
-        auto time = msg.time;
+    void flush_() override { file_helper_.flush(); }
+
+private:
+    // 累加本条日志的大小, 判断写入之前是否需要轮转.
+    bool should_rotate_(log_clock::time_point time, size_t msg_size) {
+        current_size_ += msg_size;
+        return time >= rotation_tp_ || current_size_ >= max_file_bytes_;
+    }
+
+    void rotate_(log_clock::time_point time) {
         if (time >= rotation_tp_) {
+            const auto closed_name = file_helper_.filename();
             file_helper_.close();
+            compress_(closed_name);
             auto filename = gen_filename_by_daily(base_log_dir_, log_basename_, now_tm(time));
             file_helper_.open(filename, false);
             current_size_ = file_helper_.size();
@@ -211,36 +813,45 @@ protected:
                 delete_old_();
         }
         else if (current_size_ >= max_file_bytes_) {
+            const auto closed_name = file_helper_.filename();
             file_helper_.close();
-            auto src_name = gen_filename_by_daily(base_log_dir_, log_basename_, now_tm(time));
+            const auto daily_name = gen_filename_by_daily(base_log_dir_, log_basename_, now_tm(time));
+            auto src_name = daily_name;
             auto target_name = gen_filename_by_filesize(base_log_dir_, log_basename_, now_tm(time),
                                                         files_path_list_[files_path_list_.size() - 1].size());
 
             // rename file if failed then us `target_name` as src_name.
-            if (!rename_file_(src_name, target_name)) {
-                details::os::sleep_for_millis(200);
-                if (!rename_file_(src_name, target_name)) {
-                    fprintf(stderr, "%s:%d rename %s to %s failed\n", FILENAME_, __LINE__, src_name.c_str(),
-                            target_name.c_str());
+            // 不等待重试: 旧分段留在daily文件名下(已记录在files_path_list_中), 下次轮转时在sink锁内
+            // 再次rename它, 不会有其他任务在此期间改动daily文件名.
+            bool keep_daily = false;
+            if (rename_file_(src_name, target_name)) {
+                compress_(target_name);
+            }
+            else {
+                fprintf(stderr, "%s:%d rename %s to %s failed\n", FILENAME_, __LINE__, src_name.c_str(),
+                        target_name.c_str());
+                // 分段名仍被占用(例如是非空目录)时不能写入, 也不归本sink管理: 继续追加到daily文件,
+                // 再写满max_file_bytes后重试, 避免每条日志都重试一次.
+                keep_daily = details::os::path_exists(target_name);
+                if (!keep_daily) {
                     src_name = target_name;
                 }
             }
+            // 上次rename失败后写入的是分段文件, 关闭后即可压缩.
+            if (closed_name != daily_name && closed_name != src_name) {
+                compress_(closed_name);
+            }
 
             files_path_list_[files_path_list_.size() - 1].emplace(src_name);
-            if (src_name != target_name)
+            if (!keep_daily && src_name != target_name)
                 files_path_list_[files_path_list_.size() - 1].emplace(target_name);
 
             file_helper_.open(src_name, false);
-            current_size_ = file_helper_.size();
+            current_size_ = keep_daily ? 0 : file_helper_.size();
             rotation_tp_ = next_rotation_tp_();
         }
-
-        file_helper_.write(formatted);
     }
 
-    void flush_() override { file_helper_.flush(); }
-
-private:
     tm now_tm(log_clock::time_point tp) {
         time_t t_now = log_clock::to_time_t(tp);
         return spdlog::details::os::localtime(t_now);
@@ -252,7 +863,7 @@ private:
      * @return log_clock::time_point
      */
     log_clock::time_point next_rotation_tp_() {
-        auto now = log_clock::now();
+        auto now = ::helper::TscClock::systemNow();
         tm date = now_tm(now);
         date.tm_hour = 0;
         date.tm_min = 0;
@@ -265,19 +876,42 @@ private:
 
     // Delete the file N rotations ago.
     // Throw spdlog_ex on failure to delete the old file.
+    // 删除在后台进行, 压缩过的分段一并删除.
     void delete_old_() {
+        std::vector<filename_t> expired;
         for (auto iter = files_path_list_.begin(); iter != files_path_list_.end();) {
             if (files_path_list_.size() <= max_retention_days_)
                 break;
 
-            for (const auto& it : *iter) {
+            expired.insert(expired.end(), iter->begin(), iter->end());
+            files_path_list_.erase(iter);
+        }
+        maintenance().submit([expired]() {
+            for (const auto& it : expired) {
+                details::os::remove_if_exists(it + ".gz");
                 bool ok = details::os::remove_if_exists(it) == 0;
                 if (!ok)
                     std::cerr << "Failed removing daily file " << details::os::filename_to_str(it) << " " << errno
                               << std::endl;
             }
-            files_path_list_.erase(iter);
+        });
+    }
+
+    static ::helper::logger::LogMaintenance& maintenance() { return ::helper::logger::LogMaintenance::instance(); }
+
+    void compress_(const filename_t& closed_name) {
+        if (!compress_rotated_) {
+            return;
         }
+        // 进程退出时未开始的压缩被跳过, 分段保持未压缩, 仍由delete_old_按原名删除.
+        maintenance().submit(
+          [closed_name]() {
+              if (!::helper::logger::detail::gzipFile(closed_name, closed_name + ".gz",
+                                                      maintenance().compressRate())) {
+                  fprintf(stderr, "%s:%d compress %s failed\n", FILENAME_, __LINE__, closed_name.c_str());
+              }
+          },
+          true);
     }
 
     /*  */
@@ -312,13 +946,184 @@ private:
 
     filename_t base_log_dir_, log_basename_;
     log_clock::time_point rotation_tp_;
-    details::file_helper file_helper_;
+    FileHelper file_helper_;
     std::size_t max_file_bytes_, max_retention_days_, current_size_;
+    const bool compress_rotated_;
     std::vector<std::set<filename_t>> files_path_list_;
+    // sink_batch复用的合并缓冲区.
+    memory_buf_t batch_buf_;
 };
 
 using easy_file_sink_mt = easy_file_sink<std::mutex>;
 using easy_file_sink_st = easy_file_sink<details::null_mutex>;
+using easy_mmap_file_sink_mt = easy_file_sink<std::mutex, details::mmap_file_helper>;
+using easy_mmap_file_sink_st = easy_file_sink<details::null_mutex, details::mmap_file_helper>;
+
+/**
+ * 异步前端: 调用线程只把日志拷贝进预分配的有界无锁队列, 由一个写线程批量取出,
+ * 格式化并写入下游sinks. 对easy_file_sink_mt/easy_mmap_file_sink_mt一批日志合并为一次写入, 其余sink逐条写入.
+ * 写线程在队列取空时flush下游, 析构时写完队列中剩余的日志.
+ */
+class async_sink final : public sink {
+    using Overflow = ::helper::logger::AsyncOverflow;
+
+    struct async_msg {
+        bool terminate{false};
+        details::log_msg_buffer msg;
+
+        async_msg() = default;
+
+        explicit async_msg(const details::log_msg& m)
+            : msg(m) {}
+    };
+
+public:
+    async_sink(std::vector<sink_ptr> sinks, size_t queue_size, Overflow overflow, size_t max_batch)
+        : sinks_(std::move(sinks))
+        , overflow_(overflow)
+        , queue_(queue_size)
+        , batch_(std::max<size_t>(max_batch, 1)) {
+        for (auto& s : sinks_) {
+            file_sinks_.push_back(batch_writer_(s));
+        }
+        worker_ = std::thread(&async_sink::worker_loop, this);
+    }
+
+    ~async_sink() override {
+        async_msg stop;
+        stop.terminate = true;
+        queue_.wait_and_push(std::move(stop));
+        worker_.join();
+    }
+
+    void log(const details::log_msg& msg) override {
+        if (overflow_ == Overflow::BLOCK) {
+            queue_.wait_and_push(msg);
+        }
+        else if (!queue_.try_push(msg) && overflow_ == Overflow::DROP_AND_COUNT) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            unreported_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // 写线程在每次取空队列后flush下游, 调用线程不需要等待.
+    void flush() override {}
+
+    void set_pattern(const std::string& pattern) override {
+        for (auto& s : sinks_) {
+            s->set_pattern(pattern);
+        }
+    }
+
+    void set_formatter(std::unique_ptr<spdlog::formatter> sink_formatter) override {
+        for (auto& s : sinks_) {
+            s->set_formatter(sink_formatter->clone());
+        }
+    }
+
+    // DROP_AND_COUNT策略下累计丢弃的条数.
+    uint64_t dropped() const noexcept { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    void worker_loop() {
+        bool terminate = false;
+        while (!terminate) {
+            size_t n = 0;
+            async_msg msg;
+            if (!queue_.try_pop(msg)) {
+                report_dropped_(logger_name_);
+                flush_sinks_();
+                msg = queue_.wait_and_pop();
+            }
+            do {
+                if (msg.terminate) {
+                    terminate = true;
+                    break;
+                }
+                batch_[n++] = std::move(msg.msg);
+            } while (n < batch_.size() && queue_.try_pop(msg));
+
+            deliver_(batch_.data(), n);
+            if (n > 0) {
+                logger_name_.assign(batch_[n - 1].logger_name.data(), batch_[n - 1].logger_name.size());
+            }
+            report_dropped_(logger_name_);
+        }
+        flush_sinks_();
+    }
+
+    // 丢弃计数在每批之后以及队列取空时以一条warn日志输出.
+    void report_dropped_(const std::string& logger_name) {
+        if (unreported_.load(std::memory_order_relaxed) == 0) {
+            return;
+        }
+        const auto count = unreported_.exchange(0, std::memory_order_relaxed);
+        const auto text = fmt::format("async logger dropped {} messages", count);
+        details::log_msg_buffer msg(details::log_msg(logger_name, level::warn, text));
+        deliver_(&msg, 1);
+    }
+
+    void deliver_(const details::log_msg_buffer* msgs, size_t n) {
+        if (n == 0) {
+            return;
+        }
+        for (size_t i = 0; i < sinks_.size(); ++i) {
+            try {
+                if (file_sinks_[i]) {
+                    file_sinks_[i](msgs, n);
+                    continue;
+                }
+                for (size_t j = 0; j < n; ++j) {
+                    if (sinks_[i]->should_log(msgs[j].level)) {
+                        sinks_[i]->log(msgs[j]);
+                    }
+                }
+            }
+            catch (const std::exception& ex) {
+                fprintf(stderr, "%s:%d async log failed: %s\n", FILENAME_, __LINE__, ex.what());
+            }
+        }
+    }
+
+    void flush_sinks_() {
+        for (auto& s : sinks_) {
+            try {
+                s->flush();
+            }
+            catch (const std::exception& ex) {
+                fprintf(stderr, "%s:%d async flush failed: %s\n", FILENAME_, __LINE__, ex.what());
+            }
+        }
+    }
+
+    using batch_writer = std::function<void(const details::log_msg_buffer*, size_t)>;
+
+    template <typename FileSink>
+    static batch_writer batch_writer_of_(const sink_ptr& s) {
+        if (auto file_sink = std::dynamic_pointer_cast<FileSink>(s)) {
+            return [file_sink](const details::log_msg_buffer* msgs, size_t n) { file_sink->sink_batch(msgs, n); };
+        }
+        return nullptr;
+    }
+
+    static batch_writer batch_writer_(const sink_ptr& s) {
+        auto writer = batch_writer_of_<easy_file_sink_mt>(s);
+        return writer ? writer : batch_writer_of_<easy_mmap_file_sink_mt>(s);
+    }
+
+    std::vector<sink_ptr> sinks_;
+    // 与sinks_一一对应, 不是easy_file_sink时为空.
+    std::vector<batch_writer> file_sinks_;
+    const Overflow overflow_;
+    MpmcQueue<async_msg> queue_;
+    // 只由写线程使用, 元素的缓冲区跨批次复用.
+    std::vector<details::log_msg_buffer> batch_;
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<uint64_t> unreported_{0};
+    // 最近一条日志的logger名, 用于丢弃汇总.
+    std::string logger_name_;
+    std::thread worker_;
+};
 
 } // namespace sinks
 } // namespace spdlog
@@ -360,7 +1165,9 @@ public:
 
     static std::shared_ptr<spdlog::logger> gen_logger(const spdlog::level::level_enum& level,
                                                       const std::string& logger_name, const std::string& base_log_dir,
-                                                      size_t max_file_bytes, size_t max_retention_days) {
+                                                      size_t max_file_bytes, size_t max_retention_days,
+                                                      const AsyncLogParam& async_param = {}, bool mmap_file = false,
+                                                      bool compress_rotated = false) {
         std::vector<spdlog::sink_ptr> sinks;
         sinks.reserve(2);
 
@@ -372,8 +1179,20 @@ public:
         }
 
         if (max_file_bytes > 0 && max_retention_days > 0) {
-            sinks.push_back(std::make_shared<spdlog::sinks::easy_file_sink_mt>(base_log_dir, logger_name,
-                                                                               max_file_bytes, max_retention_days));
+            if (mmap_file) {
+                sinks.push_back(std::make_shared<spdlog::sinks::easy_mmap_file_sink_mt>(
+                  base_log_dir, logger_name, max_file_bytes, max_retention_days, compress_rotated));
+            }
+            else {
+                sinks.push_back(std::make_shared<spdlog::sinks::easy_file_sink_mt>(
+                  base_log_dir, logger_name, max_file_bytes, max_retention_days, compress_rotated));
+            }
+        }
+
+        if (async_param.enable) {
+            spdlog::sink_ptr front = std::make_shared<spdlog::sinks::async_sink>(
+              std::move(sinks), async_param.queueSize, async_param.overflow, async_param.maxBatch);
+            sinks = {front};
         }
 
         // set default logger format.
@@ -390,9 +1209,13 @@ public:
         // spdlog::level::level_enum spd_level =
         //     helper::logger::to_spdlog_level<LogLevel::INFO>();
 
-        auto logger =
-          gen_logger(spd_level, logParam.logName, logParam.logDir, logParam.maxFileSize, logParam.maxRetentionDays);
+        auto logger = gen_logger(spd_level, logParam.logName, logParam.logDir, logParam.maxFileSize,
+                                 logParam.maxRetentionDays, logParam.asyncParam, logParam.mmapFile,
+                                 logParam.compressRotated);
         spdlog::set_default_logger(logger);
+        LogSite::configure(logParam.rateLimitParam);
+        // 限速日志与文件轮转读取TscClock, 初始化时完成校准.
+        ::helper::TscClock::warmUp();
 
         spdlog::flush_on(spd_level);
         spdlog::flush_every(std::chrono::seconds(1));
@@ -0,0 +1,496 @@
+/* Proj: tiny-future
+ * File: logger_test.cpp
+ * Created Date: 2023/5/12
+ * Author: yangyangyang
+ * Description:
+ * -----
+ * Last Modified: 2023/5/12 11:20:31
+ * -----
+ * Copyright (c) 2023  . All rights reserved.
+ */
+
+#include <gtest/gtest.h>
+
+#include "./logger.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <future>
+#include <set>
+
+#include <spdlog/sinks/base_sink.h>
+
+#include <sys/wait.h>
+#include <zlib.h>
+
+using namespace helper::logger;
+
+namespace {
+
+std::string testDir(const char* tag) {
+    return std::string("/tmp/tiny_future_logger_") + tag + "_" + std::to_string(::getpid());
+}
+
+std::string readFile(const std::string& path) {
+    std::ifstream in(path);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+// 日期目录下所有文件名到内容的映射.
+std::map<std::string, std::string> readLogs(const std::string& base_dir) {
+    std::map<std::string, std::string> logs;
+    for (auto& dir : listSubDir(base_dir)) {
+        DIR* handle = opendir(dir.c_str());
+        while (struct dirent* entry = readdir(handle)) {
+            const auto path = join<2>({dir, entry->d_name});
+            if (isFile(path)) {
+                logs[entry->d_name] = readFile(path);
+            }
+        }
+        closedir(handle);
+    }
+    return logs;
+}
+
+std::string gunzipFile(const std::string& path) {
+    std::string content;
+    gzFile in = gzopen(path.c_str(), "rb");
+    char buf[4096];
+    int n;
+    while ((n = gzread(in, buf, sizeof(buf))) > 0) {
+        content.append(buf, static_cast<size_t>(n));
+    }
+    gzclose(in);
+    return content;
+}
+
+size_t countLines(const std::map<std::string, std::string>& logs) {
+    size_t lines = 0;
+    for (auto& kv : logs) {
+        lines += std::count(kv.second.begin(), kv.second.end(), '\n');
+    }
+    return lines;
+}
+
+// 第一条日志阻塞写线程, 直到release被调用.
+class GateSink : public spdlog::sinks::base_sink<std::mutex> {
+public:
+    void release() { gate_.set_value(); }
+
+    std::vector<std::string> messages;
+
+protected:
+    void sink_it_(const spdlog::details::log_msg& msg) override {
+        if (messages.empty()) {
+            gate_future_.wait();
+        }
+        messages.emplace_back(msg.payload.data(), msg.payload.size());
+    }
+
+    void flush_() override {}
+
+private:
+    std::promise<void> gate_;
+    std::shared_future<void> gate_future_{gate_.get_future().share()};
+};
+
+} // namespace
+
+TEST(EasyFileSink, BatchRotatesLikeSingleWrites) {
+    const auto single_dir = testDir("single");
+    const auto batch_dir = testDir("batch");
+    removeDirectory(single_dir);
+    removeDirectory(batch_dir);
+    {
+        spdlog::sinks::easy_file_sink_mt single(single_dir, "app.log", 200, 3);
+        spdlog::sinks::easy_file_sink_mt batch(batch_dir, "app.log", 200, 3);
+        single.set_pattern("%v");
+        batch.set_pattern("%v");
+
+        // 所有日志使用同一时间点, 按大小轮转生成的文件名在两种写法下相同.
+        const auto now = spdlog::log_clock::now();
+        std::vector<spdlog::details::log_msg_buffer> msgs;
+        for (int i = 0; i < 50; ++i) {
+            const auto text = fmt::format("message-{:04d}", i);
+            spdlog::details::log_msg msg(now, spdlog::source_loc{}, "test", spdlog::level::info, text);
+            single.log(msg);
+            msgs.emplace_back(msg);
+        }
+        batch.sink_batch(msgs.data(), 20);
+        batch.sink_batch(msgs.data() + 20, 30);
+    }
+    const auto single_logs = readLogs(single_dir);
+    // 按大小轮转过.
+    EXPECT_GT(single_logs.size(), 1);
+    EXPECT_EQ(readLogs(batch_dir), single_logs);
+    removeDirectory(single_dir);
+    removeDirectory(batch_dir);
+}
+
+TEST(EasyFileSink, MmapMatchesFileHelper) {
+    const auto file_dir = testDir("file");
+    const auto mmap_dir = testDir("mmap");
+    removeDirectory(file_dir);
+    removeDirectory(mmap_dir);
+    {
+        spdlog::sinks::easy_file_sink_mt file_sink(file_dir, "app.log", 300, 3);
+        spdlog::sinks::easy_mmap_file_sink_mt mmap_sink(mmap_dir, "app.log", 300, 3);
+        file_sink.set_pattern("%v");
+        mmap_sink.set_pattern("%v");
+
+        const auto now = spdlog::log_clock::now();
+        std::vector<spdlog::details::log_msg_buffer> msgs;
+        for (int i = 0; i < 60; ++i) {
+            const auto text = fmt::format("message-{:04d}", i);
+            spdlog::details::log_msg msg(now, spdlog::source_loc{}, "test", spdlog::level::info, text);
+            file_sink.log(msg);
+            if (i < 30) {
+                mmap_sink.log(msg);
+            }
+            else {
+                msgs.emplace_back(msg);
+            }
+        }
+        mmap_sink.sink_batch(msgs.data(), msgs.size());
+    }
+    const auto file_logs = readLogs(file_dir);
+    EXPECT_GT(file_logs.size(), 1);
+    // 关闭时截断到实际大小, 内容与fwrite写出的完全相同.
+    EXPECT_EQ(readLogs(mmap_dir), file_logs);
+    removeDirectory(file_dir);
+    removeDirectory(mmap_dir);
+}
+
+TEST(EasyFileSink, CompressRotatedInBackground) {
+    const auto plain_dir = testDir("plain");
+    const auto gz_dir = testDir("gz");
+    removeDirectory(plain_dir);
+    removeDirectory(gz_dir);
+    {
+        spdlog::sinks::easy_file_sink_mt plain(plain_dir, "app.log", 200, 3);
+        spdlog::sinks::easy_file_sink_mt compressed(gz_dir, "app.log", 200, 3, true);
+        plain.set_pattern("%v");
+        compressed.set_pattern("%v");
+
+        const auto now = spdlog::log_clock::now();
+        for (int i = 0; i < 50; ++i) {
+            const auto text = fmt::format("message-{:04d}", i);
+            spdlog::details::log_msg msg(now, spdlog::source_loc{}, "test", spdlog::level::info, text);
+            plain.log(msg);
+            compressed.log(msg);
+        }
+    }
+    LogMaintenance::instance().drain();
+
+    const auto plain_logs = readLogs(plain_dir);
+    ASSERT_GT(plain_logs.size(), 1);
+    std::map<std::string, std::string> gz_logs;
+    for (auto& kv : readLogs(gz_dir)) {
+        const auto& name = kv.first;
+        if (name.size() > 3 && name.compare(name.size() - 3, 3, ".gz") == 0) {
+            const auto original = name.substr(0, name.size() - 3);
+            // 压缩完成后原文件已删除.
+            EXPECT_EQ(plain_logs.count(original), 1) << name;
+            gz_logs[original] = gunzipFile(join<2>({listSubDir(gz_dir).front(), name}));
+        }
+        else {
+            gz_logs[name] = kv.second;
+        }
+    }
+    // 只有仍在写的分段未被压缩.
+    EXPECT_EQ(gz_logs, plain_logs);
+    removeDirectory(plain_dir);
+    removeDirectory(gz_dir);
+}
+
+// 分段名被非空目录占用导致rename失败: 继续写daily文件且不登记该目录; 之后的轮转与按天清理(含.gz)不受影响.
+TEST(EasyFileSink, RenameFailureThenRetention) {
+    const auto dir = testDir("rename");
+    removeDirectory(dir);
+
+    // 今天中午, 与构造时的daily文件在同一日期目录下, 同一秒内按大小轮转的分段名相同.
+    std::time_t today = std::time(nullptr);
+    std::tm noon = spdlog::details::os::localtime(today);
+    noon.tm_hour = 12;
+    noon.tm_min = 0;
+    noon.tm_sec = 0;
+    const auto t0 = spdlog::log_clock::from_time_t(std::mktime(&noon));
+    const auto day_dir = join<2>({dir, fmt::format("{:04d}-{:02d}-{:02d}", noon.tm_year + 1900, noon.tm_mon + 1,
+                                                   noon.tm_mday)});
+    const auto daily = join<2>({day_dir, "app.log"});
+    const auto blocker = join<2>({day_dir, "app120000.log"});
+
+    auto names = [&day_dir]() {
+        std::set<std::string> out;
+        DIR* handle = opendir(day_dir.c_str());
+        while (struct dirent* entry = readdir(handle)) {
+            const std::string name = entry->d_name;
+            if (name != "." && name != "..") {
+                out.insert(name);
+            }
+        }
+        closedir(handle);
+        return out;
+    };
+    auto log = [](spdlog::sinks::easy_file_sink_mt& sink, spdlog::log_clock::time_point time, int from, int to) {
+        for (int i = from; i < to; ++i) {
+            const auto text = fmt::format("message-{:04d}", i);
+            sink.log(spdlog::details::log_msg(time, spdlog::source_loc{}, "test", spdlog::level::info, text));
+        }
+    };
+    {
+        spdlog::sinks::easy_file_sink_mt sink(dir, "app.log", 200, 1, true);
+        sink.set_pattern("%v");
+        ASSERT_EQ(::mkdir(blocker.c_str(), 0755), 0);
+        std::ofstream(join<2>({blocker, "keep"})) << "keep";
+
+        // 多次超过大小上限, rename每次都失败, 全部写入daily文件.
+        log(sink, t0, 0, 50);
+        sink.flush();
+        LogMaintenance::instance().drain();
+        EXPECT_EQ((std::set<std::string>{"app.log", "app120000.log"}), names());
+        const auto content = readFile(daily);
+        EXPECT_EQ(std::count(content.begin(), content.end(), '\n'), 50);
+
+        // 下一秒的分段名可用, 按大小轮转恢复, 旧分段在后台压缩.
+        log(sink, t0 + std::chrono::seconds(1), 50, 70);
+        LogMaintenance::instance().drain();
+        EXPECT_EQ(names().count("app120001.log.gz"), 1);
+
+        // 跨天轮转后只保留1天, 前一天登记过的文件(含.gz)被删除, 未登记的目录保留.
+        log(sink, t0 + std::chrono::hours(24), 70, 71);
+        LogMaintenance::instance().drain();
+        EXPECT_EQ(std::set<std::string>{"app120000.log"}, names());
+        EXPECT_TRUE(isFile(join<2>({blocker, "keep"})));
+    }
+    removeDirectory(dir);
+}
+
+TEST(MmapFileHelper, AppendAndRecoverAfterCrash) {
+    const auto dir = testDir("mmap_helper");
+    const auto path = dir + "/app.log";
+    removeDirectory(dir);
+    auto line = [](const std::string& text) {
+        spdlog::memory_buf_t buf;
+        buf.append(text.data(), text.data() + text.size());
+        return buf;
+    };
+    std::string expected;
+    {
+        // 小chunk, 覆盖重新映射窗口的路径.
+        spdlog::details::mmap_file_helper helper(4096);
+        helper.open(path);
+        for (int i = 0; i < 1000; ++i) {
+            const auto text = fmt::format("line {}\n", i);
+            helper.write(line(text));
+            expected += text;
+        }
+        EXPECT_EQ(helper.size(), expected.size());
+    }
+    EXPECT_EQ(readFile(path), expected);
+
+    // 子进程写入后不关闭直接退出, 文件末尾残留预分配的0字节.
+    const pid_t pid = ::fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+        auto* helper = new spdlog::details::mmap_file_helper(4096);
+        helper->open(path);
+        helper->write(line("from child\n"));
+        ::_exit(0);
+    }
+    int status = 0;
+    ::waitpid(pid, &status, 0);
+    expected += "from child\n";
+    EXPECT_GT(readFile(path).size(), expected.size());
+
+    {
+        spdlog::details::mmap_file_helper helper(4096);
+        helper.open(path);
+        EXPECT_EQ(helper.size(), expected.size());
+        helper.write(line("after crash\n"));
+        expected += "after crash\n";
+    }
+    EXPECT_EQ(readFile(path), expected);
+    removeDirectory(dir);
+}
+
+TEST(AsyncLogger, WritesEverythingOnShutdown) {
+    constexpr int kThreads = 4;
+    constexpr int kPerThread = 1000;
+    const auto dir = testDir("async");
+    removeDirectory(dir);
+    {
+        AsyncLogParam param;
+        param.enable = true;
+        param.queueSize = 64;
+        auto logger = LoggerGenerator::gen_logger(spdlog::level::off, "async.log", dir, 1 << 30, 3, param);
+        logger->set_level(spdlog::level::info);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < kThreads; ++t) {
+            threads.emplace_back([&logger, t]() {
+                for (int i = 0; i < kPerThread; ++i) {
+                    logger->info("thread {} message {}", t, i);
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+    EXPECT_EQ(countLines(readLogs(dir)), static_cast<size_t>(kThreads * kPerThread));
+    removeDirectory(dir);
+}
+
+TEST(AsyncLogger, DropAndCount) {
+    auto gate = std::make_shared<GateSink>();
+    gate->set_pattern("%v");
+    uint64_t dropped = 0;
+    {
+        auto front = std::make_shared<spdlog::sinks::async_sink>(std::vector<spdlog::sink_ptr>{gate}, 4,
+                                                                 AsyncOverflow::DROP_AND_COUNT, 16);
+        spdlog::logger logger("drop", front);
+        // 写线程阻塞在第一条上, 队列只能再容纳4条.
+        for (int i = 0; i < 100; ++i) {
+            logger.info("message {}", i);
+        }
+        dropped = front->dropped();
+        gate->release();
+    }
+    EXPECT_GT(dropped, 0);
+    EXPECT_EQ(gate->messages.size(), 100 - dropped + 1);
+    // 汇总在写线程取出的那一批之后输出, 丢弃之后才入队的消息可能排在它后面.
+    EXPECT_EQ(std::count(gate->messages.begin(), gate->messages.end(),
+                         fmt::format("async logger dropped {} messages", dropped)),
+              1);
+}
+
+namespace {
+
+// 按行保存格式化后的日志; 后台汇总线程可能同时写入, 读取时持有sink的锁.
+class LineSink : public spdlog::sinks::base_sink<std::mutex> {
+public:
+    std::vector<std::string> lines() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return lines_;
+    }
+
+protected:
+    void sink_it_(const spdlog::details::log_msg& msg) override {
+        spdlog::memory_buf_t formatted;
+        formatter_->format(msg, formatted);
+        std::string line(formatted.data(), formatted.size());
+        while (!line.empty() && (line.back() == '\n' || line.back() == '\r')) {
+            line.pop_back();
+        }
+        lines_.push_back(std::move(line));
+    }
+
+    void flush_() override {}
+
+private:
+    std::vector<std::string> lines_;
+};
+
+// 把默认logger替换为写入内存的logger, 析构时恢复.
+class CaptureDefaultLogger {
+public:
+    CaptureDefaultLogger()
+        : previous_(spdlog::default_logger())
+        , sink_(std::make_shared<LineSink>()) {
+        sink_->set_pattern("%v");
+        spdlog::set_default_logger(std::make_shared<spdlog::logger>("capture", sink_));
+    }
+
+    ~CaptureDefaultLogger() { spdlog::set_default_logger(previous_); }
+
+    std::vector<std::string> lines() const { return sink_->lines(); }
+
+private:
+    std::shared_ptr<spdlog::logger> previous_;
+    std::shared_ptr<LineSink> sink_;
+};
+
+// 返回(非汇总行数, 各汇总行中的条数之和).
+std::pair<size_t, size_t> suppressedTotal(const std::vector<std::string>& lines) {
+    std::pair<size_t, size_t> result{0, 0};
+    for (const auto& line : lines) {
+        if (line.rfind("suppressed ", 0) == 0) {
+            result.second += std::stoul(line.substr(11));
+        }
+        else {
+            ++result.first;
+        }
+    }
+    return result;
+}
+
+void logStorm(int times) {
+    for (int i = 0; i < times; ++i) {
+        LOG_RATE_LIMITED(spdlog::level::err, "storm {}", i);
+    }
+}
+
+} // namespace
+
+TEST(RateLimitedLog, BurstThenSummary) {
+    CaptureDefaultLogger capture;
+    RateLimitParam param;
+    param.perSecond = 10;
+    param.burst = 5;
+    param.summaryIntervalMs = 0;
+    LogSite::configure(param);
+
+    logStorm(1000);
+    // 突发额度加上执行期间补充的少量令牌.
+    const auto admitted = suppressedTotal(capture.lines()).first;
+    EXPECT_GE(admitted, 5);
+    EXPECT_LT(admitted, 10);
+    EXPECT_EQ(capture.lines().front(), "storm 0");
+
+    // 日志停止后, 后台汇总线程输出剩余的被抑制条数.
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    auto lines = capture.lines();
+    EXPECT_EQ(suppressedTotal(lines).second, 1000 - admitted);
+    EXPECT_EQ(lines.back().rfind("suppressed ", 0), 0);
+
+    logStorm(1);
+    lines = capture.lines();
+    EXPECT_EQ(lines.back(), "storm 0");
+    EXPECT_EQ(suppressedTotal(lines).second, 1000 - admitted);
+    LogSite::configure(RateLimitParam{});
+}
+
+TEST(RateLimitedLog, EveryN) {
+    CaptureDefaultLogger capture;
+    RateLimitParam param;
+    param.summaryIntervalMs = 200;
+    LogSite::configure(param);
+    for (int i = 0; i < 100; ++i) {
+        LOG_EVERY_N(spdlog::level::warn, 10, "sample {}", i);
+    }
+    auto lines = capture.lines();
+    // 第一次汇总立即输出, 间隔内不再随放行的日志汇总.
+    ASSERT_EQ(lines.size(), 11);
+    EXPECT_EQ(lines[0], "sample 0");
+    EXPECT_EQ(lines[1], "suppressed 9 messages");
+    EXPECT_EQ(lines[2], "sample 10");
+    EXPECT_EQ(lines[10], "sample 90");
+
+    // 剩余的条数由后台汇总线程输出.
+    for (int i = 0; i < 100 && lines.size() < 12; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        lines = capture.lines();
+    }
+    ASSERT_EQ(lines.size(), 12);
+    EXPECT_EQ(lines[11], "suppressed 81 messages");
+    LogSite::configure(RateLimitParam{});
+
+    // 低于日志级别的调用不计数.
+    spdlog::set_level(spdlog::level::err);
+    for (int i = 0; i < 100; ++i) {
+        LOG_EVERY_N(spdlog::level::info, 10, "filtered {}", i);
+    }
+    EXPECT_EQ(capture.lines().size(), 12);
+}
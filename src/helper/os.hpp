@@ -12,14 +12,22 @@
 #pragma once
 
 #include "./literal.hpp"
+#include "future_wrapper/executor.hpp"
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <condition_variable>
 #include <cstdio>
 #include <cstring>
 #include <dirent.h>
+#include <fcntl.h>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <vector>
 
 #ifndef OS_SEP
@@ -56,13 +64,18 @@ template <size_t N, typename Array = std::array<std::string, N>>
 inline std::string join(const Array& arr, char sep = OS_SEP) noexcept {
     if (arr.empty())
         return {};
-    std::stringstream ss;
-    for (int32_t i = 0; i < arr.size(); ++i) {
-        ss << arr[i];
+    size_t length = arr.size() - 1;
+    for (const auto& part : arr) {
+        length += part.size();
+    }
+    std::string result;
+    result.reserve(length);
+    for (size_t i = 0; i < arr.size(); ++i) {
+        result.append(arr[i]);
         if (i < arr.size() - 1)
-            ss << sep;
+            result.push_back(sep);
     }
-    return ss.str();
+    return result;
 }
 
 template <typename Element = std::string, typename Vector = std::vector<Element>>
@@ -76,84 +89,270 @@ inline std::string join(const Vector& vec, const Element& delim) noexcept {
 }
 
 inline bool isFile(const std::string& filepath) noexcept {
-    if (filepath.empty())
-        return false;
-    // RAII.
-    const std::ifstream checkFile(filepath);
-    return checkFile.is_open();
+    struct stat st {};
+    return !filepath.empty() && ::stat(filepath.c_str(), &st) == 0 && S_ISREG(st.st_mode);
 }
 
 inline bool isDir(const std::string& dir_path) noexcept {
-    if (dir_path.empty())
-        return false;
+    struct stat st {};
+    return !dir_path.empty() && ::stat(dir_path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+namespace os_detail {
 
-    DIR* dir_handle = opendir(dir_path.c_str());
-    const bool isDir = dir_handle != nullptr;
-    if (isDir) {
-        closedir(dir_handle);
+enum class EntryType : int8_t {
+    FILE = 0,
+    DIR = 1,
+    // 设备文件等, 以及不跟随时的符号链接.
+    OTHER = 2,
+    // 条目在读取目录后已被删除.
+    MISSING = 3,
+};
+
+inline bool isDots(const char* name) noexcept {
+    return name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+}
+
+/**
+ * @brief 优先使用readdir给出的d_type, 文件系统不支持时(DT_UNKNOWN)相对于目录fd调用fstatat.
+ * follow_links为true时符号链接按其指向的类型分类(与stat相同), 否则归为OTHER.
+ */
+inline EntryType entryType(int dir_fd, const struct dirent* entry, bool follow_links = false) noexcept {
+    switch (entry->d_type) {
+    case DT_REG:
+        return EntryType::FILE;
+    case DT_DIR:
+        return EntryType::DIR;
+    case DT_UNKNOWN:
+        break;
+    case DT_LNK:
+        if (follow_links) {
+            break;
+        }
+        return EntryType::OTHER;
+    default:
+        return EntryType::OTHER;
     }
-    return isDir;
+    struct stat st {};
+    if (::fstatat(dir_fd, entry->d_name, &st, follow_links ? 0 : AT_SYMLINK_NOFOLLOW) != 0) {
+        return EntryType::MISSING;
+    }
+    if (S_ISREG(st.st_mode)) {
+        return EntryType::FILE;
+    }
+    return S_ISDIR(st.st_mode) ? EntryType::DIR : EntryType::OTHER;
 }
 
-inline bool removeDirectory(const std::string& dir_path) noexcept {
-    if (!isDir(dir_path))
+/**
+ * @brief 遍历dir_fd下的条目(跳过.和..), visit(const char* name, EntryType type). dir_fd不会被关闭.
+ */
+template <typename Visitor>
+inline bool forEachEntry(int dir_fd, Visitor&& visit, bool follow_links = false) {
+    // fdopendir接管传入的fd, 因此使用dup出的fd.
+    const int fd = ::dup(dir_fd);
+    if (fd < 0) {
         return false;
+    }
+    DIR* dir_handle = ::fdopendir(fd);
+    if (dir_handle == nullptr) {
+        ::close(fd);
+        return false;
+    }
+    // visit可能抛出异常, 由unique_ptr负责closedir.
+    std::unique_ptr<DIR, int (*)(DIR*)> guard(dir_handle, &::closedir);
+    while (struct dirent* entry = ::readdir(dir_handle)) {
+        if (!isDots(entry->d_name)) {
+            visit(entry->d_name, entryType(dir_fd, entry, follow_links));
+        }
+    }
+    return true;
+}
 
-    DIR* dir_handle;
-    struct dirent* entry;
-    if ((dir_handle = opendir(dir_path.c_str())) != nullptr) {
-        while ((entry = readdir(dir_handle)) != nullptr) {
-            // ignore . and ..
-            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
-                continue;
-            }
-
-            // get sub abspath.
-            const auto abs_path = join<2>({dir_path, entry->d_name});
+// 只有调用者传入的根目录才跟随符号链接.
+inline int openDirAt(int dir_fd, const char* name, bool follow = false) noexcept {
+    return ::openat(dir_fd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC | (follow ? 0 : O_NOFOLLOW));
+}
 
-            // sub fd is dir or file?
-            if (isDir(abs_path)) {
-                removeDirectory(abs_path);
-            }
-            else if (isFile(abs_path)) {
-                remove(abs_path.c_str());
+/**
+ * @brief 删除dir_fd下的全部内容, 子目录通过openat打开, 不跟随符号链接.
+ */
+inline bool removeContentsAt(int dir_fd) noexcept {
+    bool ok = true;
+    forEachEntry(dir_fd, [&](const char* name, EntryType type) {
+        if (type == EntryType::MISSING) {
+            return;
+        }
+        if (type == EntryType::DIR) {
+            const int sub_fd = openDirAt(dir_fd, name);
+            if (sub_fd < 0) {
+                ok = false;
+                return;
             }
+            ok = removeContentsAt(sub_fd) && ok;
+            ::close(sub_fd);
         }
-        closedir(dir_handle);
-        remove(dir_path.c_str());
-    }
+        if (::unlinkat(dir_fd, name, type == EntryType::DIR ? AT_REMOVEDIR : 0) != 0 && errno != ENOENT) {
+            ok = false;
+        }
+    });
+    return ok;
+}
 
+} // namespace os_detail
+
+inline bool removeDirectory(const std::string& dir_path) noexcept {
+    if (dir_path.empty())
+        return false;
+
+    const int dir_fd = os_detail::openDirAt(AT_FDCWD, dir_path.c_str(), true);
+    if (dir_fd < 0)
+        return false;
+
+    os_detail::removeContentsAt(dir_fd);
+    ::close(dir_fd);
+    remove(dir_path.c_str());
     return true;
 }
 
-void getSubDirs(std::vector<std::string>& out, const std::string& in, bool is_recursive) noexcept {
-    // open dir.
-    DIR* dir_handle;
-    struct dirent* entry;
-
-    if ((dir_handle = opendir(in.c_str())) != nullptr) {
-        // loop to get sub dir.
-        while ((entry = readdir(dir_handle)) != nullptr) {
-            // ignore . and ..
-            if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
-                std::string sub_path = join<2>({in, entry->d_name});
-                if (isDir(sub_path)) {
-                    if (is_recursive) {
-                        getSubDirs(out, sub_path, is_recursive);
+/**
+ * @brief 在executor上并行删除目录, 子目录全部删除后再删除父目录.
+ * 待扫描的目录放在私有的工作列表中, 由调用线程提交的至多parallelism个任务(以及调用线程自身)取出处理,
+ * worker中不再向executor提交任务, 有界队列(BLOCK/REJECT)下也不会因队列满而死锁或抛出.
+ * 调用线程阻塞直到删除完成, 因此不能在executor自己的worker中调用.
+ */
+inline bool removeDirectoryParallel(const std::string& dir_path, Executor& executor, size_t parallelism = 4) {
+    struct Node {
+        // 根节点为调用者传入的路径, 其余为相对父目录的名字.
+        std::string name;
+        std::shared_ptr<Node> parent;
+        // 扫描时打开, 子目录都删除后关闭; 子目录通过它openat/unlinkat, 不重新解析完整路径.
+        int fd{-1};
+        // 未完成的子目录数, 加上本目录自身的扫描.
+        std::atomic<size_t> remaining{1};
+    };
+    struct Removal {
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::vector<std::shared_ptr<Node>> pending;
+        // 正在扫描的目录数, 为0且pending为空时不会再产生新的目录.
+        size_t scanning{0};
+        bool finished{false};
+
+        void finish(const std::shared_ptr<Node>& node) {
+            if (node->remaining.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+                return;
+            }
+            if (node->fd >= 0) {
+                ::close(node->fd);
+                node->fd = -1;
+            }
+            if (node->parent) {
+                ::unlinkat(node->parent->fd, node->name.c_str(), AT_REMOVEDIR);
+                finish(node->parent);
+                return;
+            }
+            remove(node->name.c_str());
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                finished = true;
+            }
+            cv.notify_all();
+        }
+
+        void scan(const std::shared_ptr<Node>& node) {
+            std::vector<std::shared_ptr<Node>> children;
+            // 父目录在所有子目录完成前保持打开. O_NOFOLLOW作用于唯一的路径分量, 不会被替换为符号链接的中间目录绕过.
+            const int dir_fd = node->parent ? os_detail::openDirAt(node->parent->fd, node->name.c_str())
+                                            : os_detail::openDirAt(AT_FDCWD, node->name.c_str(), true);
+            node->fd = dir_fd;
+            if (dir_fd >= 0) {
+                os_detail::forEachEntry(dir_fd, [&](const char* name, os_detail::EntryType type) {
+                    if (type == os_detail::EntryType::DIR) {
+                        auto child = std::make_shared<Node>();
+                        child->name = name;
+                        child->parent = node;
+                        node->remaining.fetch_add(1, std::memory_order_relaxed);
+                        children.push_back(std::move(child));
+                    }
+                    else if (type != os_detail::EntryType::MISSING) {
+                        ::unlinkat(dir_fd, name, 0);
                     }
-                    out.push_back(std::move(sub_path));
+                });
+            }
+            if (!children.empty()) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    pending.insert(pending.end(), std::make_move_iterator(children.begin()),
+                                   std::make_move_iterator(children.end()));
                 }
+                cv.notify_all();
             }
+            finish(node);
+        }
+
+        // 取出并处理目录, 直到没有待扫描也没有正在扫描的目录.
+        void drain() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                cv.wait(lock, [this]() { return !pending.empty() || scanning == 0; });
+                if (pending.empty()) {
+                    return;
+                }
+                auto node = std::move(pending.back());
+                pending.pop_back();
+                ++scanning;
+                lock.unlock();
+                scan(node);
+                lock.lock();
+                if (--scanning == 0 && pending.empty()) {
+                    cv.notify_all();
+                }
+            }
+        }
+    };
+
+    if (!isDir(dir_path))
+        return false;
+
+    auto removal = std::make_shared<Removal>();
+    auto root = std::make_shared<Node>();
+    root->name = dir_path;
+    removal->pending.push_back(std::move(root));
+    // 调用线程不是worker, 在这里提交可以阻塞; 被拒绝时少用几个worker, 由调用线程完成剩余部分.
+    for (size_t i = 1; i < parallelism; ++i) {
+        try {
+            executor.submit([removal]() { removal->drain(); });
+        }
+        catch (const ExecutorRejected&) {
+            break;
         }
-        closedir(dir_handle);
     }
+    removal->drain();
+
+    std::unique_lock<std::mutex> lock(removal->mutex);
+    removal->cv.wait(lock, [&removal]() { return removal->finished; });
+    return true;
 }
 
-std::vector<std::string> listSubDir(const std::string& dir, bool is_sort_result = true) noexcept {
-    if (!isDir(dir)) {
-        return {};
-    }
+// 与stat相同, 指向目录的符号链接也算作子目录.
+inline void getSubDirs(std::vector<std::string>& out, const std::string& in, bool is_recursive) noexcept {
+    const int dir_fd = os_detail::openDirAt(AT_FDCWD, in.c_str(), true);
+    if (dir_fd < 0)
+        return;
+
+    os_detail::forEachEntry(dir_fd, [&](const char* name, os_detail::EntryType type) {
+        if (type != os_detail::EntryType::DIR)
+            return;
+        std::string sub_path = join<2>({in, name});
+        if (is_recursive) {
+            getSubDirs(out, sub_path, is_recursive);
+        }
+        out.push_back(std::move(sub_path));
+    }, true);
+    ::close(dir_fd);
+}
 
+inline std::vector<std::string> listSubDir(const std::string& dir, bool is_sort_result = true) noexcept {
     std::vector<std::string> abs_paths;
     getSubDirs(abs_paths, dir, false);
 
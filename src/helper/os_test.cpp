@@ -10,9 +10,37 @@
  */
 
 #include "./os.hpp"
+#include "future_wrapper/executor.hpp"
 #include <cstring>
 #include <gtest/gtest.h>
 
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// 生成depth层, 每层fanout个子目录, 每个目录files个文件的目录树, 返回文件总数.
+size_t makeTree(const std::string& dir, int depth, int fanout, int files) {
+    ::mkdir(dir.c_str(), 0755);
+    size_t count = 0;
+    for (int i = 0; i < files; ++i) {
+        std::ofstream(join<2>({dir, "file-" + std::to_string(i)})) << i;
+        ++count;
+    }
+    if (depth > 0) {
+        for (int i = 0; i < fanout; ++i) {
+            count += makeTree(join<2>({dir, "dir-" + std::to_string(i)}), depth - 1, fanout, files);
+        }
+    }
+    return count;
+}
+
+std::string testDir(const char* tag) {
+    return std::string("/tmp/tiny_future_os_") + tag + "_" + std::to_string(::getpid());
+}
+
+} // namespace
+
 TEST(LIST_DIR, GET_SUB_DIR) {
     const auto inputDir = "/home/ubuntu/workspace/cpp/InferenceApi/logs-"_str;
     auto subDirs = listSubDir(inputDir);
@@ -53,3 +81,57 @@ TEST(REMOVE_DIR, ACTUAL) {
     const auto inputDir = "/home/ubuntu/workspace/cpp/InferenceApi/logs-"_str;
     EXPECT_TRUE(removeDirectory(inputDir));
 }
+
+TEST(REMOVE_DIR, TREE_AND_SYMLINK) {
+    const auto dir = testDir("tree");
+    const auto outside = testDir("outside");
+    makeTree(dir, 3, 3, 5);
+    makeTree(outside, 0, 0, 2);
+    // 指向树外的符号链接只删除链接本身.
+    ASSERT_EQ(::symlink(outside.c_str(), join<2>({dir, "link"}).c_str()), 0);
+
+    EXPECT_TRUE(isDir(dir));
+    EXPECT_FALSE(isFile(dir));
+    EXPECT_TRUE(isFile(join<2>({dir, "file-0"})));
+    // 列出子目录时与stat相同, 跟随指向目录的符号链接.
+    EXPECT_EQ(listSubDir(dir),
+              (std::vector<std::string>{dir + "/dir-0", dir + "/dir-1", dir + "/dir-2", dir + "/link"}));
+    std::vector<std::string> all;
+    getSubDirs(all, dir, true);
+    EXPECT_EQ(all.size(), 3u + 9u + 27u + 1u);
+
+    EXPECT_TRUE(removeDirectory(dir));
+    EXPECT_FALSE(isDir(dir));
+    EXPECT_TRUE(isFile(join<2>({outside, "file-1"})));
+    EXPECT_FALSE(removeDirectory(dir));
+    EXPECT_TRUE(removeDirectory(outside));
+}
+
+TEST(REMOVE_DIR, PARALLEL) {
+    const auto dir = testDir("parallel");
+    const auto outside = testDir("parallel_outside");
+    EXPECT_EQ(makeTree(dir, 4, 4, 8), 8u * (1 + 4 + 16 + 64 + 256));
+    makeTree(outside, 1, 1, 2);
+    ASSERT_EQ(::symlink(outside.c_str(), join<3>({dir, "dir-1", "link"}).c_str()), 0);
+    {
+        ThreadExecutor executor(4);
+        EXPECT_TRUE(removeDirectoryParallel(dir, executor));
+    }
+    EXPECT_FALSE(isDir(dir));
+    EXPECT_TRUE(isFile(join<3>({outside, "dir-0", "file-1"})));
+    EXPECT_TRUE(removeDirectory(outside));
+
+    ThreadExecutor executor(2);
+    EXPECT_FALSE(removeDirectoryParallel(dir, executor));
+}
+
+// 有界队列: worker不向executor提交任务, BLOCK不会死锁, REJECT不会抛出.
+TEST(REMOVE_DIR, PARALLEL_BOUNDED) {
+    for (auto policy : {OverflowPolicy::BLOCK, OverflowPolicy::REJECT}) {
+        const auto dir = testDir("bounded");
+        EXPECT_EQ(makeTree(dir, 2, 50, 1), 1u + 50 + 2500);
+        ThreadExecutor executor(2, 4, policy);
+        EXPECT_TRUE(removeDirectoryParallel(dir, executor, 8));
+        EXPECT_FALSE(isDir(dir));
+    }
+}
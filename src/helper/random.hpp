@@ -4,21 +4,185 @@
  * Author: yangyangyang
  * Description:
  * -----
- * Last Modified: 2022/12/21 16:07:58
+ * Last Modified: 2023/5/16 17:20:45
  * -----
  * Copyright (c) 2022  . All rights reserved.
  */
 #ifndef INFERENCEAPI_RANDOM_HPP
 #define INFERENCEAPI_RANDOM_HPP
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
 #include <random>
 
 namespace rng {
 
+inline uint64_t splitmix64(uint64_t& state) noexcept {
+    uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+inline uint64_t rotl(uint64_t x, int k) noexcept { return (x << k) | (x >> (64 - k)); }
+
+// 64位随机数 -> [0, 1)的float, 只使用高24位.
+inline float toUnitFloat(uint64_t x) noexcept { return static_cast<float>(x >> 40) * (1.0f / 16777216.0f); }
+
+/**
+ * xoshiro256**, 满足UniformRandomBitGenerator, 可以配合<random>中的分布使用. 非线程安全, 每个线程各持一个.
+ */
+class Xoshiro256 {
+public:
+    using result_type = uint64_t;
+
+    explicit Xoshiro256(uint64_t seed) noexcept {
+        for (auto& s : s_) {
+            s = splitmix64(seed);
+        }
+    }
+
+    static constexpr result_type min() noexcept { return 0; }
+
+    static constexpr result_type max() noexcept { return std::numeric_limits<result_type>::max(); }
+
+    result_type operator()() noexcept {
+        const uint64_t result = rotl(s_[1] * 5, 7) * 9;
+        const uint64_t t = s_[1] << 17;
+        s_[2] ^= s_[0];
+        s_[3] ^= s_[1];
+        s_[1] ^= s_[2];
+        s_[0] ^= s_[3];
+        s_[2] ^= t;
+        s_[3] = rotl(s_[3], 45);
+        return result;
+    }
+
+private:
+    uint64_t s_[4];
+};
+
+namespace detail {
+
+// 进程级种子取自random_device, 每个线程再混入递增编号, 保证各线程的序列不同.
+inline uint64_t nextThreadSeed() noexcept {
+    static const uint64_t base = (static_cast<uint64_t>(std::random_device{}()) << 32) ^ std::random_device{}();
+    static std::atomic<uint64_t> counter{0};
+    uint64_t state = base + counter.fetch_add(1, std::memory_order_relaxed) * 0x9e3779b97f4a7c15ULL;
+    return splitmix64(state);
+}
+
+} // namespace detail
+
+// 当前线程的生成器, 首次使用时播种, 之后无锁.
+inline Xoshiro256& threadGenerator() noexcept {
+    static thread_local Xoshiro256 generator{detail::nextThreadSeed()};
+    return generator;
+}
+
 inline float randomFloat(float min = 0.0f, float max = 10.0f) noexcept {
-    static std::random_device rd;
-    static std::mt19937 mt(rd());
-    static std::uniform_real_distribution<float> dist(min, max);
-    return dist(mt);
+    return min + (max - min) * toUnitFloat(threadGenerator()());
+}
+
+/**
+ * @brief [min, max]内的整数, 使用乘法映射(Lemire)代替取模, 偏差小于(max - min + 1) / 2^64.
+ */
+inline int64_t randomInt(int64_t min, int64_t max) noexcept {
+    const uint64_t range = static_cast<uint64_t>(max) - static_cast<uint64_t>(min) + 1;
+    const uint64_t x = threadGenerator()();
+    if (range == 0) {
+        return static_cast<int64_t>(x);
+    }
+    return min + static_cast<int64_t>((static_cast<unsigned __int128>(x) * range) >> 64);
+}
+
+/**
+ * 4路交错的xoshiro256**, 状态按列存放, 批量生成时循环可以被编译器向量化(AVX2下一次生成4个64位数).
+ */
+class Xoshiro256x4 {
+public:
+    static constexpr size_t kLanes = 4;
+
+    explicit Xoshiro256x4(uint64_t seed) noexcept {
+        for (size_t lane = 0; lane < kLanes; ++lane) {
+            for (auto& s : s_) {
+                s[lane] = splitmix64(seed);
+            }
+        }
+    }
+
+    void next(uint64_t (&out)[kLanes]) noexcept {
+        for (size_t i = 0; i < kLanes; ++i) {
+            out[i] = rotl(s_[1][i] * 5, 7) * 9;
+            const uint64_t t = s_[1][i] << 17;
+            s_[2][i] ^= s_[0][i];
+            s_[3][i] ^= s_[1][i];
+            s_[1][i] ^= s_[2][i];
+            s_[0][i] ^= s_[3][i];
+            s_[2][i] ^= t;
+            s_[3][i] = rotl(s_[3][i], 45);
+        }
+    }
+
+private:
+    alignas(32) uint64_t s_[4][kLanes];
+};
+
+inline Xoshiro256x4& threadBulkGenerator() noexcept {
+    static thread_local Xoshiro256x4 generator{detail::nextThreadSeed()};
+    return generator;
+}
+
+// 用[min, max)内的均匀随机数填充out[0, n), 每个64位数拆成两个24位float.
+inline void fill(float* out, size_t n, float min, float max) noexcept {
+    constexpr size_t kLanes = Xoshiro256x4::kLanes;
+    auto& gen = threadBulkGenerator();
+    const float scale = (max - min) * (1.0f / 16777216.0f);
+    uint64_t block[kLanes];
+    size_t i = 0;
+    // 24位的值先转为int32, 整数到浮点的转换才能向量化.
+    for (; i + 2 * kLanes <= n; i += 2 * kLanes) {
+        gen.next(block);
+        for (size_t lane = 0; lane < kLanes; ++lane) {
+            out[i + lane] = min + static_cast<float>(static_cast<int32_t>(block[lane] >> 40)) * scale;
+            out[i + kLanes + lane] =
+              min + static_cast<float>(static_cast<int32_t>((block[lane] >> 8) & 0xffffff)) * scale;
+        }
+    }
+    if (i < n) {
+        gen.next(block);
+        for (size_t j = 0; i < n; ++i, ++j) {
+            const uint64_t x = block[j % kLanes];
+            out[i] = min + static_cast<float>(static_cast<int32_t>(j < kLanes ? x >> 40 : (x >> 8) & 0xffffff)) * scale;
+        }
+    }
+}
+
+// 用[min, max]内的均匀随机整数填充out[0, n), 每个64位数拆成两个32位数再做乘法映射.
+inline void fill(int32_t* out, size_t n, int32_t min, int32_t max) noexcept {
+    constexpr size_t kLanes = Xoshiro256x4::kLanes;
+    auto& gen = threadBulkGenerator();
+    const uint64_t range = static_cast<uint64_t>(static_cast<int64_t>(max) - min + 1);
+    auto map = [min, range](uint64_t x32) {
+        return static_cast<int32_t>(min + static_cast<int64_t>((x32 * range) >> 32));
+    };
+    uint64_t block[kLanes];
+    size_t i = 0;
+    for (; i + 2 * kLanes <= n; i += 2 * kLanes) {
+        gen.next(block);
+        for (size_t lane = 0; lane < kLanes; ++lane) {
+            out[i + lane] = map(block[lane] >> 32);
+            out[i + kLanes + lane] = map(block[lane] & 0xffffffff);
+        }
+    }
+    if (i < n) {
+        gen.next(block);
+        for (size_t j = 0; i < n; ++i, ++j) {
+            const uint64_t x = block[j % kLanes];
+            out[i] = map(j < kLanes ? x >> 32 : x & 0xffffffff);
+        }
+    }
 }
 
 } // namespace rng
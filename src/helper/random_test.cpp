@@ -0,0 +1,75 @@
+/* Proj: tiny-future
+ * File: random_test.cpp
+ * Created Date: 2023/5/16
+ * Author: yangyangyang
+ * Description:
+ * -----
+ * Last Modified: 2023/5/16 17:48:30
+ * -----
+ * Copyright (c) 2023  . All rights reserved.
+ */
+
+#include "./random.hpp"
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+TEST(Random, RespectsBoundsOnEveryCall) {
+    for (int i = 0; i < 1000; ++i) {
+        const float a = rng::randomFloat(1.0f, 2.0f);
+        EXPECT_GE(a, 1.0f);
+        EXPECT_LT(a, 2.0f);
+        // 每次调用的区间都生效.
+        const float b = rng::randomFloat(-5.0f, -4.0f);
+        EXPECT_GE(b, -5.0f);
+        EXPECT_LT(b, -4.0f);
+        const int64_t c = rng::randomInt(-3, 3);
+        EXPECT_GE(c, -3);
+        EXPECT_LE(c, 3);
+    }
+}
+
+TEST(Random, ThreadsGetDifferentSequences) {
+    std::vector<uint64_t> first(4);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < first.size(); ++t) {
+        threads.emplace_back([&first, t]() { first[t] = rng::threadGenerator()(); });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    std::sort(first.begin(), first.end());
+    EXPECT_EQ(std::unique(first.begin(), first.end()), first.end());
+}
+
+TEST(Random, FillFloat) {
+    // 长度不是8的倍数, 覆盖尾部.
+    std::vector<float> values(100003);
+    rng::fill(values.data(), values.size(), -1.0f, 3.0f);
+    EXPECT_GE(*std::min_element(values.begin(), values.end()), -1.0f);
+    EXPECT_LT(*std::max_element(values.begin(), values.end()), 3.0f);
+    const double mean = std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+    EXPECT_NEAR(mean, 1.0, 0.05);
+}
+
+TEST(Random, FillInt) {
+    std::vector<int32_t> values(80005);
+    rng::fill(values.data(), values.size(), 10, 19);
+    std::vector<size_t> counts(10);
+    for (int32_t v : values) {
+        ASSERT_GE(v, 10);
+        ASSERT_LE(v, 19);
+        ++counts[v - 10];
+    }
+    for (size_t count : counts) {
+        EXPECT_NEAR(static_cast<double>(count), values.size() / 10.0, values.size() / 100.0);
+    }
+
+    std::vector<int32_t> full(1000);
+    rng::fill(full.data(), full.size(), std::numeric_limits<int32_t>::min(), std::numeric_limits<int32_t>::max());
+    EXPECT_TRUE(std::any_of(full.begin(), full.end(), [](int32_t v) { return v < 0; }));
+    EXPECT_TRUE(std::any_of(full.begin(), full.end(), [](int32_t v) { return v > 0; }));
+}
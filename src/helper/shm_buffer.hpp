@@ -0,0 +1,415 @@
+/* Proj: tiny-future
+ * File: shm_buffer.hpp
+ * Created Date: 2023/5/11
+ * Author: yangyangyang
+ * Description: 基于/dev/shm的跨进程单生产者单消费者环形队列.
+ * -----
+ * Last Modified: 2023/5/11 15:32:07
+ * -----
+ * Copyright (c) 2023  . All rights reserved.
+ */
+
+#pragma once
+
+#include "./buffer.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2, "shm ring requires address-free atomics");
+
+/**
+ * 放在共享内存中的EventCount, 使用非PRIVATE的futex, 可以唤醒其他进程中的等待者.
+ * 全零即为初始状态.
+ *
+ * 只有一个32位的字: 最低位表示有等待者, 其余位是序号. 等待者置位后以该值作为futex的期望值,
+ * notify只在置位时把字加一(清除等待位并改变序号)后FUTEX_WAKE. 不维护等待者计数: 等待者所在进程崩溃,
+ * 或等待超时/取消后留下的等待位, 只会让下一次notify多一次futex调用, 之后即恢复.
+ */
+class ShmEventCount {
+public:
+    using Key = uint32_t;
+    using Clock = std::chrono::steady_clock;
+
+    Key prepareWait() noexcept { return epoch_.fetch_or(kWaiting, std::memory_order_seq_cst) | kWaiting; }
+
+    // 等待位留给下一次notify清除: 其他等待者可能仍以同一个值等待, 这里不能改动它.
+    void cancelWait() noexcept {}
+
+    // 返回false表示超时.
+    bool waitUntil(Key key, Clock::time_point deadline) noexcept {
+        while (epoch_.load(std::memory_order_acquire) == key) {
+            if (deadline == Clock::time_point::max()) {
+                futex(FUTEX_WAIT, key, nullptr);
+                continue;
+            }
+            const auto remain = deadline - Clock::now();
+            if (remain <= Clock::duration::zero()) {
+                return false;
+            }
+            const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(remain).count();
+            struct timespec ts {
+                static_cast<time_t>(ns / 1000000000), static_cast<long>(ns % 1000000000)
+            };
+            futex(FUTEX_WAIT, key, &ts);
+        }
+        return true;
+    }
+
+    void notify() noexcept {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if ((epoch_.load(std::memory_order_relaxed) & kWaiting) == 0) {
+            return;
+        }
+        // 奇数加一后为偶数, 即清除等待位. 与另一个notify并发时可能重新置位, 只多一次唤醒.
+        epoch_.fetch_add(1, std::memory_order_release);
+        futex(FUTEX_WAKE, INT_MAX, nullptr);
+    }
+
+private:
+    static constexpr uint32_t kWaiting = 1;
+
+    void futex(int op, uint32_t val, const struct timespec* timeout) noexcept {
+        ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&epoch_), op, val, timeout, nullptr, 0);
+    }
+
+    std::atomic<uint32_t> epoch_;
+};
+
+/**
+ * 共享内存段的头部, 数据区紧随其后(data_offset处). 只保存单调递增的下标, 不保存任何指针,
+ * 因此各进程映射到不同地址也能正常工作.
+ */
+struct ShmRingHeader {
+    static constexpr uint32_t kMagic = 0x52534654; // "TFSR"
+    // 2: ShmEventCount去掉了等待者计数.
+    static constexpr uint32_t kVersion = 2;
+
+    // 创建者最后写入, 非零表示初始化完成.
+    std::atomic<uint32_t> magic;
+    uint32_t version;
+    uint32_t elem_size;
+    uint32_t elem_align;
+    uint64_t capacity;
+    uint64_t data_offset;
+    char pad0[kCacheLineSize];
+
+    std::atomic<uint64_t> tail;
+    char pad1[kCacheLineSize];
+
+    std::atomic<uint64_t> head;
+    char pad2[kCacheLineSize];
+
+    ShmEventCount not_empty;
+    ShmEventCount not_full;
+};
+
+enum class ShmRole : int8_t {
+    PRODUCER = 0,
+    CONSUMER = 1,
+};
+
+/**
+ * 跨进程的SPSC环形队列, 元素必须是平凡可拷贝的.
+ *
+ * 一端create, 另一端attach, 两端各自声明角色. 每个角色同时只允许一个进程持有(OFD记录锁,
+ * 进程退出时由内核释放). 下标只在元素写完/读完后才发布, 因此生产者崩溃后重新attach会从
+ * 共享内存中的tail继续写入, 崩溃时写了一半的元素不会被消费者看到. 段由unlink删除.
+ */
+template <typename T>
+class ShmSpscRing {
+    static_assert(std::is_trivially_copyable<T>::value, "ShmSpscRing requires trivially copyable T");
+
+public:
+    using Value = T;
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief 创建新的共享内存段, 同名段已存在时抛出std::system_error.
+     */
+    static ShmSpscRing create(const std::string& name, size_t capacity, ShmRole role) {
+        if (capacity <= 0) {
+            throw std::invalid_argument("capacity must be non-negative");
+        }
+        size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+
+        const std::string path = normalize(name);
+        const int fd = ::shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0) {
+            throw std::system_error(errno, std::system_category(), "shm_open " + path);
+        }
+        const size_t data_offset = (sizeof(ShmRingHeader) + kCacheLineSize - 1) / kCacheLineSize * kCacheLineSize;
+        const size_t bytes = data_offset + size * sizeof(T);
+        if (::ftruncate(fd, static_cast<off_t>(bytes)) != 0) {
+            const int err = errno;
+            ::close(fd);
+            ::shm_unlink(path.c_str());
+            throw std::system_error(err, std::system_category(), "ftruncate " + path);
+        }
+
+        ShmSpscRing ring = [&]() {
+            try {
+                return ShmSpscRing(fd, bytes, role);
+            }
+            catch (...) {
+                // 构造失败时描述符已关闭, 删除刚创建的段, 不在/dev/shm中留下残留.
+                ::shm_unlink(path.c_str());
+                throw;
+            }
+        }();
+        // ftruncate后内容全零, 即各计数器的初始状态.
+        ShmRingHeader* header = ring.header_;
+        header->version = ShmRingHeader::kVersion;
+        header->elem_size = sizeof(T);
+        header->elem_align = alignof(T);
+        header->capacity = size;
+        header->data_offset = data_offset;
+        header->magic.store(ShmRingHeader::kMagic, std::memory_order_release);
+        ring.init();
+        return ring;
+    }
+
+    /**
+     * @brief 连接已存在的共享内存段, 布局与T不匹配或角色已被占用时抛出异常.
+     * @param timeout 等待创建者完成初始化的时间.
+     */
+    static ShmSpscRing attach(const std::string& name, ShmRole role,
+                              std::chrono::milliseconds timeout = std::chrono::milliseconds(1000)) {
+        const std::string path = normalize(name);
+        const int fd = ::shm_open(path.c_str(), O_RDWR, 0600);
+        if (fd < 0) {
+            throw std::system_error(errno, std::system_category(), "shm_open " + path);
+        }
+
+        const auto deadline = Clock::now() + timeout;
+        size_t bytes = 0;
+        while (true) {
+            struct stat st {};
+            if (::fstat(fd, &st) != 0) {
+                const int err = errno;
+                ::close(fd);
+                throw std::system_error(err, std::system_category(), "fstat " + path);
+            }
+            bytes = static_cast<size_t>(st.st_size);
+            if (bytes >= sizeof(ShmRingHeader)) {
+                break;
+            }
+            if (Clock::now() >= deadline) {
+                ::close(fd);
+                throw std::runtime_error("shm ring not initialized: " + path);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        ShmSpscRing ring(fd, bytes, role);
+        const ShmRingHeader* header = ring.header_;
+        while (header->magic.load(std::memory_order_acquire) != ShmRingHeader::kMagic) {
+            if (Clock::now() >= deadline) {
+                throw std::runtime_error("shm ring not initialized: " + path);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        if (header->version != ShmRingHeader::kVersion) {
+            throw std::runtime_error("shm ring version mismatch: " + path);
+        }
+        if (header->elem_size != sizeof(T) || header->elem_align != alignof(T)
+            || header->data_offset + header->capacity * sizeof(T) != bytes) {
+            throw std::runtime_error("shm ring layout mismatch: " + path);
+        }
+        ring.init();
+        return ring;
+    }
+
+    static void unlink(const std::string& name) noexcept { ::shm_unlink(normalize(name).c_str()); }
+
+    ShmSpscRing(ShmSpscRing&& other) noexcept
+        : fd_(other.fd_)
+        , bytes_(other.bytes_)
+        , role_(other.role_)
+        , header_(other.header_)
+        , data_(other.data_)
+        , mask_(other.mask_)
+        , cached_(other.cached_) {
+        other.fd_ = -1;
+        other.header_ = nullptr;
+    }
+
+    ShmSpscRing& operator=(ShmSpscRing&& other) noexcept {
+        std::swap(fd_, other.fd_);
+        std::swap(bytes_, other.bytes_);
+        std::swap(role_, other.role_);
+        std::swap(header_, other.header_);
+        std::swap(data_, other.data_);
+        std::swap(mask_, other.mask_);
+        std::swap(cached_, other.cached_);
+        return *this;
+    }
+
+    ShmSpscRing(const ShmSpscRing&) = delete;
+    ShmSpscRing& operator=(const ShmSpscRing&) = delete;
+
+    ~ShmSpscRing() noexcept {
+        if (header_ != nullptr) {
+            ::munmap(header_, bytes_);
+        }
+        if (fd_ >= 0) {
+            // 关闭描述符同时释放角色锁.
+            ::close(fd_);
+        }
+    }
+
+    // 仅生产者调用.
+    bool try_push(const T& val) noexcept {
+        assert(role_ == ShmRole::PRODUCER);
+        const uint64_t tail = header_->tail.load(std::memory_order_relaxed);
+        if (tail - cached_ > mask_) {
+            cached_ = header_->head.load(std::memory_order_acquire);
+            if (tail - cached_ > mask_) {
+                return false;
+            }
+        }
+        data_[tail & mask_] = val;
+        header_->tail.store(tail + 1, std::memory_order_release);
+        header_->not_empty.notify();
+        return true;
+    }
+
+    void wait_and_push(const T& val) noexcept {
+        while (!try_push(val)) {
+            const auto key = header_->not_full.prepareWait();
+            if (try_push(val)) {
+                header_->not_full.cancelWait();
+                return;
+            }
+            header_->not_full.waitUntil(key, Clock::time_point::max());
+        }
+    }
+
+    // 仅消费者调用.
+    bool try_pop(T& res) noexcept {
+        assert(role_ == ShmRole::CONSUMER);
+        const uint64_t head = header_->head.load(std::memory_order_relaxed);
+        if (head == cached_) {
+            cached_ = header_->tail.load(std::memory_order_acquire);
+            if (head == cached_) {
+                return false;
+            }
+        }
+        res = data_[head & mask_];
+        header_->head.store(head + 1, std::memory_order_release);
+        header_->not_full.notify();
+        return true;
+    }
+
+    void wait_and_pop(T& res) noexcept { wait_pop_until(res, Clock::time_point::max()); }
+
+    // 超时返回false.
+    template <class Rep, class Period>
+    bool wait_and_pop(T& res, const std::chrono::duration<Rep, Period>& timeout) noexcept {
+        return wait_pop_until(res, Clock::now() + timeout);
+    }
+
+    // 以下查询在并发时只是近似值.
+    inline size_t size() const noexcept {
+        const uint64_t head = header_->head.load(std::memory_order_acquire);
+        const uint64_t tail = header_->tail.load(std::memory_order_acquire);
+        return static_cast<size_t>(tail - head);
+    }
+
+    inline bool full() const noexcept { return size() > mask_; }
+
+    inline bool empty() const noexcept { return size() == 0; }
+
+    inline size_t capacity() const noexcept { return static_cast<size_t>(mask_ + 1); }
+
+    inline ShmRole role() const noexcept { return role_; }
+
+private:
+    ShmSpscRing(int fd, size_t bytes, ShmRole role)
+        : fd_(fd)
+        , bytes_(bytes)
+        , role_(role)
+        , header_(nullptr)
+        , data_(nullptr)
+        , mask_(0)
+        , cached_(0) {
+        lockRole();
+        void* base = ::mmap(nullptr, bytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if (base == MAP_FAILED) {
+            const int err = errno;
+            ::close(fd_);
+            throw std::system_error(err, std::system_category(), "mmap shm ring");
+        }
+        header_ = static_cast<ShmRingHeader*>(base);
+    }
+
+    static std::string normalize(const std::string& name) { return name[0] == '/' ? name : "/" + name; }
+
+    // 每个角色锁住一个字节, 锁属于打开的文件描述, 持有者崩溃时自动释放.
+    void lockRole() {
+        struct flock lock {};
+        lock.l_type = F_WRLCK;
+        lock.l_whence = SEEK_SET;
+        lock.l_start = static_cast<off_t>(role_);
+        lock.l_len = 1;
+        if (::fcntl(fd_, F_OFD_SETLK, &lock) != 0) {
+            const int err = errno;
+            ::close(fd_);
+            fd_ = -1;
+            if (err == EAGAIN || err == EACCES) {
+                throw std::runtime_error(role_ == ShmRole::PRODUCER ? "shm ring already has a producer"
+                                                                    : "shm ring already has a consumer");
+            }
+            throw std::system_error(err, std::system_category(), "lock shm ring");
+        }
+    }
+
+    void init() noexcept {
+        data_ = reinterpret_cast<T*>(reinterpret_cast<char*>(header_) + header_->data_offset);
+        mask_ = header_->capacity - 1;
+        // 重新attach时从共享内存中的下标继续.
+        cached_ = role_ == ShmRole::PRODUCER ? header_->head.load(std::memory_order_acquire)
+                                             : header_->tail.load(std::memory_order_acquire);
+    }
+
+    bool wait_pop_until(T& res, Clock::time_point deadline) noexcept {
+        while (!try_pop(res)) {
+            const auto key = header_->not_empty.prepareWait();
+            if (try_pop(res)) {
+                header_->not_empty.cancelWait();
+                return true;
+            }
+            if (!header_->not_empty.waitUntil(key, deadline)) {
+                return try_pop(res);
+            }
+        }
+        return true;
+    }
+
+    int fd_;
+    size_t bytes_;
+    ShmRole role_;
+    ShmRingHeader* header_;
+    T* data_;
+    uint64_t mask_;
+    // 生产者缓存head, 消费者缓存tail, 只在本进程内使用.
+    uint64_t cached_;
+};
@@ -0,0 +1,153 @@
+/* Proj: tiny-future
+ * File: shm_buffer_test.cpp
+ * Created Date: 2023/5/11
+ * Author: yangyangyang
+ * Description:
+ * -----
+ * Last Modified: 2023/5/11 16:05:48
+ * -----
+ * Copyright (c) 2023  . All rights reserved.
+ */
+
+#include <gtest/gtest.h>
+
+#include "./shm_buffer.hpp"
+
+#include <sys/wait.h>
+
+namespace {
+
+struct Record {
+    uint64_t seq;
+    uint64_t payload;
+};
+
+std::string uniqueName(const char* tag) { return std::string("tiny_future_") + tag + "_" + std::to_string(::getpid()); }
+
+// 等待子进程结束, 返回其退出码.
+int waitChild(pid_t pid) {
+    int status = 0;
+    ::waitpid(pid, &status, 0);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+} // namespace
+
+TEST(ShmSpscRing, CreateAndAttach) {
+    const auto name = uniqueName("attach");
+    ShmSpscRing<Record>::unlink(name);
+    auto producer = ShmSpscRing<Record>::create(name, 3, ShmRole::PRODUCER);
+    EXPECT_EQ(producer.capacity(), 4);
+    EXPECT_THROW(ShmSpscRing<Record>::create(name, 4, ShmRole::CONSUMER), std::system_error);
+    // 同一角色只能有一个持有者.
+    EXPECT_THROW(ShmSpscRing<Record>::attach(name, ShmRole::PRODUCER), std::runtime_error);
+    // 元素布局不一致.
+    EXPECT_THROW(ShmSpscRing<uint32_t>::attach(name, ShmRole::CONSUMER), std::runtime_error);
+
+    auto consumer = ShmSpscRing<Record>::attach(name, ShmRole::CONSUMER);
+    for (uint64_t i = 0; i < 4; ++i) {
+        EXPECT_TRUE(producer.try_push(Record{i, i * 10}));
+    }
+    EXPECT_TRUE(consumer.full());
+    EXPECT_FALSE(producer.try_push(Record{4, 40}));
+
+    Record record{};
+    EXPECT_TRUE(consumer.try_pop(record));
+    EXPECT_EQ(record.seq, 0);
+    EXPECT_EQ(consumer.size(), 3);
+    ShmSpscRing<Record>::unlink(name);
+}
+
+TEST(ShmSpscRing, TwoProcesses) {
+    constexpr uint64_t kRecords = 200000;
+    const auto name = uniqueName("two_proc");
+    ShmSpscRing<Record>::unlink(name);
+    auto producer = ShmSpscRing<Record>::create(name, 256, ShmRole::PRODUCER);
+
+    const pid_t pid = ::fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+        auto consumer = ShmSpscRing<Record>::attach(name, ShmRole::CONSUMER);
+        Record record{};
+        for (uint64_t i = 0; i < kRecords; ++i) {
+            if (!consumer.wait_and_pop(record, std::chrono::seconds(10)) || record.seq != i
+                || record.payload != i * 3) {
+                ::_exit(1);
+            }
+        }
+        ::_exit(0);
+    }
+
+    for (uint64_t i = 0; i < kRecords; ++i) {
+        producer.wait_and_push(Record{i, i * 3});
+    }
+    EXPECT_EQ(waitChild(pid), 0);
+    EXPECT_TRUE(producer.empty());
+    ShmSpscRing<Record>::unlink(name);
+}
+
+TEST(ShmSpscRing, ProducerRestart) {
+    const auto name = uniqueName("restart");
+    ShmSpscRing<Record>::unlink(name);
+    auto consumer = ShmSpscRing<Record>::create(name, 64, ShmRole::CONSUMER);
+
+    // 子进程写入一部分后直接退出, 不做任何清理.
+    const pid_t pid = ::fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+        auto producer = ShmSpscRing<Record>::attach(name, ShmRole::PRODUCER);
+        for (uint64_t i = 0; i < 10; ++i) {
+            producer.wait_and_push(Record{i, 0});
+        }
+        ::_exit(0);
+    }
+    ASSERT_EQ(waitChild(pid), 0);
+
+    // 角色锁随进程退出释放, 新的生产者从之前的位置继续.
+    auto producer = ShmSpscRing<Record>::attach(name, ShmRole::PRODUCER);
+    for (uint64_t i = 10; i < 20; ++i) {
+        EXPECT_TRUE(producer.try_push(Record{i, 0}));
+    }
+    Record record{};
+    for (uint64_t i = 0; i < 20; ++i) {
+        ASSERT_TRUE(consumer.try_pop(record));
+        EXPECT_EQ(record.seq, i);
+    }
+    EXPECT_FALSE(consumer.wait_and_pop(record, std::chrono::milliseconds(10)));
+    ShmSpscRing<Record>::unlink(name);
+}
+
+// mmap失败时不在/dev/shm中留下段.
+TEST(ShmSpscRing, CreateFailureUnlinks) {
+    const auto name = uniqueName("huge");
+    ShmSpscRing<Record>::unlink(name);
+    EXPECT_THROW(ShmSpscRing<Record>::create(name, size_t{1} << 56, ShmRole::PRODUCER), std::system_error);
+    EXPECT_LT(::shm_open(("/" + name).c_str(), O_RDONLY, 0600), 0);
+    EXPECT_EQ(errno, ENOENT);
+}
+
+// 等待者没有回来(进程崩溃或超时)后, 后续的等待与唤醒不受影响.
+TEST(ShmEventCount, AbandonedWaiter) {
+    ShmEventCount event{};
+    event.prepareWait();
+    event.notify();
+
+    std::atomic<bool> ready{false};
+    std::thread waiter([&]() {
+        while (!ready.load()) {
+            const auto key = event.prepareWait();
+            if (ready.load()) {
+                event.cancelWait();
+                break;
+            }
+            event.waitUntil(key, ShmEventCount::Clock::time_point::max());
+        }
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ready.store(true);
+    event.notify();
+    waiter.join();
+
+    const auto key = event.prepareWait();
+    EXPECT_FALSE(event.waitUntil(key, ShmEventCount::Clock::now() + std::chrono::milliseconds(5)));
+}
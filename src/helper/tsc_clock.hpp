@@ -0,0 +1,265 @@
+/* Proj: tiny-future
+ * File: tsc_clock.hpp
+ * Created Date: 2023/5/16
+ * Author: yangyangyang
+ * Description: 基于invariant TSC的低开销时钟, 定期与CLOCK_MONOTONIC/CLOCK_REALTIME重新同步.
+ * -----
+ * Last Modified: 2023/5/16 10:48:20
+ * -----
+ * Copyright (c) 2023  . All rights reserved.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define TINY_FUTURE_HAS_RDTSC 1
+#else
+#define TINY_FUTURE_HAS_RDTSC 0
+#endif
+
+namespace helper {
+
+/**
+ * 单调时钟, 值与CLOCK_MONOTONIC(即steady_clock)在同一时间轴上, 单位ns.
+ *
+ * CPU支持invariant TSC且内核没有放弃TSC时, 读取只需一次rdtsc和一次定点乘法;
+ * 距上次同步超过kResyncInterval时由读取线程顺带重新同步: 不直接跳到CLOCK_MONOTONIC的值,
+ * 而是调整下一个间隔内的倍率, 让误差在一个间隔内平滑地消除(偏差过大时才向前跳), 同时更新REALTIME偏移.
+ * 否则(或设置了环境变量TINY_FUTURE_DISABLE_TSC)退化为clock_gettime.
+ *
+ * 校准需要约kCalibrationNanos, 在首次读取时进行. 使用时钟的组件(开启指标的ThreadExecutor, 日志初始化,
+ * BinaryLogWriter等)在构造时调用warmUp, 避免首次读取落在请求线程上.
+ */
+class TscClock {
+public:
+    static constexpr int64_t kCalibrationNanos = 10 * 1000 * 1000;
+    static constexpr int64_t kResyncInterval = 1000 * 1000 * 1000;
+    // 一次同步最多按此比例(ppm)加快或减慢时钟来消除误差, 超出部分留给之后的同步.
+    static constexpr int64_t kMaxSlewPpm = 500;
+    // 时钟落后超过此值时直接向前跳.
+    static constexpr int64_t kMaxSlewNanos = 10 * 1000 * 1000;
+
+    static int64_t nowNanos() noexcept {
+        State& s = state();
+        if (!s.use_tsc) {
+            return clockNanos(CLOCK_MONOTONIC);
+        }
+        const uint64_t tsc = readTsc();
+        uint64_t seq, base_tsc;
+        int64_t base_ns, mult;
+        do {
+            seq = s.seq.load(std::memory_order_acquire);
+            base_tsc = s.base_tsc.load(std::memory_order_relaxed);
+            base_ns = s.base_ns.load(std::memory_order_relaxed);
+            mult = s.mult.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } while ((seq & 1) != 0 || s.seq.load(std::memory_order_relaxed) != seq);
+
+        // 其他核上读到的tsc可能略早于base_tsc, 按有符号处理.
+        const auto delta = static_cast<int64_t>(tsc - base_tsc);
+        if (delta > s.resync_ticks) {
+            resync(s);
+        }
+        return base_ns + scale(delta, mult);
+    }
+
+    // CLOCK_REALTIME上的当前时间.
+    static std::chrono::system_clock::time_point systemNow() noexcept {
+        State& s = state();
+        if (!s.use_tsc) {
+            return std::chrono::system_clock::now();
+        }
+        const int64_t ns = nowNanos() + s.realtime_offset.load(std::memory_order_relaxed);
+        return std::chrono::system_clock::time_point(
+          std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(ns)));
+    }
+
+    static bool usingTsc() noexcept { return state().use_tsc; }
+
+    // 在当前线程完成校准(若尚未完成).
+    static void warmUp() noexcept { state(); }
+
+    // 校准得到的TSC频率, 未使用TSC时为0.
+    static double tscHz() noexcept {
+        State& s = state();
+        return s.use_tsc ? static_cast<double>(int64_t{1} << kShift) * 1e9 / s.mult.load() : 0.0;
+    }
+
+private:
+    static constexpr int kShift = 32;
+    // 一次采样中clock_gettime前后两次rdtsc的最大间隔, 超过时认为采样被中断或调度打断.
+    static constexpr int64_t kMaxSampleNanos = 20 * 1000;
+    static constexpr int kSampleAttempts = 5;
+
+    struct State {
+        bool use_tsc{false};
+        int64_t resync_ticks{0};
+        int64_t max_sample_ticks{0};
+        // 首次校准的采样点, 重新同步时以此为基线计算频率, 基线越长误差越小.
+        uint64_t origin_tsc{0};
+        int64_t origin_ns{0};
+
+        std::atomic<uint64_t> seq{0};
+        std::atomic<uint64_t> base_tsc{0};
+        std::atomic<int64_t> base_ns{0};
+        // 每个tick对应的ns, 定点数(<< kShift), 包含为消除误差而做的调整.
+        std::atomic<int64_t> mult{0};
+        std::atomic<int64_t> realtime_offset{0};
+        std::atomic<bool> resyncing{false};
+    };
+
+    static int64_t clockNanos(clockid_t id) noexcept {
+        struct timespec ts {};
+        ::clock_gettime(id, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    }
+
+    static uint64_t readTsc() noexcept {
+#if TINY_FUTURE_HAS_RDTSC
+        return __rdtsc();
+#else
+        return 0;
+#endif
+    }
+
+    // 同一时刻的一对(tsc, CLOCK_MONOTONIC)读数. tsc取clock_gettime前后两次读数的中点,
+    // 多次尝试中取间隔最窄的一次; max_ticks不为0且所有尝试都超过它时返回false.
+    static bool sampleClock(uint64_t& tsc, int64_t& ns, int64_t max_ticks) noexcept {
+        int64_t best = INT64_MAX;
+        for (int i = 0; i < kSampleAttempts; ++i) {
+            const uint64_t tsc0 = readTsc();
+            const int64_t clock = clockNanos(CLOCK_MONOTONIC);
+            const uint64_t tsc1 = readTsc();
+            const auto width = static_cast<int64_t>(tsc1 - tsc0);
+            if (width >= 0 && width < best) {
+                best = width;
+                tsc = tsc0 + static_cast<uint64_t>(width / 2);
+                ns = clock;
+            }
+        }
+        return best != INT64_MAX && (max_ticks == 0 || best <= max_ticks);
+    }
+
+    static int64_t scale(int64_t ticks, int64_t mult) noexcept {
+        return static_cast<int64_t>((static_cast<__int128>(ticks) * mult) >> kShift);
+    }
+
+    static bool tscReliable() noexcept {
+#if TINY_FUTURE_HAS_RDTSC
+        if (std::getenv("TINY_FUTURE_DISABLE_TSC") != nullptr) {
+            return false;
+        }
+        unsigned eax, ebx, ecx, edx;
+        // CPUID.80000007H:EDX[8] invariant TSC.
+        if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) || (edx & (1u << 8)) == 0) {
+            return false;
+        }
+        // 内核检测到TSC不稳定时会切换到其他clocksource, 文件不可读(如容器内)时只依据CPUID.
+        std::ifstream in("/sys/devices/system/clocksource/clocksource0/current_clocksource");
+        std::string source;
+        return !(in >> source) || source == "tsc";
+#else
+        return false;
+#endif
+    }
+
+    static int64_t realtimeOffset() noexcept { return clockNanos(CLOCK_REALTIME) - clockNanos(CLOCK_MONOTONIC); }
+
+    static State& state() noexcept {
+        static State* s = calibrate();
+        return *s;
+    }
+
+    static State* calibrate() noexcept {
+        // 不析构: 其他静态对象析构时仍可能读取时钟.
+        auto* s = new State();
+        if (!tscReliable()) {
+            return s;
+        }
+        uint64_t tsc0, tsc1;
+        int64_t ns0, ns1;
+        sampleClock(tsc0, ns0, 0);
+        do {
+            sampleClock(tsc1, ns1, 0);
+        } while (ns1 - ns0 < kCalibrationNanos);
+
+        const auto ticks = static_cast<int64_t>(tsc1 - tsc0);
+        // 频率不在100MHz~10GHz之间时认为TSC不可用.
+        if (ticks < kCalibrationNanos / 10 || ticks > kCalibrationNanos * 10) {
+            return s;
+        }
+        const int64_t mult = static_cast<int64_t>((static_cast<__int128>(ns1 - ns0) << kShift) / ticks);
+        s->origin_tsc = tsc0;
+        s->origin_ns = ns0;
+        s->base_tsc.store(tsc1, std::memory_order_relaxed);
+        s->base_ns.store(ns1, std::memory_order_relaxed);
+        s->mult.store(mult, std::memory_order_relaxed);
+        s->resync_ticks = static_cast<int64_t>((static_cast<__int128>(kResyncInterval) << kShift) / mult);
+        s->max_sample_ticks = static_cast<int64_t>((static_cast<__int128>(kMaxSampleNanos) << kShift) / mult);
+        s->realtime_offset.store(realtimeOffset(), std::memory_order_relaxed);
+        s->use_tsc = true;
+        return s;
+    }
+
+    static void resync(State& s) noexcept {
+        if (s.resyncing.exchange(true, std::memory_order_acquire)) {
+            return;
+        }
+        uint64_t tsc;
+        int64_t ns;
+        const bool sampled = sampleClock(tsc, ns, s.max_sample_ticks);
+        if (!sampled) {
+            // 采样都被打断: 沿用当前倍率, 只把基点向前移, 下一个间隔再同步.
+            tsc = readTsc();
+        }
+        const int64_t old_mult = s.mult.load(std::memory_order_relaxed);
+        // 按当前参数推算的值, 新参数从这里开始, 保证时钟连续.
+        const int64_t estimate = s.base_ns.load(std::memory_order_relaxed) +
+                                 scale(static_cast<int64_t>(tsc - s.base_tsc.load(std::memory_order_relaxed)), old_mult);
+        int64_t base_ns = estimate;
+        int64_t mult = old_mult;
+        if (sampled) {
+            // 以首次校准为起点的长基线频率.
+            const auto total_ticks = static_cast<int64_t>(tsc - s.origin_tsc);
+            const int64_t freq_mult = static_cast<int64_t>((static_cast<__int128>(ns - s.origin_ns) << kShift) /
+                                                           std::max<int64_t>(total_ticks, 1));
+            const int64_t error = ns - estimate;
+            if (error > kMaxSlewNanos) {
+                // 落后太多(如虚拟机暂停), 直接向前跳.
+                base_ns = ns;
+                mult = freq_mult;
+            }
+            else {
+                // 在接下来的resync_ticks内追上误差, 调整幅度不超过kMaxSlewPpm.
+                const int64_t max_error = kResyncInterval * kMaxSlewPpm / 1000000;
+                const int64_t slew = std::min(std::max(error, -max_error), max_error);
+                mult = freq_mult + static_cast<int64_t>((static_cast<__int128>(slew) << kShift) / s.resync_ticks);
+            }
+        }
+
+        const uint64_t seq = s.seq.load(std::memory_order_relaxed);
+        s.seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        s.base_tsc.store(tsc, std::memory_order_relaxed);
+        s.base_ns.store(base_ns, std::memory_order_relaxed);
+        s.mult.store(mult, std::memory_order_relaxed);
+        s.seq.store(seq + 2, std::memory_order_release);
+
+        s.realtime_offset.store(realtimeOffset(), std::memory_order_relaxed);
+        s.resyncing.store(false, std::memory_order_release);
+    }
+};
+
+} // namespace helper
@@ -0,0 +1,89 @@
+/* Proj: tiny-future
+ * File: tsc_clock_test.cpp
+ * Created Date: 2023/5/16
+ * Author: yangyangyang
+ * Description:
+ * -----
+ * Last Modified: 2023/5/16 11:30:05
+ * -----
+ * Copyright (c) 2023  . All rights reserved.
+ */
+
+#include "./tsc_clock.hpp"
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+using helper::TscClock;
+
+namespace {
+
+int64_t steadyNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+} // namespace
+
+TEST(TscClock, TracksSteadyClock) {
+    std::cout << "using tsc: " << TscClock::usingTsc() << ", " << TscClock::tscHz() / 1e6 << " MHz" << std::endl;
+    for (int i = 0; i < 5; ++i) {
+        const int64_t before = steadyNanos();
+        const int64_t now = TscClock::nowNanos();
+        const int64_t after = steadyNanos();
+        // 允许校准误差.
+        EXPECT_GT(now, before - 1000000);
+        EXPECT_LT(now, after + 1000000);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+
+    const auto system_diff = TscClock::systemNow() - std::chrono::system_clock::now();
+    EXPECT_LT(std::llabs(std::chrono::duration_cast<std::chrono::milliseconds>(system_diff).count()), 5);
+}
+
+TEST(TscClock, MonotonicAcrossResync) {
+    // 跨过至少一次重新同步.
+    const int64_t end = TscClock::nowNanos() + TscClock::kResyncInterval + 100000000;
+    std::vector<std::thread> threads;
+    std::atomic<int> backwards{0};
+    for (int t = 0; t < 2; ++t) {
+        threads.emplace_back([&]() {
+            int64_t last = TscClock::nowNanos();
+            while (last < end) {
+                const int64_t now = TscClock::nowNanos();
+                if (now < last) {
+                    ++backwards;
+                }
+                last = now;
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(backwards.load(), 0);
+}
+
+// 多次重新同步之后仍跟随steady_clock, 误差不会累积.
+TEST(TscClock, NoDriftAcrossResyncs) {
+    const int64_t end = steadyNanos() + 3 * TscClock::kResyncInterval + 100000000;
+    int64_t max_ahead = 0;
+    int64_t max_behind = 0;
+    while (steadyNanos() < end) {
+        const int64_t before = steadyNanos();
+        const int64_t now = TscClock::nowNanos();
+        const int64_t after = steadyNanos();
+        if (after - before < 100000) {
+            max_ahead = std::max(max_ahead, now - after);
+            max_behind = std::max(max_behind, before - now);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_LT(max_ahead, 1000000);
+    EXPECT_LT(max_behind, 1000000);
+
+    const auto system_diff = TscClock::systemNow() - std::chrono::system_clock::now();
+    EXPECT_LT(std::llabs(std::chrono::duration_cast<std::chrono::milliseconds>(system_diff).count()), 5);
+}